@@ -0,0 +1,224 @@
+/*
+ * arch/arm/mach-tegra/cpu-tegra3-policy.c
+ *
+ * Runqueue-aware auto-hotplug policy for Tegra3 CPUs
+ *
+ * Copyright (c) 2011, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * Nothing but the policy header may be included here: this file is shared
+ * verbatim with the userspace simulator.
+ */
+#include "cpu-tegra3-policy.h"
+
+/*
+ * Default dwell times, the up2gn_delay, up2g0_delay and down_delay module
+ * parameters of the driver. Leaving a core or the G cluster powered through
+ * the idle gaps of bursty UI load costs more leakage than the legacy policy
+ * saved by running those bursts on the LP CPU, so coming down is quick;
+ * cost_factor still keeps a slow cpu_down from being repeated back and forth.
+ */
+#define UP_DWELL_US		250000
+#define TO_G_DWELL_US		100000
+#define DOWN_DWELL_US		50000
+
+/* a priori transition costs, replaced by the first measurement */
+#define CPU_UP_COST_US		2000
+#define CPU_DOWN_COST_US	10000
+#define CLUSTER_SWITCH_COST_US	1000
+
+void tegra_hp_policy_init(struct tegra_hp_policy *p)
+{
+	int i;
+
+	/*
+	 * n online CPUs are enough as long as the average number of runnable
+	 * threads stays below n + 0.5; removing one needs it to drop a
+	 * further nr_run_hyst below the threshold of the smaller set.
+	 */
+	for (i = 0; i < TEGRA_HP_MAX_CPUS; i++)
+		p->nr_run_up[i] = i * TEGRA_HP_NR_RUN_SCALE +
+			TEGRA_HP_NR_RUN_SCALE * 3 / 2;
+	p->nr_run_hyst = TEGRA_HP_NR_RUN_SCALE / 2;
+	p->nr_run_lp = TEGRA_HP_NR_RUN_SCALE * 6 / 5;
+	p->nr_run_burst = 2 * TEGRA_HP_NR_RUN_SCALE;
+	p->util_up = 60;
+	p->util_down = 25;
+	p->cost_factor = 8;
+	p->up_dwell_us = UP_DWELL_US;
+	p->to_g_dwell_us = TO_G_DWELL_US;
+	p->down_dwell_us = DOWN_DWELL_US;
+
+	p->pending = TEGRA_HP_HOLD;
+	p->pending_since_us = 0;
+	p->last_change_us = 0;
+	for (i = 0; i < TEGRA_HP_NR_ACTIONS; i++)
+		p->count[i] = 0;
+	p->cost_us[TEGRA_HP_HOLD] = 0;
+	p->cost_us[TEGRA_HP_CPU_UP] = CPU_UP_COST_US;
+	p->cost_us[TEGRA_HP_CPU_DOWN] = CPU_DOWN_COST_US;
+	p->cost_us[TEGRA_HP_TO_LP] = CLUSTER_SWITCH_COST_US;
+	p->cost_us[TEGRA_HP_TO_G] = CLUSTER_SWITCH_COST_US;
+}
+
+static unsigned int util_avg(const struct tegra_hp_sample *s)
+{
+	unsigned int i, n = s->nr_online, sum = 0;
+
+	if (n > TEGRA_HP_MAX_CPUS)
+		n = TEGRA_HP_MAX_CPUS;
+	for (i = 0; i < n; i++)
+		sum += s->util[i];
+	return n ? sum / n : 0;
+}
+
+static unsigned int util_min(const struct tegra_hp_sample *s)
+{
+	unsigned int i, n = s->nr_online, min = 100;
+
+	if (n > TEGRA_HP_MAX_CPUS)
+		n = TEGRA_HP_MAX_CPUS;
+	for (i = 0; i < n; i++)
+		if (s->util[i] < min)
+			min = s->util[i];
+	return min;
+}
+
+/* what the current sample asks for, before hysteresis is applied */
+static enum tegra_hp_action tegra_hp_want(const struct tegra_hp_policy *p,
+					  const struct tegra_hp_sample *s)
+{
+	unsigned int n = s->nr_online;
+
+	if (s->lp) {
+		if ((s->speed == TEGRA_HP_SPEED_HIGH) ||
+		    (s->nr_run > p->nr_run_lp + p->nr_run_hyst))
+			return TEGRA_HP_TO_G;
+		return TEGRA_HP_HOLD;
+	}
+
+	if ((n < TEGRA_HP_MAX_CPUS) && (n < s->max_cpus) &&
+	    (s->speed != TEGRA_HP_SPEED_LOW) && (s->nr_skewed < 2) &&
+	    s->edp_favor_up && (s->nr_run > p->nr_run_up[n - 1]) &&
+	    (util_avg(s) >= p->util_up))
+		return TEGRA_HP_CPU_UP;
+
+	if (n > 1) {
+		/* frequency targets of 2 or more CPUs far below the top one */
+		if (s->nr_skewed >= 2)
+			return TEGRA_HP_CPU_DOWN;
+		/*
+		 * One CPU less still copes with the runqueue depth, and one
+		 * of the online CPUs is mostly idle (or all of them are
+		 * crawling at the bottom of the G cluster range).
+		 */
+		if ((s->nr_run + p->nr_run_hyst < p->nr_run_up[n - 2]) &&
+		    ((s->speed == TEGRA_HP_SPEED_LOW) ||
+		     (util_min(s) < p->util_down)))
+			return TEGRA_HP_CPU_DOWN;
+		return TEGRA_HP_HOLD;
+	}
+
+	if (!s->no_lp && (s->speed == TEGRA_HP_SPEED_LOW) &&
+	    (s->nr_run < p->nr_run_lp))
+		return TEGRA_HP_TO_LP;
+
+	return TEGRA_HP_HOLD;
+}
+
+/*
+ * How long a request must persist before it is acted upon. Never less than
+ * cost_factor times what the transition was measured to cost, so that a
+ * slow transition cannot be repeated back and forth; a burst of runnable
+ * threads well above what the online CPUs can handle skips the rest.
+ */
+static u64 tegra_hp_dwell(const struct tegra_hp_policy *p,
+			  const struct tegra_hp_sample *s,
+			  enum tegra_hp_action action)
+{
+	u64 cost = p->cost_factor * p->cost_us[action];
+	u64 dwell;
+
+	switch (action) {
+	case TEGRA_HP_CPU_UP:
+		dwell = (s->nr_run >= p->nr_run_up[s->nr_online - 1] +
+			 p->nr_run_burst) ? 0 : p->up_dwell_us;
+		break;
+	case TEGRA_HP_TO_G:
+		dwell = (s->nr_run >= p->nr_run_lp + p->nr_run_burst) ?
+			0 : p->to_g_dwell_us;
+		break;
+	case TEGRA_HP_CPU_DOWN:
+	case TEGRA_HP_TO_LP:
+		dwell = p->down_dwell_us;
+		break;
+	default:
+		dwell = 0;
+		break;
+	}
+	return dwell > cost ? dwell : cost;
+}
+
+enum tegra_hp_action tegra_hp_policy_decide(struct tegra_hp_policy *p,
+					    const struct tegra_hp_sample *s)
+{
+	enum tegra_hp_action want;
+	u64 since;
+
+	if (!s->nr_online)
+		return TEGRA_HP_HOLD;
+
+	/* PM QoS and EDP limits are enforced without hysteresis */
+	if (!s->lp && (s->nr_online > 1) &&
+	    ((s->nr_online > s->max_cpus) || s->edp_favor_down)) {
+		p->pending = TEGRA_HP_HOLD;
+		return TEGRA_HP_CPU_DOWN;
+	}
+
+	want = tegra_hp_want(p, s);
+	if (want != p->pending) {
+		p->pending = want;
+		p->pending_since_us = s->now_us;
+	}
+	if (want == TEGRA_HP_HOLD)
+		return TEGRA_HP_HOLD;
+
+	since = p->pending_since_us > p->last_change_us ?
+		p->pending_since_us : p->last_change_us;
+	if (s->now_us < since + tegra_hp_dwell(p, s, want))
+		return TEGRA_HP_HOLD;
+
+	return want;
+}
+
+/* called once the transition returned by tegra_hp_policy_decide() is done */
+void tegra_hp_policy_account(struct tegra_hp_policy *p,
+			     enum tegra_hp_action action, u64 now_us,
+			     u64 cost_us)
+{
+	if ((action <= TEGRA_HP_HOLD) || (action >= TEGRA_HP_NR_ACTIONS))
+		return;
+
+	if (p->count[action])
+		p->cost_us[action] = (7 * p->cost_us[action] + cost_us) >> 3;
+	else
+		p->cost_us[action] = cost_us;
+	p->count[action]++;
+	p->last_change_us = now_us;
+	p->pending = TEGRA_HP_HOLD;
+}
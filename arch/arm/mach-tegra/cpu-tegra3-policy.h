@@ -0,0 +1,102 @@
+/*
+ * arch/arm/mach-tegra/cpu-tegra3-policy.h
+ *
+ * Runqueue-aware auto-hotplug policy for Tegra3 CPUs
+ *
+ * Copyright (c) 2011, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __MACH_TEGRA_CPU_TEGRA3_POLICY_H
+#define __MACH_TEGRA_CPU_TEGRA3_POLICY_H
+
+/*
+ * The policy is pure computation on a load sample: it never touches the
+ * hardware, clocks or kernel state, so it is also built unmodified by the
+ * trace-driven simulator in tools/power/tegra/tegra3_hotplug_sim.
+ */
+#ifdef __KERNEL__
+#include <linux/types.h>
+#else
+#include <stdbool.h>
+#include <stdint.h>
+typedef uint64_t u64;
+#endif
+
+#define TEGRA_HP_MAX_CPUS	4
+
+/* runqueue depth fixed point: one runnable thread == 100 */
+#define TEGRA_HP_NR_RUN_SCALE	100
+
+enum tegra_hp_action {
+	TEGRA_HP_HOLD = 0,
+	TEGRA_HP_CPU_UP,
+	TEGRA_HP_CPU_DOWN,
+	TEGRA_HP_TO_LP,
+	TEGRA_HP_TO_G,
+	TEGRA_HP_NR_ACTIONS,
+};
+
+/* frequency envelope reported by the cpufreq governor hook */
+enum tegra_hp_speed {
+	TEGRA_HP_SPEED_LOW,		/* at or below the G cluster floor */
+	TEGRA_HP_SPEED_MID,
+	TEGRA_HP_SPEED_HIGH,		/* above the LP cluster ceiling */
+};
+
+struct tegra_hp_sample {
+	u64 now_us;
+	bool lp;			/* running on the LP cluster */
+	unsigned int nr_online;		/* online G CPUs (1 on LP) */
+	unsigned int max_cpus;		/* PM QoS cap */
+	unsigned int nr_run;		/* avg runnable threads, NR_RUN_SCALE */
+	unsigned int util[TEGRA_HP_MAX_CPUS];	/* busy %, per online CPU */
+	unsigned int nr_skewed;		/* CPUs with freq target far below top */
+	enum tegra_hp_speed speed;
+	bool edp_favor_up;
+	bool edp_favor_down;
+	bool no_lp;
+};
+
+struct tegra_hp_policy {
+	/* tunables */
+	unsigned int nr_run_up[TEGRA_HP_MAX_CPUS];	/* [n - 1]: n CPUs cope up to */
+	unsigned int nr_run_hyst;
+	unsigned int nr_run_lp;		/* LP cluster copes up to */
+	unsigned int nr_run_burst;	/* excess that skips the dwell time */
+	unsigned int util_up;		/* avg busy % required to add a CPU */
+	unsigned int util_down;		/* a CPU this idle may be removed */
+	unsigned int cost_factor;	/* dwell >= cost_factor * transition */
+	u64 up_dwell_us;
+	u64 to_g_dwell_us;
+	u64 down_dwell_us;
+
+	/* state */
+	enum tegra_hp_action pending;
+	u64 pending_since_us;
+	u64 last_change_us;
+	u64 cost_us[TEGRA_HP_NR_ACTIONS];	/* measured, averaged */
+	unsigned long count[TEGRA_HP_NR_ACTIONS];
+};
+
+void tegra_hp_policy_init(struct tegra_hp_policy *p);
+enum tegra_hp_action tegra_hp_policy_decide(struct tegra_hp_policy *p,
+					    const struct tegra_hp_sample *s);
+void tegra_hp_policy_account(struct tegra_hp_policy *p,
+			     enum tegra_hp_action action, u64 now_us,
+			     u64 cost_us);
+
+#endif /* __MACH_TEGRA_CPU_TEGRA3_POLICY_H */
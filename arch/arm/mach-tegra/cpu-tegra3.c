@@ -33,15 +33,17 @@
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
 #include <linux/pm_qos_params.h>
+#include <linux/tick.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 
 #include "pm.h"
 #include "cpu-tegra.h"
+#include "cpu-tegra3-policy.h"
 #include "clock.h"
 
 #define INITIAL_STATE		TEGRA_HP_DISABLED
-#define UP2G0_DELAY_MS		200
-#define UP2Gn_DELAY_MS		1000
-#define DOWN_DELAY_MS		2000
+#define SAMPLE_DELAY_MS		50
 
 static struct mutex *tegra3_cpu_lock;
 
@@ -58,6 +60,9 @@ module_param(up2gn_delay, ulong, 0644);
 module_param(up2g0_delay, ulong, 0644);
 module_param(down_delay, ulong, 0644);
 
+static unsigned long sample_delay;
+module_param(sample_delay, ulong, 0644);
+
 static unsigned int idle_top_freq;
 static unsigned int idle_bottom_freq;
 module_param(idle_top_freq, uint, 0644);
@@ -69,6 +74,16 @@ module_param(mp_overhead, int, 0644);
 static int balance_level = 75;
 module_param(balance_level, int, 0644);
 
+static struct tegra_hp_policy hp_policy;
+module_param_array_named(nr_run_thresholds, hp_policy.nr_run_up, uint,
+			 NULL, 0644);
+module_param_named(nr_run_hysteresis, hp_policy.nr_run_hyst, uint, 0644);
+module_param_named(nr_run_lp, hp_policy.nr_run_lp, uint, 0644);
+module_param_named(nr_run_burst, hp_policy.nr_run_burst, uint, 0644);
+module_param_named(util_up, hp_policy.util_up, uint, 0644);
+module_param_named(util_down, hp_policy.util_down, uint, 0644);
+module_param_named(cost_factor, hp_policy.cost_factor, uint, 0644);
+
 static struct clk *cpu_clk;
 static struct clk *cpu_g_clk;
 static struct clk *cpu_lp_clk;
@@ -147,10 +162,12 @@ static int hp_state_set(const char *arg, const struct kernel_param *kp)
 
 	if (ret == 0) {
 		if ((hp_state == TEGRA_HP_DISABLED) &&
-		    (old_state != TEGRA_HP_DISABLED))
+		    (old_state != TEGRA_HP_DISABLED)) {
+			set_avg_nr_running(false);
 			pr_info("Tegra auto-hotplug disabled\n");
-		else if (hp_state != TEGRA_HP_DISABLED) {
+		} else if (hp_state != TEGRA_HP_DISABLED) {
 			if (old_state == TEGRA_HP_DISABLED) {
+				set_avg_nr_running(true);
 				pr_info("Tegra auto-hotplug enabled\n");
 				hp_init_stats();
 			}
@@ -177,40 +194,65 @@ static struct kernel_param_ops tegra_hp_state_ops = {
 module_param_cb(auto_hotplug, &tegra_hp_state_ops, &hp_state, 0644);
 
 
-enum {
-	TEGRA_CPU_SPEED_BALANCED,
-	TEGRA_CPU_SPEED_BIASED,
-	TEGRA_CPU_SPEED_SKEWED,
-};
+static struct {
+	u64 idle_us;
+	u64 wall_us;
+} hp_cpu_time[CONFIG_NR_CPUS];
+
+/* busy percentage of @cpu since the previous sample */
+static unsigned int tegra_cpu_util(unsigned int cpu)
+{
+	u64 wall, idle, d_wall, d_idle;
+
+	idle = get_cpu_idle_time_us(cpu, &wall);
+	if (idle == -1ULL)
+		return 100;	/* no NO_HZ idle accounting, rely on nr_run */
+
+	d_wall = wall - hp_cpu_time[cpu].wall_us;
+	d_idle = idle - hp_cpu_time[cpu].idle_us;
+	hp_cpu_time[cpu].wall_us = wall;
+	hp_cpu_time[cpu].idle_us = idle;
 
-static noinline int tegra_cpu_speed_balance(void)
+	if (!d_wall || (d_idle >= d_wall))
+		return d_wall ? 0 : 100;
+	return 100 - (unsigned int)div64_u64(d_idle * 100, d_wall);
+}
+
+static void tegra_hp_sample(struct tegra_hp_sample *s)
 {
-	unsigned long highest_speed = tegra_cpu_highest_speed();
-	unsigned long balanced_speed = highest_speed * balance_level / 100;
-	unsigned long skewed_speed = balanced_speed / 2;
-	unsigned int nr_cpus = num_online_cpus();
-	unsigned int max_cpus = pm_qos_request(PM_QOS_MAX_ONLINE_CPUS) ? : 4;
-
-	/* balanced: freq targets for all CPUs are above 50% of highest speed
-	   biased: freq target for at least one CPU is below 50% threshold
-	   skewed: freq targets for at least 2 CPUs are below 25% threshold */
-	if ((tegra_count_slow_cpus(skewed_speed) >= 2) ||
-	    tegra_cpu_edp_favor_down(nr_cpus, mp_overhead) ||
-	    (nr_cpus > max_cpus))
-		return TEGRA_CPU_SPEED_SKEWED;
-
-	if ((tegra_count_slow_cpus(balanced_speed) >= 1) ||
-	    (!tegra_cpu_edp_favor_up(nr_cpus, mp_overhead)) ||
-	    (nr_cpus == max_cpus))
-		return TEGRA_CPU_SPEED_BIASED;
-
-	return TEGRA_CPU_SPEED_BALANCED;
+	unsigned long balanced_speed =
+		tegra_cpu_highest_speed() * balance_level / 100;
+	unsigned int cpu, i = 0;
+
+	s->now_us = ktime_to_us(ktime_get());
+	s->lp = is_lp_cluster();
+	s->nr_online = num_online_cpus();
+	s->max_cpus = pm_qos_request(PM_QOS_MAX_ONLINE_CPUS) ? :
+		TEGRA_HP_MAX_CPUS;
+	s->nr_run = (avg_nr_running() * TEGRA_HP_NR_RUN_SCALE) >> FSHIFT;
+
+	for_each_online_cpu(cpu) {
+		unsigned int util = tegra_cpu_util(cpu);
+		if (i < TEGRA_HP_MAX_CPUS)
+			s->util[i++] = util;
+	}
+
+	/* freq targets for at least 2 CPUs are below half the balanced speed */
+	s->nr_skewed = tegra_count_slow_cpus(balanced_speed / 2);
+	s->speed = (hp_state == TEGRA_HP_DOWN) ? TEGRA_HP_SPEED_LOW :
+		(hp_state == TEGRA_HP_UP) ? TEGRA_HP_SPEED_HIGH :
+		TEGRA_HP_SPEED_MID;
+	s->edp_favor_up = tegra_cpu_edp_favor_up(s->nr_online, mp_overhead);
+	s->edp_favor_down = tegra_cpu_edp_favor_down(s->nr_online, mp_overhead);
+	s->no_lp = no_lp;
 }
 
 static void tegra_auto_hotplug_work_func(struct work_struct *work)
 {
-	bool up = false;
+	struct tegra_hp_sample sample;
+	enum tegra_hp_action action = TEGRA_HP_HOLD;
 	unsigned int cpu = nr_cpu_ids;
+	ktime_t start;
 
 	mutex_lock(tegra3_cpu_lock);
 
@@ -219,57 +261,57 @@ static void tegra_auto_hotplug_work_func(struct work_struct *work)
 	case TEGRA_HP_IDLE:
 		break;
 	case TEGRA_HP_DOWN:
-		cpu = tegra_get_slowest_cpu_n();
-		if (cpu < nr_cpu_ids) {
-			up = false;
-			queue_delayed_work(
-				hotplug_wq, &hotplug_work, down_delay);
-			hp_stats_update(cpu, false);
-		} else if (!is_lp_cluster() && !no_lp) {
-			if(!clk_set_parent(cpu_clk, cpu_lp_clk)) {
+	case TEGRA_HP_UP:
+		hp_policy.up_dwell_us = jiffies_to_usecs(up2gn_delay);
+		hp_policy.to_g_dwell_us = jiffies_to_usecs(up2g0_delay);
+		hp_policy.down_dwell_us = jiffies_to_usecs(down_delay);
+
+		tegra_hp_sample(&sample);
+		action = tegra_hp_policy_decide(&hp_policy, &sample);
+		start = ktime_get();
+
+		switch (action) {
+		case TEGRA_HP_CPU_UP:
+			cpu = cpumask_next_zero(0, cpu_online_mask);
+			if (cpu < nr_cpu_ids)
+				hp_stats_update(cpu, true);
+			else
+				action = TEGRA_HP_HOLD;
+			break;
+		case TEGRA_HP_CPU_DOWN:
+			cpu = tegra_get_slowest_cpu_n();
+			if (cpu < nr_cpu_ids)
+				hp_stats_update(cpu, false);
+			else
+				action = TEGRA_HP_HOLD;
+			break;
+		case TEGRA_HP_TO_LP:
+			if (!clk_set_parent(cpu_clk, cpu_lp_clk)) {
 				hp_stats_update(CONFIG_NR_CPUS, true);
 				hp_stats_update(0, false);
 				/* catch-up with governor target speed */
 				tegra_cpu_set_speed_cap(NULL);
 			} else
-				queue_delayed_work(
-					hotplug_wq, &hotplug_work, down_delay);
-		}
-		break;
-	case TEGRA_HP_UP:
-		if (is_lp_cluster() && !no_lp) {
-			if(!clk_set_parent(cpu_clk, cpu_g_clk)) {
+				action = TEGRA_HP_HOLD;
+			break;
+		case TEGRA_HP_TO_G:
+			if (!clk_set_parent(cpu_clk, cpu_g_clk)) {
 				hp_stats_update(CONFIG_NR_CPUS, false);
 				hp_stats_update(0, true);
 				/* catch-up with governor target speed */
 				tegra_cpu_set_speed_cap(NULL);
-			}
-		} else {
-			switch (tegra_cpu_speed_balance()) {
-			/* cpu speed is up and balanced - one more on-line */
-			case TEGRA_CPU_SPEED_BALANCED:
-				cpu = cpumask_next_zero(0, cpu_online_mask);
-				if (cpu < nr_cpu_ids) {
-					up = true;
-					hp_stats_update(cpu, true);
-				}
-				break;
-			/* cpu speed is up, but skewed - remove one core */
-			case TEGRA_CPU_SPEED_SKEWED:
-				cpu = tegra_get_slowest_cpu_n();
-				if (cpu < nr_cpu_ids) {
-					up = false;
-					hp_stats_update(cpu, false);
-				}
-				break;
-			/* cpu speed is up, but under-utilized - do nothing */
-			case TEGRA_CPU_SPEED_BIASED:
-			default:
-				break;
-			}
+			} else
+				action = TEGRA_HP_HOLD;
+			break;
+		default:
+			break;
 		}
-		queue_delayed_work(
-			hotplug_wq, &hotplug_work, up2gn_delay);
+
+		/* nothing left to take down: wait for the governor to kick us */
+		if ((hp_state == TEGRA_HP_DOWN) && (is_lp_cluster() ||
+		    (no_lp && (num_online_cpus() == 1))))
+			break;
+		queue_delayed_work(hotplug_wq, &hotplug_work, sample_delay);
 		break;
 	default:
 		pr_err("%s: invalid tegra hotplug state %d\n",
@@ -278,16 +320,25 @@ static void tegra_auto_hotplug_work_func(struct work_struct *work)
 	mutex_unlock(tegra3_cpu_lock);
 
 	if (cpu < nr_cpu_ids) {
-		if (up)
+		if (action == TEGRA_HP_CPU_UP)
 			cpu_up(cpu);
 		else
 			cpu_down(cpu);
 	}
+
+	if (action != TEGRA_HP_HOLD) {
+		ktime_t end = ktime_get();
+
+		mutex_lock(tegra3_cpu_lock);
+		tegra_hp_policy_account(&hp_policy, action, ktime_to_us(end),
+					ktime_us_delta(end, start));
+		mutex_unlock(tegra3_cpu_lock);
+	}
 }
 
 void tegra_auto_hotplug_governor(unsigned int cpu_freq, bool suspend)
 {
-	unsigned long up_delay, top_freq, bottom_freq;
+	unsigned long top_freq, bottom_freq;
 
 	if (!is_g_cluster_present())
 		return;
@@ -298,11 +349,9 @@ void tegra_auto_hotplug_governor(unsigned int cpu_freq, bool suspend)
 	}
 
 	if (is_lp_cluster()) {
-		up_delay = up2g0_delay;
 		top_freq = idle_top_freq;
 		bottom_freq = 0;
 	} else {
-		up_delay = up2gn_delay;
 		top_freq = idle_bottom_freq;
 		bottom_freq = idle_bottom_freq;
 	}
@@ -311,21 +360,23 @@ void tegra_auto_hotplug_governor(unsigned int cpu_freq, bool suspend)
 	case TEGRA_HP_DISABLED:
 		break;
 	case TEGRA_HP_IDLE:
+		/* requests seen before the policy went idle are stale */
+		hp_policy.pending = TEGRA_HP_HOLD;
 		if (cpu_freq > top_freq) {
 			hp_state = TEGRA_HP_UP;
 			queue_delayed_work(
-				hotplug_wq, &hotplug_work, up_delay);
+				hotplug_wq, &hotplug_work, sample_delay);
 		} else if (cpu_freq <= bottom_freq) {
 			hp_state = TEGRA_HP_DOWN;
 			queue_delayed_work(
-				hotplug_wq, &hotplug_work, down_delay);
+				hotplug_wq, &hotplug_work, sample_delay);
 		}
 		break;
 	case TEGRA_HP_DOWN:
 		if (cpu_freq > top_freq) {
 			hp_state = TEGRA_HP_UP;
 			queue_delayed_work(
-				hotplug_wq, &hotplug_work, up_delay);
+				hotplug_wq, &hotplug_work, sample_delay);
 		} else if (cpu_freq > bottom_freq) {
 			hp_state = TEGRA_HP_IDLE;
 		}
@@ -334,7 +385,7 @@ void tegra_auto_hotplug_governor(unsigned int cpu_freq, bool suspend)
 		if (cpu_freq <= bottom_freq) {
 			hp_state = TEGRA_HP_DOWN;
 			queue_delayed_work(
-				hotplug_wq, &hotplug_work, down_delay);
+				hotplug_wq, &hotplug_work, sample_delay);
 		} else if (cpu_freq <= top_freq) {
 			hp_state = TEGRA_HP_IDLE;
 		}
@@ -367,12 +418,17 @@ int tegra_auto_hotplug_init(struct mutex *cpu_lock)
 	idle_top_freq = clk_get_max_rate(cpu_lp_clk) / 1000;
 	idle_bottom_freq = clk_get_min_rate(cpu_g_clk) / 1000;
 
-	up2g0_delay = msecs_to_jiffies(UP2G0_DELAY_MS);
-	up2gn_delay = msecs_to_jiffies(UP2Gn_DELAY_MS);
-	down_delay = msecs_to_jiffies(DOWN_DELAY_MS);
+	sample_delay = msecs_to_jiffies(SAMPLE_DELAY_MS);
+	tegra_hp_policy_init(&hp_policy);
+
+	/* the policy defaults, tunable as jiffies like the other delays */
+	up2g0_delay = usecs_to_jiffies(hp_policy.to_g_dwell_us);
+	up2gn_delay = usecs_to_jiffies(hp_policy.up_dwell_us);
+	down_delay = usecs_to_jiffies(hp_policy.down_dwell_us);
 
 	tegra3_cpu_lock = cpu_lock;
 	hp_state = INITIAL_STATE;
+	set_avg_nr_running(hp_state != TEGRA_HP_DISABLED);
 	hp_init_stats();
 	pr_info("Tegra auto-hotplug initialized: %s\n",
 		(hp_state == TEGRA_HP_DISABLED) ? "disabled" : "enabled");
@@ -437,6 +493,44 @@ static const struct file_operations hp_stats_fops = {
 	.release	= single_release,
 };
 
+static int hp_policy_show(struct seq_file *s, void *data)
+{
+	static const char * const names[TEGRA_HP_NR_ACTIONS] = {
+		[TEGRA_HP_HOLD]		= "hold",
+		[TEGRA_HP_CPU_UP]	= "cpu up",
+		[TEGRA_HP_CPU_DOWN]	= "cpu down",
+		[TEGRA_HP_TO_LP]	= "switch to LP",
+		[TEGRA_HP_TO_G]		= "switch to G",
+	};
+	unsigned long nr_run = avg_nr_running();
+	int i;
+
+	seq_printf(s, "%-15s %lu.%02lu\n", "avg runnable:", nr_run >> FSHIFT,
+		   ((nr_run & (FIXED_1 - 1)) * 100) >> FSHIFT);
+
+	mutex_lock(tegra3_cpu_lock);
+	seq_printf(s, "%-15s %s\n", "pending:", names[hp_policy.pending]);
+	seq_printf(s, "\n%-15s %-10s %s\n", "transition", "count", "cost (us)");
+	for (i = TEGRA_HP_CPU_UP; i < TEGRA_HP_NR_ACTIONS; i++)
+		seq_printf(s, "%-15s %-10lu %llu\n", names[i],
+			   hp_policy.count[i], hp_policy.cost_us[i]);
+	mutex_unlock(tegra3_cpu_lock);
+
+	return 0;
+}
+
+static int hp_policy_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hp_policy_show, inode->i_private);
+}
+
+static const struct file_operations hp_policy_fops = {
+	.open		= hp_policy_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int max_cpus_get(void *data, u64 *val)
 {
 	*val = pm_qos_request(PM_QOS_MAX_ONLINE_CPUS);
@@ -469,6 +563,10 @@ static int __init tegra_auto_hotplug_debug_init(void)
 		"stats", S_IRUGO, hp_debugfs_root, NULL, &hp_stats_fops))
 		goto err_out;
 
+	if (!debugfs_create_file(
+		"policy", S_IRUGO, hp_debugfs_root, NULL, &hp_policy_fops))
+		goto err_out;
+
 	return 0;
 
 err_out:
@@ -176,6 +176,7 @@ bool tegra2_lp2_is_allowed(struct cpuidle_device *dev,
 static inline void tegra2_lp3_fall_back(struct cpuidle_device *dev)
 {
 	/* Not enough time left to enter LP2 */
+	sched_idle_set_exit_latency(dev->states[0].exit_latency);
 	tegra_cpu_wfi();
 
 	/* fall back here from LP2 path - tell cpuidle governor */
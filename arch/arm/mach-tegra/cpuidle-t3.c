@@ -159,6 +159,7 @@ bool tegra3_lp2_is_allowed(struct cpuidle_device *dev,
 
 static inline void tegra3_lp3_fall_back(struct cpuidle_device *dev)
 {
+	sched_idle_set_exit_latency(dev->states[0].exit_latency);
 	tegra_cpu_wfi();
 	/* fall back here from LP2 path - tell cpuidle governor */
 	dev->last_state = &dev->states[0];
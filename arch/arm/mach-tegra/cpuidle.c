@@ -104,8 +104,11 @@ static int tegra_idle_enter_lp2(struct cpuidle_device *dev,
 	s64 us;
 
 	if (!lp2_in_idle || lp2_disabled_by_suspend ||
-	    !tegra_lp2_is_allowed(dev, state))
+	    !tegra_lp2_is_allowed(dev, state)) {
+		/* cpuidle published the LP2 exit latency to the scheduler */
+		sched_idle_set_exit_latency(dev->states[0].exit_latency);
 		return tegra_idle_enter_lp3(dev, state);
+	}
 
 	local_irq_disable();
 	enter = ktime_get();
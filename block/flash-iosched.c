@@ -0,0 +1,594 @@
+/*
+ *  Flash i/o scheduler.
+ *
+ *  A scheduler for eMMC/SD style storage where seek distance carries no
+ *  cost. Sync requests, reads and sync writes, are served first-come
+ *  first-served with a latency target and ahead of readahead, async
+ *  writes are collected and dispatched in large ascending batches that
+ *  start on an erase block boundary, and discards are kept apart from
+ *  all of them so they only run when nothing more urgent is queued.
+ *
+ *  Based on the deadline i/o scheduler,
+ *  Copyright (C) 2002 Jens Axboe <axboe@kernel.dk>
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/compiler.h>
+#include <linux/rbtree.h>
+#include <linux/ktime.h>
+
+/*
+ * See Documentation/block/flash-iosched.txt
+ */
+static const int sync_expire = HZ / 8;	/* latency target for sync requests */
+static const int readahead_expire = HZ / 2; /* max time readahead waits */
+static const int write_expire = 2 * HZ;	/* max time before a write batch runs */
+static const int discard_expire = 10 * HZ; /* ditto for discards */
+static const int writes_starved = 4;	/* max reads dispatched ahead of an
+					   expired write batch */
+static const int write_batch_kb = 1024;	/* max size of one write batch */
+static const int erase_block_kb = 512;	/* write batch alignment */
+
+enum {
+	FLASH_SYNC,		/* reads and sync writes */
+	FLASH_READAHEAD,
+	FLASH_WRITE,		/* async writes */
+	FLASH_DISCARD,
+	FLASH_NR_CLASSES,
+};
+
+/*
+ * Completion latency buckets: bucket 0 is < 1ms, bucket n covers
+ * [2^(n-1), 2^n) ms and the last bucket collects everything above.
+ */
+#define FLASH_LAT_BUCKETS	12
+
+struct flash_data {
+	/*
+	 * run time data
+	 */
+
+	/*
+	 * requests are present on both sort_list and fifo_list of their class
+	 */
+	struct rb_root sort_list[FLASH_NR_CLASSES];
+	struct list_head fifo_list[FLASH_NR_CLASSES];
+
+	/*
+	 * next write of the running batch, NULL if no batch is running
+	 */
+	struct request *next_write;
+	unsigned int batch_sectors;	/* sectors dispatched in this batch */
+	unsigned int starved;		/* reads dispatched past expired writes */
+
+	unsigned long lat_hist[FLASH_NR_CLASSES][FLASH_LAT_BUCKETS];
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int fifo_expire[FLASH_NR_CLASSES];
+	int writes_starved;
+	int write_batch_kb;
+	int erase_block_kb;
+	int front_merges;
+};
+
+static inline int flash_class(unsigned int rw_flags)
+{
+	if (rw_flags & REQ_DISCARD)
+		return FLASH_DISCARD;
+	if (!rw_is_sync(rw_flags))
+		return FLASH_WRITE;
+	if (!(rw_flags & REQ_WRITE) && (rw_flags & REQ_RAHEAD))
+		return FLASH_READAHEAD;
+
+	return FLASH_SYNC;
+}
+
+static inline int flash_rq_class(struct request *rq)
+{
+	return flash_class(rq->cmd_flags);
+}
+
+static inline int flash_bio_class(struct bio *bio)
+{
+	return flash_class(bio->bi_rw);
+}
+
+static inline struct rb_root *
+flash_rb_root(struct flash_data *fd, struct request *rq)
+{
+	return &fd->sort_list[flash_rq_class(rq)];
+}
+
+/*
+ * The insertion time, in microseconds, is kept in the first elevator
+ * private pointer for the latency histograms.
+ */
+static inline unsigned long flash_now_us(void)
+{
+	return (unsigned long)ktime_to_us(ktime_get());
+}
+
+static inline unsigned long flash_rq_insert_time(struct request *rq)
+{
+	return (unsigned long)rq->elevator_private[0];
+}
+
+static inline void flash_rq_set_insert_time(struct request *rq)
+{
+	rq->elevator_private[0] = (void *)flash_now_us();
+}
+
+static inline struct request *flash_latter_request(struct request *rq)
+{
+	struct rb_node *node = rb_next(&rq->rb_node);
+
+	if (node)
+		return rb_entry_rq(node);
+
+	return NULL;
+}
+
+/*
+ * find the first request at or above @sector in @root
+ */
+static struct request *flash_rb_ceil(struct rb_root *root, sector_t sector)
+{
+	struct rb_node *n = root->rb_node;
+	struct request *rq, *ceil = NULL;
+
+	while (n) {
+		rq = rb_entry_rq(n);
+
+		if (blk_rq_pos(rq) < sector)
+			n = n->rb_right;
+		else {
+			ceil = rq;
+			n = n->rb_left;
+		}
+	}
+
+	return ceil;
+}
+
+static void flash_move_to_dispatch(struct flash_data *fd, struct request *rq);
+
+static void flash_add_rq_rb(struct flash_data *fd, struct request *rq)
+{
+	struct rb_root *root = flash_rb_root(fd, rq);
+	struct request *__alias;
+
+	while (unlikely(__alias = elv_rb_add(root, rq)))
+		flash_move_to_dispatch(fd, __alias);
+}
+
+static inline void flash_del_rq_rb(struct flash_data *fd, struct request *rq)
+{
+	if (fd->next_write == rq)
+		fd->next_write = flash_latter_request(rq);
+
+	elv_rb_del(flash_rb_root(fd, rq), rq);
+}
+
+/*
+ * add rq to rbtree and fifo
+ */
+static void flash_add_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int class = flash_rq_class(rq);
+
+	flash_add_rq_rb(fd, rq);
+
+	/*
+	 * set expire time and add to fifo list
+	 */
+	flash_rq_set_insert_time(rq);
+	rq_set_fifo_time(rq, jiffies + fd->fifo_expire[class]);
+	list_add_tail(&rq->queuelist, &fd->fifo_list[class]);
+}
+
+/*
+ * remove rq from rbtree and fifo.
+ */
+static void flash_remove_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	rq_fifo_clear(rq);
+	flash_del_rq_rb(fd, rq);
+}
+
+static int
+flash_merge(struct request_queue *q, struct request **req, struct bio *bio)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	struct request *__rq;
+
+	/*
+	 * check for front merge, back merges are found through the
+	 * elevator hash
+	 */
+	if (fd->front_merges) {
+		sector_t sector = bio->bi_sector + bio_sectors(bio);
+
+		__rq = elv_rb_find(&fd->sort_list[flash_bio_class(bio)],
+				   sector);
+		if (__rq) {
+			BUG_ON(sector != blk_rq_pos(__rq));
+
+			if (elv_rq_merge_ok(__rq, bio)) {
+				*req = __rq;
+				return ELEVATOR_FRONT_MERGE;
+			}
+		}
+	}
+
+	return ELEVATOR_NO_MERGE;
+}
+
+/*
+ * a request only takes bios of its own class, so that neither a sync
+ * write nor a demand read ends up waiting in a slower class
+ */
+static int flash_allow_merge(struct request_queue *q, struct request *rq,
+			     struct bio *bio)
+{
+	return flash_bio_class(bio) == flash_rq_class(rq);
+}
+
+static void flash_merged_request(struct request_queue *q,
+				 struct request *req, int type)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	/*
+	 * if the merge was a front merge, we need to reposition request
+	 */
+	if (type == ELEVATOR_FRONT_MERGE) {
+		elv_rb_del(flash_rb_root(fd, req), req);
+		flash_add_rq_rb(fd, req);
+	}
+}
+
+static void
+flash_merged_requests(struct request_queue *q, struct request *req,
+		      struct request *next)
+{
+	/*
+	 * if next expires before rq, assign its expire and insert time
+	 * to rq and move into next position (next will be deleted) in fifo
+	 */
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist)) {
+		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
+			list_move(&req->queuelist, &next->queuelist);
+			rq_set_fifo_time(req, rq_fifo_time(next));
+			req->elevator_private[0] = next->elevator_private[0];
+		}
+	}
+
+	/*
+	 * kill knowledge of next, this one is a goner
+	 */
+	flash_remove_request(q, next);
+}
+
+/*
+ * move request from sort list to dispatch queue.
+ */
+static void flash_move_to_dispatch(struct flash_data *fd, struct request *rq)
+{
+	struct request_queue *q = rq->q;
+
+	flash_remove_request(q, rq);
+	elv_dispatch_add_tail(q, rq);
+}
+
+/*
+ * returns 1 if the oldest request of @class has expired.
+ * Requires !list_empty(&fd->fifo_list[class])
+ */
+static inline int flash_check_fifo(struct flash_data *fd, int class)
+{
+	struct request *rq = rq_entry_fifo(fd->fifo_list[class].next);
+
+	return time_after(jiffies, rq_fifo_time(rq));
+}
+
+/*
+ * Start a write batch at the lowest queued write inside the erase block
+ * of the oldest write, so the batch covers whole erase blocks in
+ * ascending order.
+ */
+static struct request *flash_start_write_batch(struct flash_data *fd)
+{
+	struct request *oldest = rq_entry_fifo(fd->fifo_list[FLASH_WRITE].next);
+	sector_t start = blk_rq_pos(oldest), tmp = start;
+	unsigned int erase_sectors = fd->erase_block_kb << 1;
+	struct request *rq;
+
+	if (erase_sectors)
+		start -= sector_div(tmp, erase_sectors);
+
+	rq = flash_rb_ceil(&fd->sort_list[FLASH_WRITE], start);
+	if (!rq)
+		rq = oldest;
+
+	fd->batch_sectors = 0;
+	fd->starved = 0;
+
+	return rq;
+}
+
+static void flash_dispatch_write(struct flash_data *fd, struct request *rq)
+{
+	fd->batch_sectors += blk_rq_sectors(rq);
+	fd->next_write = flash_latter_request(rq);
+	flash_move_to_dispatch(fd, rq);
+}
+
+/*
+ * flash_dispatch_requests selects the next request: expired sync requests
+ * break a running write batch, otherwise the batch runs to write_batch_kb.
+ * Between batches sync requests go first and readahead next, unless
+ * readahead has expired, and both yield to writes that have expired and
+ * been starved for writes_starved dispatches. Discards only run when
+ * nothing else is queued or when they expire.
+ */
+static int flash_dispatch_requests(struct request_queue *q, int force)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int syncs = !list_empty(&fd->fifo_list[FLASH_SYNC]);
+	const int readaheads = !list_empty(&fd->fifo_list[FLASH_READAHEAD]);
+	const int writes = !list_empty(&fd->fifo_list[FLASH_WRITE]);
+	const int discards = !list_empty(&fd->fifo_list[FLASH_DISCARD]);
+	struct request *rq;
+	int class;
+
+	if (fd->next_write &&
+	    fd->batch_sectors < (fd->write_batch_kb << 1) &&
+	    !(syncs && flash_check_fifo(fd, FLASH_SYNC))) {
+		flash_dispatch_write(fd, fd->next_write);
+		return 1;
+	}
+	fd->next_write = NULL;
+
+	if (discards && flash_check_fifo(fd, FLASH_DISCARD))
+		goto dispatch_discard;
+
+	if (syncs || readaheads) {
+		if (writes && flash_check_fifo(fd, FLASH_WRITE) &&
+		    fd->starved++ >= fd->writes_starved)
+			goto dispatch_writes;
+
+		class = FLASH_SYNC;
+		if (!syncs ||
+		    (readaheads && flash_check_fifo(fd, FLASH_READAHEAD)))
+			class = FLASH_READAHEAD;
+
+		rq = rq_entry_fifo(fd->fifo_list[class].next);
+		flash_move_to_dispatch(fd, rq);
+		return 1;
+	}
+
+	if (writes) {
+dispatch_writes:
+		flash_dispatch_write(fd, flash_start_write_batch(fd));
+		return 1;
+	}
+
+	if (discards) {
+dispatch_discard:
+		rq = rq_entry_fifo(fd->fifo_list[FLASH_DISCARD].next);
+		flash_move_to_dispatch(fd, rq);
+		return 1;
+	}
+
+	return 0;
+}
+
+static void flash_completed_request(struct request_queue *q,
+				    struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	unsigned long msecs;
+	int bucket;
+
+	msecs = (flash_now_us() - flash_rq_insert_time(rq)) / USEC_PER_MSEC;
+	bucket = min_t(int, fls_long(msecs), FLASH_LAT_BUCKETS - 1);
+	fd->lat_hist[flash_rq_class(rq)][bucket]++;
+}
+
+static void flash_exit_queue(struct elevator_queue *e)
+{
+	struct flash_data *fd = e->elevator_data;
+	int i;
+
+	for (i = 0; i < FLASH_NR_CLASSES; i++)
+		BUG_ON(!list_empty(&fd->fifo_list[i]));
+
+	kfree(fd);
+}
+
+/*
+ * initialize elevator private data (flash_data).
+ */
+static void *flash_init_queue(struct request_queue *q)
+{
+	struct flash_data *fd;
+	int i;
+
+	fd = kmalloc_node(sizeof(*fd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!fd)
+		return NULL;
+
+	for (i = 0; i < FLASH_NR_CLASSES; i++) {
+		INIT_LIST_HEAD(&fd->fifo_list[i]);
+		fd->sort_list[i] = RB_ROOT;
+	}
+	fd->fifo_expire[FLASH_SYNC] = sync_expire;
+	fd->fifo_expire[FLASH_READAHEAD] = readahead_expire;
+	fd->fifo_expire[FLASH_WRITE] = write_expire;
+	fd->fifo_expire[FLASH_DISCARD] = discard_expire;
+	fd->writes_starved = writes_starved;
+	fd->write_batch_kb = write_batch_kb;
+	fd->erase_block_kb = erase_block_kb;
+	fd->front_merges = 1;
+	return fd;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+flash_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+flash_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return flash_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(flash_sync_expire_show, fd->fifo_expire[FLASH_SYNC], 1);
+SHOW_FUNCTION(flash_readahead_expire_show, fd->fifo_expire[FLASH_READAHEAD], 1);
+SHOW_FUNCTION(flash_write_expire_show, fd->fifo_expire[FLASH_WRITE], 1);
+SHOW_FUNCTION(flash_discard_expire_show, fd->fifo_expire[FLASH_DISCARD], 1);
+SHOW_FUNCTION(flash_writes_starved_show, fd->writes_starved, 0);
+SHOW_FUNCTION(flash_write_batch_kb_show, fd->write_batch_kb, 0);
+SHOW_FUNCTION(flash_erase_block_kb_show, fd->erase_block_kb, 0);
+SHOW_FUNCTION(flash_front_merges_show, fd->front_merges, 0);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data;							\
+	int ret = flash_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(flash_sync_expire_store, &fd->fifo_expire[FLASH_SYNC], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_readahead_expire_store, &fd->fifo_expire[FLASH_READAHEAD], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_write_expire_store, &fd->fifo_expire[FLASH_WRITE], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_discard_expire_store, &fd->fifo_expire[FLASH_DISCARD], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_writes_starved_store, &fd->writes_starved, 0, INT_MAX, 0);
+STORE_FUNCTION(flash_write_batch_kb_store, &fd->write_batch_kb, 4, INT_MAX >> 1, 0);
+STORE_FUNCTION(flash_erase_block_kb_store, &fd->erase_block_kb, 0, INT_MAX >> 1, 0);
+STORE_FUNCTION(flash_front_merges_store, &fd->front_merges, 0, 1, 0);
+#undef STORE_FUNCTION
+
+static ssize_t flash_lat_hist_show(struct flash_data *fd, int class,
+				   char *page)
+{
+	char *p = page;
+	int i;
+
+	for (i = 0; i < FLASH_LAT_BUCKETS; i++)
+		p += sprintf(p, "%lu ", fd->lat_hist[class][i]);
+	p[-1] = '\n';
+
+	return p - page;
+}
+
+#define HIST_FUNCTION(__FUNC, __CLASS)					\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	return flash_lat_hist_show(e->elevator_data, __CLASS, page);	\
+}
+HIST_FUNCTION(flash_sync_lat_hist_show, FLASH_SYNC);
+HIST_FUNCTION(flash_readahead_lat_hist_show, FLASH_READAHEAD);
+HIST_FUNCTION(flash_write_lat_hist_show, FLASH_WRITE);
+HIST_FUNCTION(flash_discard_lat_hist_show, FLASH_DISCARD);
+#undef HIST_FUNCTION
+
+#define FD_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, flash_##name##_show, \
+				      flash_##name##_store)
+
+#define FD_ATTR_RO(name) \
+	__ATTR(name, S_IRUGO, flash_##name##_show, NULL)
+
+static struct elv_fs_entry flash_attrs[] = {
+	FD_ATTR(sync_expire),
+	FD_ATTR(readahead_expire),
+	FD_ATTR(write_expire),
+	FD_ATTR(discard_expire),
+	FD_ATTR(writes_starved),
+	FD_ATTR(write_batch_kb),
+	FD_ATTR(erase_block_kb),
+	FD_ATTR(front_merges),
+	FD_ATTR_RO(sync_lat_hist),
+	FD_ATTR_RO(readahead_lat_hist),
+	FD_ATTR_RO(write_lat_hist),
+	FD_ATTR_RO(discard_lat_hist),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_flash = {
+	.ops = {
+		.elevator_merge_fn = 		flash_merge,
+		.elevator_allow_merge_fn =	flash_allow_merge,
+		.elevator_merged_fn =		flash_merged_request,
+		.elevator_merge_req_fn =	flash_merged_requests,
+		.elevator_dispatch_fn =		flash_dispatch_requests,
+		.elevator_add_req_fn =		flash_add_request,
+		.elevator_completed_req_fn =	flash_completed_request,
+		.elevator_former_req_fn =	elv_rb_former_request,
+		.elevator_latter_req_fn =	elv_rb_latter_request,
+		.elevator_init_fn =		flash_init_queue,
+		.elevator_exit_fn =		flash_exit_queue,
+	},
+
+	.elevator_attrs = flash_attrs,
+	.elevator_name = "flash",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init flash_init(void)
+{
+	elv_register(&iosched_flash);
+
+	return 0;
+}
+
+static void __exit flash_exit(void)
+{
+	elv_unregister(&iosched_flash);
+}
+
+module_init(flash_init);
+module_exit(flash_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("flash IO scheduler");
@@ -99,9 +99,11 @@ static void cpuidle_idle_call(void)
 
 	trace_power_start(POWER_CSTATE, next_state, dev->cpu);
 	trace_cpu_idle(next_state, dev->cpu);
+	sched_idle_set_exit_latency(target_state->exit_latency);
 
 	dev->last_residency = target_state->enter(dev, target_state);
 
+	sched_idle_set_exit_latency(0);
 	trace_power_end(dev->cpu);
 	trace_cpu_idle(PWR_EVENT_EXIT, dev->cpu);
 
@@ -70,6 +70,11 @@
  * simultaneous inserts (A into B and B into A) from racing and
  * constructing a cycle without either insert observing that it is
  * going to.
+ * The poll callback itself does not take "ep->lock" to queue an item:
+ * it pushes the item on the lockless "ep->pushlist" stack and only
+ * the callback that finds the stack empty takes "ep->lock", to wake
+ * up the waiters. The stack is drained into "ep->rdllist" by holders
+ * of "ep->mtx", under "ep->lock".
  * It is possible to drop the "ep->mtx" and to use the global
  * mutex "epmutex" (together with "ep->lock") to have it working,
  * but having "ep->mtx" will make the interface more scalable.
@@ -126,8 +131,8 @@ struct epitem {
 	struct list_head rdllink;
 
 	/*
-	 * Works together "struct eventpoll"->ovflist in keeping the
-	 * single linked chain of items.
+	 * Links the item on "struct eventpoll"->pushlist. EP_UNACTIVE_PTR
+	 * while the item is not queued there.
 	 */
 	struct epitem *next;
 
@@ -180,11 +185,10 @@ struct eventpoll {
 	struct rb_root rbr;
 
 	/*
-	 * This is a single linked list that chains all the "struct epitem" that
-	 * happened while transferring ready events to userspace w/out
-	 * holding ->lock.
+	 * Lockless stack of "struct epitem" pushed by the poll callback,
+	 * drained into rdllist by ep_drain_ready().
 	 */
-	struct epitem *ovflist;
+	struct epitem *pushlist;
 
 	/* The user that created the eventpoll descriptor */
 	struct user_struct *user;
@@ -325,7 +329,76 @@ static void ep_nested_calls_init(struct nested_calls *ncalls)
  */
 static inline int ep_events_available(struct eventpoll *ep)
 {
-	return !list_empty(&ep->rdllist) || ep->ovflist != EP_UNACTIVE_PTR;
+	return !list_empty(&ep->rdllist) || ACCESS_ONCE(ep->pushlist) != NULL;
+}
+
+/**
+ * ep_push_ready - Queues an item on the lockless ready stack. Safe to call
+ *                 from any context and from many CPUs at once.
+ *
+ * @ep: Pointer to the eventpoll context.
+ * @epi: Pointer to the item to queue.
+ *
+ * Returns: Returns true if the stack was empty, in which case the caller
+ *          is responsible for waking up the waiters. Items pushed on a
+ *          non empty stack are collected by the same wakeup.
+ */
+static inline bool ep_push_ready(struct eventpoll *ep, struct epitem *epi)
+{
+	struct epitem *head;
+
+	/* Claim the item, if it is already queued there is nothing to do */
+	if (cmpxchg(&epi->next, EP_UNACTIVE_PTR, NULL) != EP_UNACTIVE_PTR)
+		return false;
+
+	do {
+		head = ACCESS_ONCE(ep->pushlist);
+		epi->next = head;
+	} while (cmpxchg(&ep->pushlist, head, epi) != head);
+
+	return head == NULL;
+}
+
+/**
+ * ep_drain_ready - Moves all the items of the lockless ready stack to the
+ *                  ready list, in the order they were pushed. Must be
+ *                  called with "mtx" and "ep->lock" held.
+ *
+ * @ep: Pointer to the eventpoll context.
+ */
+static void ep_drain_ready(struct eventpoll *ep)
+{
+	struct epitem *epi, *nepi, *chain = NULL;
+
+	/* Reverse the stack, producers cannot touch the claimed items */
+	for (epi = xchg(&ep->pushlist, NULL); epi; epi = nepi) {
+		nepi = epi->next;
+		epi->next = chain;
+		chain = epi;
+	}
+
+	for (; (epi = chain) != NULL; ) {
+		chain = epi->next;
+		/*
+		 * Release the item before linking it, so that a new event
+		 * arriving from now on queues it again.
+		 */
+		epi->next = EP_UNACTIVE_PTR;
+		/*
+		 * The item may already be on the ready list, or on the
+		 * transfer list of ep_scan_ready_list(), which is spliced
+		 * back later.
+		 */
+		if (!ep_is_linked(&epi->rdllink))
+			list_add_tail(&epi->rdllink, &ep->rdllist);
+	}
+
+	/*
+	 * Order the releases above before the f_op->poll() calls of our
+	 * caller, otherwise an event arriving in between could find the
+	 * item still claimed and be lost.
+	 */
+	smp_mb();
 }
 
 /**
@@ -474,7 +547,6 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 {
 	int error, pwake = 0;
 	unsigned long flags;
-	struct epitem *epi, *nepi;
 	LIST_HEAD(txlist);
 
 	/*
@@ -484,16 +556,15 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 	mutex_lock(&ep->mtx);
 
 	/*
-	 * Steal the ready list, and re-init the original one to the
-	 * empty list. Also, set ep->ovflist to NULL so that events
-	 * happening while looping w/out locks, are not lost. We cannot
-	 * have the poll callback to queue directly on ep->rdllist,
-	 * because we want the "sproc" callback to be able to do it
-	 * in a lockless way.
+	 * Collect the items pushed by the poll callback, then steal the
+	 * ready list and re-init the original one to the empty list.
+	 * The poll callback never touches ep->rdllist, so the "sproc"
+	 * callback can do it in a lockless way, and events happening
+	 * meanwhile wait on ep->pushlist.
 	 */
 	spin_lock_irqsave(&ep->lock, flags);
+	ep_drain_ready(ep);
 	list_splice_init(&ep->rdllist, &txlist);
-	ep->ovflist = NULL;
 	spin_unlock_irqrestore(&ep->lock, flags);
 
 	/*
@@ -505,25 +576,9 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 	/*
 	 * During the time we spent inside the "sproc" callback, some
 	 * other events might have been queued by the poll callback.
-	 * We re-insert them inside the main ready-list here.
+	 * We insert them inside the main ready-list here.
 	 */
-	for (nepi = ep->ovflist; (epi = nepi) != NULL;
-	     nepi = epi->next, epi->next = EP_UNACTIVE_PTR) {
-		/*
-		 * We need to check if the item is already in the list.
-		 * During the "sproc" callback execution time, items are
-		 * queued into ->ovflist but the "txlist" might already
-		 * contain them, and the list_splice() below takes care of them.
-		 */
-		if (!ep_is_linked(&epi->rdllink))
-			list_add_tail(&epi->rdllink, &ep->rdllist);
-	}
-	/*
-	 * We need to set back ep->ovflist to EP_UNACTIVE_PTR, so that after
-	 * releasing the lock, events will be queued in the normal way inside
-	 * ep->rdllist.
-	 */
-	ep->ovflist = EP_UNACTIVE_PTR;
+	ep_drain_ready(ep);
 
 	/*
 	 * Quickly re-inject items left on "txlist".
@@ -579,6 +634,9 @@ static int ep_remove(struct eventpoll *ep, struct epitem *epi)
 	rb_erase(&epi->rbn, &ep->rbr);
 
 	spin_lock_irqsave(&ep->lock, flags);
+	/* The poll hooks are gone, so nobody can push the item anymore */
+	if (epi->next != EP_UNACTIVE_PTR)
+		ep_drain_ready(ep);
 	if (ep_is_linked(&epi->rdllink))
 		list_del_init(&epi->rdllink);
 	spin_unlock_irqrestore(&ep->lock, flags);
@@ -763,7 +821,7 @@ static int ep_alloc(struct eventpoll **pep)
 	init_waitqueue_head(&ep->poll_wait);
 	INIT_LIST_HEAD(&ep->rdllist);
 	ep->rbr = RB_ROOT;
-	ep->ovflist = EP_UNACTIVE_PTR;
+	ep->pushlist = NULL;
 	ep->user = user;
 
 	*pep = ep;
@@ -811,13 +869,10 @@ static struct epitem *ep_find(struct eventpoll *ep, struct file *file, int fd)
  */
 static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *key)
 {
-	int pwake = 0;
 	unsigned long flags;
 	struct epitem *epi = ep_item_from_wait(wait);
 	struct eventpoll *ep = epi->ep;
 
-	spin_lock_irqsave(&ep->lock, flags);
-
 	/*
 	 * If the event mask does not contain any poll(2) event, we consider the
 	 * descriptor to be disabled. This condition is likely the effect of the
@@ -825,7 +880,7 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	 * until the next EPOLL_CTL_MOD will be issued.
 	 */
 	if (!(epi->event.events & ~EP_PRIVATE_BITS))
-		goto out_unlock;
+		return 1;
 
 	/*
 	 * Check the events coming with the callback. At this stage, not
@@ -834,40 +889,27 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	 * test for "key" != NULL before the event match test.
 	 */
 	if (key && !((unsigned long) key & epi->event.events))
-		goto out_unlock;
+		return 1;
 
 	/*
-	 * If we are transferring events to userspace, we can hold no locks
-	 * (because we're accessing user memory, and because of linux f_op->poll()
-	 * semantics). All the events that happen during that period of time are
-	 * chained in ep->ovflist and requeued later on.
+	 * Queue the item without taking any lock. Only the event that finds
+	 * the stack empty has to wake up the waiters: the ones queued behind
+	 * it are collected by the same wakeup, in a single batch.
 	 */
-	if (unlikely(ep->ovflist != EP_UNACTIVE_PTR)) {
-		if (epi->next == EP_UNACTIVE_PTR) {
-			epi->next = ep->ovflist;
-			ep->ovflist = epi;
-		}
-		goto out_unlock;
-	}
-
-	/* If this file is already in the ready list we exit soon */
-	if (!ep_is_linked(&epi->rdllink))
-		list_add_tail(&epi->rdllink, &ep->rdllist);
+	if (!ep_push_ready(ep, epi))
+		return 1;
 
 	/*
-	 * Wake up ( if active ) both the eventpoll wait list and the ->poll()
-	 * wait list.
+	 * The push above is a full barrier, and ep_poll() checks
+	 * ep->pushlist after queueing itself on ep->wq, so either we see
+	 * the waiter here or it sees our item and does not sleep.
 	 */
-	if (waitqueue_active(&ep->wq))
+	if (waitqueue_active(&ep->wq)) {
+		spin_lock_irqsave(&ep->lock, flags);
 		wake_up_locked(&ep->wq);
+		spin_unlock_irqrestore(&ep->lock, flags);
+	}
 	if (waitqueue_active(&ep->poll_wait))
-		pwake++;
-
-out_unlock:
-	spin_unlock_irqrestore(&ep->lock, flags);
-
-	/* We have to call this outside the lock */
-	if (pwake)
 		ep_poll_safewake(&ep->poll_wait);
 
 	return 1;
@@ -1005,11 +1047,13 @@ error_unregister:
 
 	/*
 	 * We need to do this because an event could have been arrived on some
-	 * allocated wait queue. Note that we don't care about the ep->ovflist
-	 * list, since that is used/cleaned only inside a section bound by "mtx".
-	 * And ep_insert() is called with "mtx" held.
+	 * allocated wait queue, and the item may sit on ep->pushlist. The
+	 * stack is only drained by holders of "mtx", and ep_insert() is
+	 * called with "mtx" held.
 	 */
 	spin_lock_irqsave(&ep->lock, flags);
+	if (epi->next != EP_UNACTIVE_PTR)
+		ep_drain_ready(ep);
 	if (ep_is_linked(&epi->rdllink))
 		list_del_init(&epi->rdllink);
 	spin_unlock_irqrestore(&ep->lock, flags);
@@ -1116,7 +1160,7 @@ static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 				 * into ep->rdllist besides us. The epoll_ctl()
 				 * callers are locked out by
 				 * ep_scan_ready_list() holding "mtx" and the
-				 * poll callback will queue them in ep->ovflist.
+				 * poll callback will queue them in ep->pushlist.
 				 */
 				list_add_tail(&epi->rdllink, &ep->rdllist);
 			}
@@ -401,7 +401,6 @@ static void __ocfs2_set_buffer_uptodate(struct ocfs2_caching_info *ci,
 					sector_t block,
 					int expand_tree)
 {
-	int i;
 	struct ocfs2_meta_cache_item *new = NULL;
 	struct ocfs2_meta_cache_item *tree[OCFS2_CACHE_INFO_MAX_ARRAY] =
 		{ NULL, };
@@ -420,16 +419,15 @@ static void __ocfs2_set_buffer_uptodate(struct ocfs2_caching_info *ci,
 	if (expand_tree) {
 		/* Do *not* allocate an array here - the removal code
 		 * has no way of tracking that. */
-		for (i = 0; i < OCFS2_CACHE_INFO_MAX_ARRAY; i++) {
-			tree[i] = kmem_cache_alloc(ocfs2_uptodate_cachep,
-						   GFP_NOFS);
-			if (!tree[i]) {
-				mlog_errno(-ENOMEM);
-				goto out_free;
-			}
-
-			/* These are initialized in ocfs2_expand_cache! */
+		if (!kmem_cache_alloc_bulk(ocfs2_uptodate_cachep, GFP_NOFS,
+					   OCFS2_CACHE_INFO_MAX_ARRAY,
+					   (void **)tree)) {
+			tree[0] = NULL;
+			mlog_errno(-ENOMEM);
+			goto out_free;
 		}
+
+		/* These are initialized in ocfs2_expand_cache! */
 	}
 
 	ocfs2_metadata_cache_lock(ci);
@@ -453,13 +451,10 @@ out_free:
 		kmem_cache_free(ocfs2_uptodate_cachep, new);
 
 	/* If these were used, then ocfs2_expand_cache re-set them to
-	 * NULL for us. */
-	if (tree[0]) {
-		for (i = 0; i < OCFS2_CACHE_INFO_MAX_ARRAY; i++)
-			if (tree[i])
-				kmem_cache_free(ocfs2_uptodate_cachep,
-						tree[i]);
-	}
+	 * NULL for us. They are allocated and used all together. */
+	if (tree[0])
+		kmem_cache_free_bulk(ocfs2_uptodate_cachep,
+				     OCFS2_CACHE_INFO_MAX_ARRAY, (void **)tree);
 }
 
 /* Item insertion is guarded by co_io_lock(), so the insertion path takes
@@ -40,6 +40,9 @@ typedef int (congested_fn)(void *, int);
 enum bdi_stat_item {
 	BDI_RECLAIMABLE,
 	BDI_WRITEBACK,
+	BDI_READAHEAD,			/* pages read ahead */
+	BDI_READAHEAD_HIT,		/* ... and then used */
+	BDI_READAHEAD_WASTED,		/* ... and dropped unused */
 	NR_BDI_STAT_ITEMS
 };
 
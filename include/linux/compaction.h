@@ -18,6 +18,10 @@ extern int sysctl_compaction_handler(struct ctl_table *table, int write,
 extern int sysctl_extfrag_threshold;
 extern int sysctl_extfrag_handler(struct ctl_table *table, int write,
 			void __user *buffer, size_t *length, loff_t *ppos);
+extern int sysctl_kcompactd_order;
+extern int sysctl_kcompactd_threshold;
+extern int sysctl_kcompactd_interval_ms;
+extern int sysctl_kcompactd_budget_ms;
 
 extern int fragmentation_index(struct zone *zone, unsigned int order);
 extern unsigned long try_to_compact_pages(struct zonelist *zonelist,
@@ -26,6 +30,9 @@ extern unsigned long try_to_compact_pages(struct zonelist *zonelist,
 extern unsigned long compaction_suitable(struct zone *zone, int order);
 extern unsigned long compact_zone_order(struct zone *zone, int order,
 					gfp_t gfp_mask, bool sync);
+extern void kcompactd_run(struct pglist_data *pgdat);
+extern void kcompactd_stop(struct pglist_data *pgdat);
+extern void wakeup_kcompactd(struct zone *zone, int order);
 
 /* Do not skip compaction more than 64 times */
 #define COMPACT_MAX_DEFER_SHIFT 6
@@ -84,6 +91,18 @@ static inline bool compaction_deferred(struct zone *zone)
 	return 1;
 }
 
+static inline void kcompactd_run(struct pglist_data *pgdat)
+{
+}
+
+static inline void kcompactd_stop(struct pglist_data *pgdat)
+{
+}
+
+static inline void wakeup_kcompactd(struct zone *zone, int order)
+{
+}
+
 #endif /* CONFIG_COMPACTION */
 
 #if defined(CONFIG_COMPACTION) && defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
@@ -916,6 +916,12 @@ struct file_ra_state {
 	unsigned int ra_pages;		/* Maximum readahead window */
 	unsigned int mmap_miss;		/* Cache miss stat for mmap accesses */
 	loff_t prev_pos;		/* Cache last read() position */
+
+	pgoff_t prev_miss;		/* last synchronous readahead */
+	long stride;			/* its distance from the one before */
+	unsigned int stride_hits;	/* misses in a row at that stride */
+	unsigned int limit;		/* window cap after thrashing, or 0 */
+	pgoff_t used;			/* read ahead pages below were used */
 };
 
 /*
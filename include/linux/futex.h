@@ -185,6 +185,25 @@ static inline void exit_pi_state_list(struct task_struct *curr)
 {
 }
 #endif
+
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+extern int futex_hash_dup(struct mm_struct *mm, struct mm_struct *oldmm);
+extern void futex_hash_free(struct mm_struct *mm);
+extern long futex_hash_prctl(int option, unsigned long arg2);
+#else
+static inline int futex_hash_dup(struct mm_struct *mm,
+				 struct mm_struct *oldmm)
+{
+	return 0;
+}
+static inline void futex_hash_free(struct mm_struct *mm)
+{
+}
+static inline long futex_hash_prctl(int option, unsigned long arg2)
+{
+	return -EINVAL;
+}
+#endif
 #endif /* __KERNEL__ */
 
 #define FUTEX_OP_SET		0	/* *(int *)UADDR2 = OPARG; */
@@ -317,6 +317,10 @@ struct mm_struct {
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
 	pgtable_t pmd_huge_pte; /* protected by page_table_lock */
 #endif
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+	/* hash table for PROCESS_PRIVATE futexes, see kernel/futex.c */
+	struct futex_private_hash *futex_hash;
+#endif
 };
 
 /* Future-safe accessor for struct mm_struct's cpu_vm_mask. */
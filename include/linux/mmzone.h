@@ -106,6 +106,8 @@ enum zone_stat_item {
 	NR_SHMEM,		/* shmem pages (included tmpfs/GEM pages) */
 	NR_DIRTIED,		/* page dirtyings since bootup */
 	NR_WRITTEN,		/* page writings since bootup */
+	WORKINGSET_REFAULT,	/* evicted file pages faulted back in */
+	WORKINGSET_ACTIVATE,	/* ... close enough to go straight active */
 #ifdef CONFIG_NUMA
 	NUMA_HIT,		/* allocated in intended node */
 	NUMA_MISS,		/* allocated in non intended node */
@@ -169,6 +171,21 @@ enum zone_watermarks {
 #define low_wmark_pages(z) (z->watermark[WMARK_LOW])
 #define high_wmark_pages(z) (z->watermark[WMARK_HIGH])
 
+/*
+ * Orders 1 to PCP_HIGH_ORDER (kernel stacks, skb data, slab pages) are
+ * cached per cpu as well, in orders[order - 1].
+ */
+#define PCP_HIGH_ORDER		3
+
+struct per_cpu_order_pages {
+	int count;		/* number of blocks in the lists */
+	unsigned long hit;	/* allocations served from the lists */
+	unsigned long miss;	/* allocations that had to refill them */
+
+	/* Lists of blocks, one per migrate type */
+	struct list_head lists[MIGRATE_PCPTYPES];
+};
+
 struct per_cpu_pages {
 	int count;		/* number of pages in the list */
 	int high;		/* high watermark, emptying needed */
@@ -176,6 +193,8 @@ struct per_cpu_pages {
 
 	/* Lists of pages, one per migrate type stored on the pcp-lists */
 	struct list_head lists[MIGRATE_PCPTYPES];
+
+	struct per_cpu_order_pages orders[PCP_HIGH_ORDER];
 };
 
 struct per_cpu_pageset {
@@ -339,8 +358,32 @@ struct zone {
 	 */
 	unsigned int		compact_considered;
 	unsigned int		compact_defer_shift;
+
+	/*
+	 * Background compaction by kcompactd: where a pass cut short by
+	 * its time budget resumes, zero if none is in progress, and how
+	 * many checks to skip after a full pass that did not help.
+	 */
+	unsigned long		kcompactd_migrate_pfn;
+	unsigned long		kcompactd_free_pfn;
+	unsigned int		kcompactd_skip;
+	unsigned int		kcompactd_backoff;
 #endif
 
+	/*
+	 * zone->lock accounting for the page allocator paths, protected by
+	 * the lock itself. pcp batches are scaled by 1 << lock_batch_shift,
+	 * which grows while the lock is contended and shrinks back once it
+	 * is not, as measured over windows of ZONE_LOCK_WINDOW acquisitions.
+	 */
+	unsigned long		lock_acquired;
+	unsigned long		lock_contended;
+	unsigned long		lock_pages;
+	u64			lock_hold_ns;
+	unsigned int		lock_window;
+	unsigned int		lock_window_contended;
+	int			lock_batch_shift;
+
 	ZONE_PADDING(_pad1_)
 
 	/* Fields commonly accessed by the page reclaim scanner */
@@ -357,6 +400,9 @@ struct zone {
 	/* Zone statistics */
 	atomic_long_t		vm_stat[NR_VM_ZONE_STAT_ITEMS];
 
+	/* evictions and activations, the clock for refault distances */
+	atomic_long_t		inactive_age;
+
 	/*
 	 * The target ratio of ACTIVE_ANON to INACTIVE_ANON pages on
 	 * this zone's LRU.  Maintained by the pageout code.
@@ -641,6 +687,23 @@ typedef struct pglist_data {
 	struct task_struct *kswapd;
 	int kswapd_max_order;
 	enum zone_type classzone_idx;
+#ifdef CONFIG_RECLAIM_OFFLOAD
+	spinlock_t reclaim_lock;
+	wait_queue_head_t reclaim_wait;		/* kreclaimd sleeps here */
+	wait_queue_head_t reclaim_done;		/* offloading tasks wait here */
+	struct task_struct *kreclaimd;
+	unsigned long reclaim_seq;		/* completed reclaim passes */
+	unsigned long reclaim_progress;		/* reclaimed by the last one */
+	int reclaim_order;
+	gfp_t reclaim_gfp;
+	bool reclaim_pending;
+	bool reclaim_running;
+#endif
+#ifdef CONFIG_COMPACTION
+	wait_queue_head_t kcompactd_wait;
+	struct task_struct *kcompactd;
+	bool kcompactd_wake;
+#endif
 } pg_data_t;
 
 #define node_present_pages(nid)	(NODE_DATA(nid)->node_present_pages)
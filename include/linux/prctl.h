@@ -102,4 +102,37 @@
 
 #define PR_MCE_KILL_GET 34
 
+/*
+ * Options private to this tree are numbered from PR_PRIVATE_BASE, well
+ * away from the range upstream assigns new options from, so binaries
+ * built against upstream headers never reach them by accident.
+ */
+#define PR_PRIVATE_BASE 0x59000000
+
+/*
+ * Use a private hash table of arg2 buckets for the PROCESS_PRIVATE
+ * futexes of this process, 0 for the global table. Only allowed while
+ * the process is single threaded and shares its memory with no other
+ * process, -EBUSY otherwise. PR_GET_FUTEX_HASH stores the size of the
+ * private table, 0 for the global one, in the int at arg2.
+ */
+#define PR_SET_FUTEX_HASH (PR_PRIVATE_BASE + 1)
+#define PR_GET_FUTEX_HASH (PR_PRIVATE_BASE + 2)
+
+/*
+ * Hand direct reclaim of this task's allocations to the node's kreclaimd
+ * thread and wait for it only briefly. Inherited across fork.
+ * PR_GET_RECLAIM_OFFLOAD stores the setting in the int at arg2.
+ */
+#define PR_SET_RECLAIM_OFFLOAD (PR_PRIVATE_BASE + 3)
+#define PR_GET_RECLAIM_OFFLOAD (PR_PRIVATE_BASE + 4)
+
+/*
+ * Latency nice of the calling thread, -20 (most latency sensitive) to 19.
+ * Reset to 0 on fork if negative and SCHED_RESET_ON_FORK is set.
+ * PR_GET_LATENCY_NICE stores it in the int at arg2.
+ */
+#define PR_SET_LATENCY_NICE (PR_PRIVATE_BASE + 5)
+#define PR_GET_LATENCY_NICE (PR_PRIVATE_BASE + 6)
+
 #endif /* _LINUX_PRCTL_H */
@@ -137,6 +137,8 @@ extern int nr_threads;
 DECLARE_PER_CPU(unsigned long, process_counts);
 extern int nr_processes(void);
 extern unsigned long nr_running(void);
+extern unsigned long avg_nr_running(void);
+extern void set_avg_nr_running(bool enable);
 extern unsigned long nr_uninterruptible(void);
 extern unsigned long nr_iowait(void);
 extern unsigned long nr_iowait_cpu(int cpu);
@@ -938,6 +940,7 @@ struct sched_domain {
 	unsigned int nr_balance_failed; /* initialise to 0 */
 
 	u64 last_update;
+	unsigned long avg_scan_cost;	/* select_idle_sibling(), in ns */
 
 #ifdef CONFIG_SCHEDSTATS
 	/* load_balance() stats */
@@ -1139,11 +1142,26 @@ struct sched_statistics {
 };
 #endif
 
+#ifdef CONFIG_SMP
+/*
+ * How much of the recent past an entity was runnable: runnable_avg_sum over
+ * runnable_avg_period, both in ~1us units and decayed every 1024us period
+ * by y, where y^32 = 1/2. load_avg_contrib is that fraction of the weight
+ * of the entity, and what it adds to its cfs_rq's runnable_load_avg.
+ */
+struct sched_avg {
+	u32 runnable_avg_sum, runnable_avg_period;
+	u64 last_runnable_update;
+	unsigned long load_avg_contrib;
+};
+#endif
+
 struct sched_entity {
 	struct load_weight	load;		/* for load-balancing */
 	struct rb_node		run_node;
 	struct list_head	group_node;
 	unsigned int		on_rq;
+	int			latency_nice;
 
 	u64			exec_start;
 	u64			sum_exec_runtime;
@@ -1163,6 +1181,10 @@ struct sched_entity {
 	/* rq "owned" by this entity/group: */
 	struct cfs_rq		*my_q;
 #endif
+
+#ifdef CONFIG_SMP
+	struct sched_avg	avg;
+#endif
 };
 
 struct sched_rt_entity {
@@ -1274,6 +1296,14 @@ struct task_struct {
 
 	/* Revert to default priority/policy when forking */
 	unsigned sched_reset_on_fork:1;
+#ifdef CONFIG_RECLAIM_OFFLOAD
+	/*
+	 * Direct reclaim is done by kreclaimd, see PR_SET_RECLAIM_OFFLOAD.
+	 * Only written by current, so it must not share a word with the
+	 * bitfields above, which other tasks update.
+	 */
+	int reclaim_offload;
+#endif
 
 	pid_t pid;
 	pid_t tgid;
@@ -1994,8 +2024,24 @@ extern void set_user_nice(struct task_struct *p, long nice);
 extern int task_prio(const struct task_struct *p);
 extern int task_nice(const struct task_struct *p);
 extern int can_nice(const struct task_struct *p, const int nice);
+
+/*
+ * Latency nice shifts how readily a task preempts others on wakeup and
+ * how long its slices are, without changing its share of the cpu.
+ */
+#define MIN_LATENCY_NICE	-20
+#define MAX_LATENCY_NICE	19
+#define LATENCY_NICE_WIDTH	(MAX_LATENCY_NICE - MIN_LATENCY_NICE + 1)
+
+extern int sched_set_latency_nice(struct task_struct *p, int latency_nice);
 extern int task_curr(const struct task_struct *p);
 extern int idle_cpu(int cpu);
+#ifdef CONFIG_NO_HZ_FULL
+extern bool sched_can_stop_tick(void);
+#endif
+#ifdef CONFIG_CPU_IDLE
+extern void sched_idle_set_exit_latency(unsigned int exit_latency);
+#endif
 extern int sched_setscheduler(struct task_struct *, int,
 			      const struct sched_param *);
 extern int sched_setscheduler_nocheck(struct task_struct *, int,
@@ -2534,6 +2580,8 @@ extern void sched_move_task(struct task_struct *tsk);
 #ifdef CONFIG_FAIR_GROUP_SCHED
 extern int sched_group_set_shares(struct task_group *tg, unsigned long shares);
 extern unsigned long sched_group_shares(struct task_group *tg);
+extern int sched_group_set_latency_nice(struct task_group *tg,
+					int latency_nice);
 #endif
 #ifdef CONFIG_RT_GROUP_SCHED
 extern int sched_group_set_rt_runtime(struct task_group *tg,
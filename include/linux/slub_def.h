@@ -33,6 +33,8 @@ enum stat_item {
 	DEACTIVATE_REMOTE_FREES,/* Slab contained remotely freed objects */
 	ORDER_FALLBACK,		/* Number of times fallback was necessary */
 	CMPXCHG_DOUBLE_CPU_FAIL,/* Failure of this_cpu_cmpxchg_double */
+	FREE_REMOTE,		/* Free to a non cpu slab, held back on this cpu */
+	FREE_REMOTE_FLUSH,	/* Held back frees returned to their slab */
 	NR_SLUB_STAT_ITEMS };
 
 struct kmem_cache_cpu {
@@ -42,6 +44,10 @@ struct kmem_cache_cpu {
 #endif
 	struct page *page;	/* The slab from which we are allocating */
 	int node;		/* The node of the page (or -1 for debug) */
+	void **remote_freelist;	/* Objects freed to remote_page, not yet */
+	void **remote_tail;	/* returned to it */
+	struct page *remote_page;
+	int remote_nr;
 #ifdef CONFIG_SLUB_STATS
 	unsigned stat[NR_SLUB_STAT_ITEMS];
 #endif
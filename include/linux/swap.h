@@ -213,6 +213,11 @@ extern unsigned int nr_free_pagecache_pages(void);
 /* Definition of global_page_state not available yet */
 #define nr_free_pages() global_page_state(NR_FREE_PAGES)
 
+/* linux/mm/workingset.c */
+extern void workingset_eviction(struct address_space *mapping,
+				struct page *page);
+extern bool workingset_refault(struct address_space *mapping, pgoff_t index);
+extern void workingset_activation(struct page *page);
 
 /* linux/mm/swap.c */
 extern void __lru_cache_add(struct page *, enum lru_list lru);
@@ -251,6 +256,20 @@ static inline void lru_cache_add_file(struct page *page)
 /* linux/mm/vmscan.c */
 extern unsigned long try_to_free_pages(struct zonelist *zonelist, int order,
 					gfp_t gfp_mask, nodemask_t *mask);
+#ifdef CONFIG_RECLAIM_OFFLOAD
+extern int sysctl_reclaim_offload_ms;
+extern bool offload_direct_reclaim(struct zonelist *zonelist, int order,
+				   gfp_t gfp_mask, nodemask_t *mask,
+				   unsigned long *progress);
+#else
+static inline bool offload_direct_reclaim(struct zonelist *zonelist,
+					  int order, gfp_t gfp_mask,
+					  nodemask_t *mask,
+					  unsigned long *progress)
+{
+	return false;
+}
+#endif
 extern unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *mem,
 						  gfp_t gfp_mask, bool noswap,
 						  unsigned int swappiness);
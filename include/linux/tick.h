@@ -7,6 +7,7 @@
 #define _LINUX_TICK_H
 
 #include <linux/clockchips.h>
+#include <linux/cpumask.h>
 
 #ifdef CONFIG_GENERIC_CLOCKEVENTS
 
@@ -45,6 +46,16 @@ enum tick_nohz_mode {
  * @iowait_sleeptime:	Sum of the time slept in idle with sched tick stopped, with IO outstanding
  * @sleep_length:	Duration of the current idle sleep
  * @do_timer_lst:	CPU was the last one doing do_timer before going idle
+ * @tick_stretched:	The tick of a nohz_full CPU was pushed beyond the next
+ *			period because a single task is running
+ * @full_kick:		A kick to restore the tick is in flight
+ * @full_user:		The task was in user mode when the tick was stretched
+ * @full_jiffies:	jiffies at the last tick of a nohz_full CPU
+ * @full_next_jiffies:	jiffy the stretched tick expires at
+ * @full_last_tick:	Expiry time of the last tick before the stretch
+ * @full_stretches:	Number of times the tick was stretched
+ * @full_kicks:		Number of stretches cut short by a kick
+ * @full_ticks_suppressed: Number of ticks skipped while stretched
  */
 struct tick_sched {
 	struct hrtimer			sched_timer;
@@ -67,6 +78,17 @@ struct tick_sched {
 	unsigned long			next_jiffies;
 	ktime_t				idle_expires;
 	int				do_timer_last;
+#ifdef CONFIG_NO_HZ_FULL
+	int				tick_stretched;
+	unsigned long			full_kick;
+	int				full_user;
+	unsigned long			full_jiffies;
+	unsigned long			full_next_jiffies;
+	ktime_t				full_last_tick;
+	unsigned long			full_stretches;
+	unsigned long			full_kicks;
+	unsigned long			full_ticks_suppressed;
+#endif
 };
 
 extern void __init tick_init(void);
@@ -139,4 +161,53 @@ static inline u64 get_cpu_idle_time_us(int cpu, u64 *unused) { return -1; }
 static inline u64 get_cpu_iowait_time_us(int cpu, u64 *unused) { return -1; }
 # endif /* !NO_HZ */
 
+# ifdef CONFIG_NO_HZ_FULL
+extern int tick_nohz_full_running;
+extern cpumask_var_t tick_nohz_full_mask;
+
+static inline int tick_nohz_full_cpu(int cpu)
+{
+	return tick_nohz_full_running &&
+	       cpumask_test_cpu(cpu, tick_nohz_full_mask);
+}
+
+struct task_struct;
+
+extern void __tick_nohz_full_kick_cpu(int cpu);
+extern void __tick_nohz_full_kick_group(struct task_struct *p);
+extern void __tick_nohz_full_check_timer(int cpu, unsigned long expires);
+
+/*
+ * Something on @cpu needs the periodic tick: restore it if it is
+ * stretched. Safe to call with interrupts disabled and rq->lock held.
+ */
+static inline void tick_nohz_full_kick_cpu(int cpu)
+{
+	if (tick_nohz_full_cpu(cpu))
+		__tick_nohz_full_kick_cpu(cpu);
+}
+
+/*
+ * A process wide CPU-time timer or limit of @p changed: the tick of the
+ * CPU of every thread checks it. Needs the siglock or tasklist_lock.
+ */
+static inline void tick_nohz_full_kick_group(struct task_struct *p)
+{
+	if (tick_nohz_full_running)
+		__tick_nohz_full_kick_group(p);
+}
+
+/* A timer wheel timer expiring at @expires was queued on @cpu */
+static inline void tick_nohz_full_check_timer(int cpu, unsigned long expires)
+{
+	if (tick_nohz_full_cpu(cpu))
+		__tick_nohz_full_check_timer(cpu, expires);
+}
+# else
+static inline int tick_nohz_full_cpu(int cpu) { return 0; }
+static inline void tick_nohz_full_kick_cpu(int cpu) { }
+static inline void tick_nohz_full_kick_group(struct task_struct *p) { }
+static inline void tick_nohz_full_check_timer(int cpu, unsigned long expires) { }
+# endif /* !NO_HZ_FULL */
+
 #endif
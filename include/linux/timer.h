@@ -229,6 +229,18 @@ extern void set_timer_slack(struct timer_list *time, int slack_hz);
  */
 extern unsigned long get_next_timer_interrupt(unsigned long now);
 
+/*
+ * Per-CPU timer events counted by timer_stats:
+ */
+enum timer_stats_cpu_event {
+	TIMER_STATS_CPU_WAKEUP,		/* timer interrupt taken while idle */
+	TIMER_STATS_CPU_TIMER,		/* timer wheel timer expired */
+	TIMER_STATS_CPU_HRTIMER,	/* hrtimer expired */
+	TIMER_STATS_CPU_COALESCED,	/* timer joined an existing expiry */
+	TIMER_STATS_CPU_MIGRATED,	/* timer queued on another CPU */
+	NR_TIMER_STATS_CPU_EVENTS
+};
+
 /*
  * Timer-statistics info:
  */
@@ -240,6 +252,15 @@ extern int timer_stats_active;
 
 extern void init_timer_stats(void);
 
+extern void __timer_stats_cpu_event(enum timer_stats_cpu_event event);
+
+static inline void timer_stats_cpu_event(enum timer_stats_cpu_event event)
+{
+	if (likely(!timer_stats_active))
+		return;
+	__timer_stats_cpu_event(event);
+}
+
 extern void timer_stats_update_stats(void *timer, pid_t pid, void *startf,
 				     void *timerf, char *comm,
 				     unsigned int timer_flag);
@@ -263,6 +284,10 @@ static inline void init_timer_stats(void)
 {
 }
 
+static inline void timer_stats_cpu_event(enum timer_stats_cpu_event event)
+{
+}
+
 static inline void timer_stats_timer_set_start_info(struct timer_list *timer)
 {
 }
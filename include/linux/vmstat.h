@@ -43,9 +43,16 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		KSWAPD_LOW_WMARK_HIT_QUICKLY, KSWAPD_HIGH_WMARK_HIT_QUICKLY,
 		KSWAPD_SKIP_CONGESTION_WAIT,
 		PAGEOUTRUN, ALLOCSTALL, PGROTATED,
+		ALLOCSTALL_LT_1MS, ALLOCSTALL_LT_4MS, ALLOCSTALL_LT_16MS,
+		ALLOCSTALL_LT_64MS, ALLOCSTALL_GE_64MS,
+#ifdef CONFIG_RECLAIM_OFFLOAD
+		RECLAIM_OFFLOAD, RECLAIM_OFFLOAD_TIMEOUT,
+#endif
 #ifdef CONFIG_COMPACTION
 		COMPACTBLOCKS, COMPACTPAGES, COMPACTPAGEFAILED,
 		COMPACTSTALL, COMPACTFAIL, COMPACTSUCCESS,
+		KCOMPACTD_WAKE, KCOMPACTD_PAGES, KCOMPACTD_BUDGET,
+		KCOMPACTD_FAIL, KCOMPACTD_SUCCESS,
 #endif
 #ifdef CONFIG_HUGETLB_PAGE
 		HTLB_BUDDY_PGALLOC, HTLB_BUDDY_PGALLOC_FAIL,
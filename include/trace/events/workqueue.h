@@ -115,6 +115,123 @@ DEFINE_EVENT(workqueue_work, workqueue_execute_end,
 	TP_ARGS(work)
 );
 
+/**
+ * workqueue_work_done - called when a work item has been executed
+ * @work:	pointer to struct work_struct, possibly freed already
+ * @function:	the function that was executed
+ * @workqueue:	name of the workqueue
+ * @latency:	ns from queueing the work to starting it
+ * @runtime:	ns the function ran
+ *
+ * Only with CONFIG_WQ_STATS, which time stamps the work items.
+ */
+TRACE_EVENT(workqueue_work_done,
+
+	TP_PROTO(struct work_struct *work, void *function,
+		 const char *workqueue, u64 latency, u64 runtime),
+
+	TP_ARGS(work, function, workqueue, latency, runtime),
+
+	TP_STRUCT__entry(
+		__field( void *,	work	)
+		__field( void *,	function)
+		__string( workqueue,	workqueue)
+		__field( u64,		latency	)
+		__field( u64,		runtime	)
+	),
+
+	TP_fast_assign(
+		__entry->work		= work;
+		__entry->function	= function;
+		__assign_str(workqueue, workqueue);
+		__entry->latency	= latency;
+		__entry->runtime	= runtime;
+	),
+
+	TP_printk("work struct %p: function %pf workqueue=%s latency=%llu ns "
+		  "runtime=%llu ns", __entry->work, __entry->function,
+		  __get_str(workqueue), (unsigned long long)__entry->latency,
+		  (unsigned long long)__entry->runtime)
+);
+
+DECLARE_EVENT_CLASS(workqueue_worker,
+
+	TP_PROTO(unsigned int cpu, int id),
+
+	TP_ARGS(cpu, id),
+
+	TP_STRUCT__entry(
+		__field( unsigned int,	cpu	)
+		__field( int,		id	)
+	),
+
+	TP_fast_assign(
+		__entry->cpu		= cpu;
+		__entry->id		= id;
+	),
+
+	TP_printk("cpu=%u id=%d", __entry->cpu, __entry->id)
+);
+
+/**
+ * workqueue_worker_create - called when a worker thread is started
+ * @cpu:	cpu of the worker pool, WORK_CPU_UNBOUND for the unbound one
+ * @id:	worker id within the pool
+ */
+DEFINE_EVENT(workqueue_worker, workqueue_worker_create,
+
+	TP_PROTO(unsigned int cpu, int id),
+
+	TP_ARGS(cpu, id)
+);
+
+/**
+ * workqueue_worker_destroy - called when an idle worker thread is stopped
+ * @cpu:	cpu of the worker pool, WORK_CPU_UNBOUND for the unbound one
+ * @id:	worker id within the pool
+ */
+DEFINE_EVENT(workqueue_worker, workqueue_worker_destroy,
+
+	TP_PROTO(unsigned int cpu, int id),
+
+	TP_ARGS(cpu, id)
+);
+
+/**
+ * workqueue_mayday - called when a rescuer is asked to run a work
+ * @workqueue:	name of the workqueue
+ * @cpu:	cpu of the worker pool, WORK_CPU_UNBOUND for the unbound one
+ * @work:	pointer to struct work_struct
+ *
+ * This event occurs when creating a new worker has taken too long and
+ * the rescuer of the workqueue is woken up to process its works.
+ */
+TRACE_EVENT(workqueue_mayday,
+
+	TP_PROTO(const char *workqueue, unsigned int cpu,
+		 struct work_struct *work),
+
+	TP_ARGS(workqueue, cpu, work),
+
+	TP_STRUCT__entry(
+		__string( workqueue,	workqueue)
+		__field( unsigned int,	cpu	)
+		__field( void *,	work	)
+		__field( void *,	function)
+	),
+
+	TP_fast_assign(
+		__assign_str(workqueue, workqueue);
+		__entry->cpu		= cpu;
+		__entry->work		= work;
+		__entry->function	= work->func;
+	),
+
+	TP_printk("workqueue=%s cpu=%u work struct=%p function=%pf",
+		  __get_str(workqueue), __entry->cpu, __entry->work,
+		  __entry->function)
+);
+
 #endif /*  _TRACE_WORKQUEUE_H */
 
 /* This part must be outside protection */
@@ -59,6 +59,11 @@
 #include <linux/magic.h>
 #include <linux/pid.h>
 #include <linux/nsproxy.h>
+#include <linux/bootmem.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/log2.h>
+#include <linux/prctl.h>
 
 #include <asm/futex.h>
 
@@ -66,8 +71,6 @@
 
 int __read_mostly futex_cmpxchg_enabled;
 
-#define FUTEX_HASHBITS (CONFIG_BASE_SMALL ? 4 : 8)
-
 /*
  * Futex flags used to encode options to functions and preserve them across
  * restarts.
@@ -145,9 +148,34 @@ static const struct futex_q futex_q_init = {
 struct futex_hash_bucket {
 	spinlock_t lock;
 	struct plist_head chain;
+#ifdef CONFIG_FUTEX_STATS
+	unsigned long acquired;
+	unsigned long contended;
+#endif
 };
 
-static struct futex_hash_bucket futex_queues[1<<FUTEX_HASHBITS];
+/*
+ * The global hash table is sized at boot from the number of possible
+ * CPUs, bounded by the amount of memory (see futex_init()).
+ */
+static struct futex_hash_bucket *futex_queues __read_mostly;
+static unsigned long futex_hashsize __read_mostly;
+
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+/*
+ * Optional per-process table for PROCESS_PRIVATE futexes, so that
+ * unrelated processes never share hash buckets. Set up with
+ * prctl(PR_SET_FUTEX_HASH) while the process is single threaded and
+ * inherited across fork().
+ */
+struct futex_private_hash {
+	unsigned long size;
+	struct futex_hash_bucket queues[0];
+};
+
+#define FUTEX_PRIVATE_HASH_MIN	16
+#define FUTEX_PRIVATE_HASH_MAX	1024
+#endif
 
 /*
  * We hash on the keys returned from get_futex_key (see below).
@@ -157,7 +185,56 @@ static struct futex_hash_bucket *hash_futex(union futex_key *key)
 	u32 hash = jhash2((u32*)&key->both.word,
 			  (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
 			  key->both.offset);
-	return &futex_queues[hash & ((1 << FUTEX_HASHBITS)-1)];
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+	if (!(key->both.offset & (FUT_OFF_INODE | FUT_OFF_MMSHARED))) {
+		struct futex_private_hash *fph = key->private.mm->futex_hash;
+
+		if (fph)
+			return &fph->queues[hash & (fph->size - 1)];
+	}
+#endif
+	return &futex_queues[hash & (futex_hashsize - 1)];
+}
+
+#ifdef CONFIG_FUTEX_STATS
+static inline void hb_lock(struct futex_hash_bucket *hb)
+{
+	if (!spin_trylock(&hb->lock)) {
+		spin_lock(&hb->lock);
+		hb->contended++;
+	}
+	hb->acquired++;
+}
+
+static inline void hb_lock_nested(struct futex_hash_bucket *hb)
+{
+	if (!spin_trylock(&hb->lock)) {
+		spin_lock_nested(&hb->lock, SINGLE_DEPTH_NESTING);
+		hb->contended++;
+	}
+	hb->acquired++;
+}
+#else
+static inline void hb_lock(struct futex_hash_bucket *hb)
+{
+	spin_lock(&hb->lock);
+}
+
+static inline void hb_lock_nested(struct futex_hash_bucket *hb)
+{
+	spin_lock_nested(&hb->lock, SINGLE_DEPTH_NESTING);
+}
+#endif
+
+static void futex_hash_init(struct futex_hash_bucket *queues,
+			    unsigned long size)
+{
+	unsigned long i;
+
+	for (i = 0; i < size; i++) {
+		plist_head_init(&queues[i].chain, &queues[i].lock);
+		spin_lock_init(&queues[i].lock);
+	}
 }
 
 /*
@@ -518,7 +595,7 @@ void exit_pi_state_list(struct task_struct *curr)
 		hb = hash_futex(&key);
 		raw_spin_unlock_irq(&curr->pi_lock);
 
-		spin_lock(&hb->lock);
+		hb_lock(hb);
 
 		raw_spin_lock_irq(&curr->pi_lock);
 		/*
@@ -908,12 +985,12 @@ static inline void
 double_lock_hb(struct futex_hash_bucket *hb1, struct futex_hash_bucket *hb2)
 {
 	if (hb1 <= hb2) {
-		spin_lock(&hb1->lock);
+		hb_lock(hb1);
 		if (hb1 < hb2)
-			spin_lock_nested(&hb2->lock, SINGLE_DEPTH_NESTING);
+			hb_lock_nested(hb2);
 	} else { /* hb1 > hb2 */
-		spin_lock(&hb2->lock);
-		spin_lock_nested(&hb1->lock, SINGLE_DEPTH_NESTING);
+		hb_lock(hb2);
+		hb_lock_nested(hb1);
 	}
 }
 
@@ -945,7 +1022,7 @@ futex_wake(u32 __user *uaddr, unsigned int flags, int nr_wake, u32 bitset)
 		goto out;
 
 	hb = hash_futex(&key);
-	spin_lock(&hb->lock);
+	hb_lock(hb);
 	head = &hb->chain;
 
 	plist_for_each_entry_safe(this, next, head, list) {
@@ -1422,7 +1499,7 @@ static inline struct futex_hash_bucket *queue_lock(struct futex_q *q)
 	hb = hash_futex(&q->key);
 	q->lock_ptr = &hb->lock;
 
-	spin_lock(&hb->lock);
+	hb_lock(hb);
 	return hb;
 }
 
@@ -2065,7 +2142,7 @@ retry:
 		goto out;
 
 	hb = hash_futex(&key);
-	spin_lock(&hb->lock);
+	hb_lock(hb);
 
 	/*
 	 * To avoid races, try to do the TID -> 0 atomic transition
@@ -2268,7 +2345,7 @@ static int futex_wait_requeue_pi(u32 __user *uaddr, unsigned int flags,
 	/* Queue the futex_q, drop the hb lock, wait for wakeup. */
 	futex_wait_queue_me(hb, &q, to);
 
-	spin_lock(&hb->lock);
+	hb_lock(hb);
 	ret = handle_early_requeue_pi_wakeup(hb, &q, &key2, to);
 	spin_unlock(&hb->lock);
 	if (ret)
@@ -2680,8 +2757,9 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 
 static int __init futex_init(void)
 {
+	unsigned long limit;
 	u32 curval;
-	int i;
+	unsigned int shift;
 
 	/*
 	 * This will fail and we want it. Some arch implementations do
@@ -2696,11 +2774,208 @@ static int __init futex_init(void)
 	if (cmpxchg_futex_value_locked(&curval, NULL, 0, 0) == -EFAULT)
 		futex_cmpxchg_enabled = 1;
 
-	for (i = 0; i < ARRAY_SIZE(futex_queues); i++) {
-		plist_head_init(&futex_queues[i].chain, &futex_queues[i].lock);
-		spin_lock_init(&futex_queues[i].lock);
-	}
+	/*
+	 * 256 buckets per possible CPU, but no more than one bucket
+	 * per 64k of memory.
+	 */
+#if CONFIG_BASE_SMALL
+	limit = 16;
+#else
+	limit = roundup_pow_of_two(256 * num_possible_cpus());
+#endif
+	futex_queues = alloc_large_system_hash("futex",
+					       sizeof(struct futex_hash_bucket),
+					       0, 16, 0, &shift, NULL, limit);
+	futex_hashsize = 1UL << shift;
+	futex_hash_init(futex_queues, futex_hashsize);
 
 	return 0;
 }
 __initcall(futex_init);
+
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+static struct futex_private_hash *futex_hash_alloc(unsigned long size)
+{
+	struct futex_private_hash *fph;
+
+	fph = kmalloc(sizeof(*fph) + size * sizeof(struct futex_hash_bucket),
+		      GFP_KERNEL);
+	if (!fph)
+		return NULL;
+
+	fph->size = size;
+	futex_hash_init(fph->queues, size);
+	return fph;
+}
+
+/*
+ * Give a new mm created by fork() an empty private hash table of the
+ * same size as its parent's.
+ */
+int futex_hash_dup(struct mm_struct *mm, struct mm_struct *oldmm)
+{
+	mm->futex_hash = NULL;
+	if (!oldmm->futex_hash)
+		return 0;
+
+	mm->futex_hash = futex_hash_alloc(oldmm->futex_hash->size);
+	return mm->futex_hash ? 0 : -ENOMEM;
+}
+
+void futex_hash_free(struct mm_struct *mm)
+{
+	kfree(mm->futex_hash);
+	mm->futex_hash = NULL;
+}
+
+/*
+ * Whether a task other than current uses @mm: another thread of its
+ * group, or a process it cloned with CLONE_VM but not CLONE_THREAD.
+ * mm_users alone cannot tell, get_task_mm() from /proc or ptrace takes
+ * references too. Only current can add a user here, so the answer
+ * holds until it returns to user space.
+ */
+static bool futex_mm_shared(struct mm_struct *mm)
+{
+	struct task_struct *g, *p;
+	bool shared = false;
+
+	if (!thread_group_empty(current))
+		return true;
+	if (atomic_read(&mm->mm_users) == 1)
+		return false;
+
+	/* as zap_threads() looks for other processes using the mm */
+	rcu_read_lock();
+	for_each_process(g) {
+		if (g == current || (g->flags & PF_KTHREAD))
+			continue;
+		p = g;
+		do {
+			if (p->mm) {
+				if (unlikely(p->mm == mm))
+					shared = true;
+				break;
+			}
+		} while_each_thread(g, p);
+		if (shared)
+			break;
+	}
+	rcu_read_unlock();
+
+	return shared;
+}
+
+/*
+ * PR_SET_FUTEX_HASH: switch the PROCESS_PRIVATE futexes of the calling
+ * process to a private table of @arg2 buckets, or back to the global
+ * table for 0. Waiters queued in the old table would be lost, so this
+ * is only allowed while no other task uses the mm.
+ *
+ * PR_GET_FUTEX_HASH: store the size of the private table, 0 if the
+ * global table is used, in the int at @arg2.
+ */
+long futex_hash_prctl(int option, unsigned long arg2)
+{
+	struct mm_struct *mm = current->mm;
+	struct futex_private_hash *fph = NULL;
+
+	if (!mm)
+		return -EINVAL;
+
+	if (option == PR_GET_FUTEX_HASH)
+		return put_user(mm->futex_hash ? mm->futex_hash->size : 0,
+				(int __user *)arg2);
+
+	if (futex_mm_shared(mm))
+		return -EBUSY;
+
+	if (arg2) {
+		arg2 = clamp_t(unsigned long, arg2, FUTEX_PRIVATE_HASH_MIN,
+			       FUTEX_PRIVATE_HASH_MAX);
+		fph = futex_hash_alloc(roundup_pow_of_two(arg2));
+		if (!fph)
+			return -ENOMEM;
+	}
+
+	kfree(mm->futex_hash);
+	mm->futex_hash = fph;
+	return 0;
+}
+#endif
+
+#ifdef CONFIG_FUTEX_STATS
+/*
+ * /sys/kernel/debug/futex_stats: occupancy and lock contention of the
+ * global hash table. The occupancy histogram counts buckets by the
+ * number of queued waiters: 0, 1, 2-3, 4-7, ... and 64 or more.
+ */
+#define FUTEX_STATS_SLOTS	8
+
+static int futex_stats_show(struct seq_file *m, void *v)
+{
+	unsigned long hist[FUTEX_STATS_SLOTS] = { 0, };
+	unsigned long acquired = 0, contended = 0;
+	unsigned long waiters = 0, max_waiters = 0;
+	unsigned long max_contended = 0, max_idx = 0;
+	unsigned long i, n;
+	int slot;
+
+	for (i = 0; i < futex_hashsize; i++) {
+		struct futex_hash_bucket *hb = &futex_queues[i];
+		struct plist_node *node;
+
+		n = 0;
+		spin_lock(&hb->lock);
+		plist_for_each(node, &hb->chain)
+			n++;
+		acquired += hb->acquired;
+		contended += hb->contended;
+		if (hb->contended > max_contended) {
+			max_contended = hb->contended;
+			max_idx = i;
+		}
+		spin_unlock(&hb->lock);
+
+		slot = n ? min_t(int, fls_long(n), FUTEX_STATS_SLOTS - 1) : 0;
+		hist[slot]++;
+		waiters += n;
+		max_waiters = max(max_waiters, n);
+		cond_resched();
+	}
+
+	seq_printf(m, "buckets: %lu\n", futex_hashsize);
+	seq_printf(m, "waiters: %lu\n", waiters);
+	seq_printf(m, "max_waiters: %lu\n", max_waiters);
+	seq_printf(m, "occupancy:");
+	for (slot = 0; slot < FUTEX_STATS_SLOTS; slot++)
+		seq_printf(m, " %lu", hist[slot]);
+	seq_printf(m, "\n");
+	seq_printf(m, "acquired: %lu\n", acquired);
+	seq_printf(m, "contended: %lu\n", contended);
+	seq_printf(m, "max_contended: %lu (bucket %lu)\n",
+		   max_contended, max_idx);
+
+	return 0;
+}
+
+static int futex_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, futex_stats_show, NULL);
+}
+
+static const struct file_operations futex_stats_fops = {
+	.open		= futex_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init futex_stats_init(void)
+{
+	debugfs_create_file("futex_stats", S_IRUSR, NULL, NULL,
+			    &futex_stats_fops);
+	return 0;
+}
+late_initcall(futex_stats_init);
+#endif
@@ -787,6 +787,7 @@ static inline void timer_stats_account_hrtimer(struct hrtimer *timer)
 #ifdef CONFIG_TIMER_STATS
 	if (likely(!timer_stats_active))
 		return;
+	__timer_stats_cpu_event(TIMER_STATS_CPU_HRTIMER);
 	timer_stats_update_stats(timer, timer->start_pid, timer->start_site,
 				 timer->function, timer->start_comm, 0);
 #endif
@@ -1241,6 +1242,8 @@ void hrtimer_interrupt(struct clock_event_device *dev)
 	BUG_ON(!cpu_base->hres_active);
 	cpu_base->nr_events++;
 	dev->next_event.tv64 = KTIME_MAX;
+	if (idle_cpu(smp_processor_id()))
+		timer_stats_cpu_event(TIMER_STATS_CPU_WAKEUP);
 
 	entry_time = now = ktime_get();
 retry:
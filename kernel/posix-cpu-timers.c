@@ -8,6 +8,7 @@
 #include <linux/math64.h>
 #include <asm/uaccess.h>
 #include <linux/kernel_stat.h>
+#include <linux/tick.h>
 #include <trace/events/timer.h>
 
 /*
@@ -597,6 +598,12 @@ static void arm_timer(struct k_itimer *timer)
 				cputime_expires->sched_exp = exp->sched;
 			break;
 		}
+
+		/* Expiry is checked from the tick, which may be stretched */
+		if (CPUCLOCK_PERTHREAD(timer->it_clock))
+			tick_nohz_full_kick_cpu(task_cpu(p));
+		else
+			tick_nohz_full_kick_group(p);
 	}
 }
 
@@ -1415,6 +1422,9 @@ void set_process_cpu_timer(struct task_struct *tsk, unsigned int clock_idx,
 			tsk->signal->cputime_expires.virt_exp = *newval;
 		break;
 	}
+
+	/* Checked from the tick of every thread, which may be stretched */
+	tick_nohz_full_kick_group(tsk);
 }
 
 static int do_cpu_nanosleep(const clockid_t which_clock, int flags,
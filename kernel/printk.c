@@ -40,6 +40,8 @@
 #include <linux/cpu.h>
 #include <linux/notifier.h>
 #include <linux/rculist.h>
+#include <linux/kthread.h>
+#include <linux/slab.h>
 
 #include <asm/uaccess.h>
 
@@ -65,6 +67,15 @@ extern void printascii(char *);
 
 DECLARE_WAIT_QUEUE_HEAD(log_wait);
 
+/*
+ * Work printk() leaves to the next timer tick on its cpu, because it can
+ * be called with any lock held, the runqueue locks included.
+ */
+#define PRINTK_PENDING_WAKEUP	0x01	/* wake up klogd */
+#define PRINTK_PENDING_DRAIN	0x02	/* wake up the printk thread */
+
+static DEFINE_PER_CPU(int, printk_pending);
+
 int console_printk[4] = {
 	DEFAULT_CONSOLE_LOGLEVEL,	/* console_loglevel */
 	DEFAULT_MESSAGE_LOGLEVEL,	/* default_message_loglevel */
@@ -105,6 +116,15 @@ static int console_locked, console_suspended;
  */
 static DEFINE_SPINLOCK(logbuf_lock);
 
+#ifdef CONFIG_PRINTK_ASYNC
+/*
+ * printk_drain_lock serializes moving the per-cpu printk buffers into
+ * log_buf, printk_drain_cpu is the cpu doing it. Nests outside logbuf_lock.
+ */
+static DEFINE_SPINLOCK(printk_drain_lock);
+static unsigned int printk_drain_cpu = UINT_MAX;
+#endif
+
 #define LOG_BUF_MASK (log_buf_len-1)
 #define LOG_BUF(idx) (log_buf[(idx) & LOG_BUF_MASK])
 
@@ -349,6 +369,14 @@ static int check_syslog_permissions(int type, bool from_file)
 	return 0;
 }
 
+#ifdef CONFIG_PRINTK_ASYNC
+static void printk_drain_all(void);
+#else
+static inline void printk_drain_all(void)
+{
+}
+#endif
+
 int do_syslog(int type, char __user *buf, int len, bool from_file)
 {
 	unsigned i, j, limit, count;
@@ -364,6 +392,8 @@ int do_syslog(int type, char __user *buf, int len, bool from_file)
 	if (error)
 		return error;
 
+	printk_drain_all();
+
 	switch (type) {
 	case SYSLOG_ACTION_CLOSE:	/* Close log */
 		break;
@@ -710,6 +740,10 @@ static void zap_locks(void)
 
 	/* If a crash is occurring, make sure we can't deadlock */
 	spin_lock_init(&logbuf_lock);
+#ifdef CONFIG_PRINTK_ASYNC
+	spin_lock_init(&printk_drain_lock);
+	printk_drain_cpu = UINT_MAX;
+#endif
 	/* And make sure that we print immediately */
 	sema_init(&console_sem, 1);
 }
@@ -721,6 +755,9 @@ static int printk_time = 0;
 #endif
 module_param_named(time, printk_time, bool, S_IRUGO | S_IWUSR);
 
+static int printk_cpu_prefix;
+module_param_named(cpu, printk_cpu_prefix, bool, S_IRUGO | S_IWUSR);
+
 /* Check if we have any console registered that can be called early in boot. */
 static int have_callable_console(void)
 {
@@ -845,61 +882,20 @@ static inline void printk_delay(void)
 	}
 }
 
-asmlinkage int vprintk(const char *fmt, va_list args)
+/*
+ * Copy the text of one printk() into log_buf, inserting the log level,
+ * time stamp and cpu prefixes at the start of every line. Returns the
+ * number of prefix chars added. Called with logbuf_lock held.
+ */
+static int log_store(const char *text, unsigned long long t,
+		     unsigned int cpu)
 {
-	int printed_len = 0;
 	int current_log_level = default_message_loglevel;
-	unsigned long flags;
-	int this_cpu;
-	char *p;
+	int printed_len = 0;
+	const char *p = text;
 	size_t plen;
 	char special;
 
-	boot_delay_msec();
-	printk_delay();
-
-	preempt_disable();
-	/* This stops the holder of console_sem just where we want him */
-	raw_local_irq_save(flags);
-	this_cpu = smp_processor_id();
-
-	/*
-	 * Ouch, printk recursed into itself!
-	 */
-	if (unlikely(printk_cpu == this_cpu)) {
-		/*
-		 * If a crash is occurring during printk() on this CPU,
-		 * then try to get the crash message out but make sure
-		 * we can't deadlock. Otherwise just return to avoid the
-		 * recursion and return - but flag the recursion so that
-		 * it can be printed at the next appropriate moment:
-		 */
-		if (!oops_in_progress) {
-			recursion_bug = 1;
-			goto out_restore_irqs;
-		}
-		zap_locks();
-	}
-
-	lockdep_off();
-	spin_lock(&logbuf_lock);
-	printk_cpu = this_cpu;
-
-	if (recursion_bug) {
-		recursion_bug = 0;
-		strcpy(printk_buf, recursion_bug_msg);
-		printed_len = strlen(recursion_bug_msg);
-	}
-	/* Emit the output into the temporary buffer */
-	printed_len += vscnprintf(printk_buf + printed_len,
-				  sizeof(printk_buf) - printed_len, fmt, args);
-
-#ifdef	CONFIG_DEBUG_LL
-	printascii(printk_buf);
-#endif
-
-	p = printk_buf;
-
 	/* Read log level and handle special printk prefix */
 	plen = log_prefix(p, &current_log_level, &special);
 	if (plen) {
@@ -932,7 +928,7 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 				int i;
 
 				for (i = 0; i < plen; i++)
-					emit_log_char(printk_buf[i]);
+					emit_log_char(text[i]);
 				printed_len += plen;
 			} else {
 				/* Add log prefix */
@@ -946,13 +942,12 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 				/* Add the current time stamp */
 				char tbuf[50], *tp;
 				unsigned tlen;
-				unsigned long long t;
+				unsigned long long sec = t;
 				unsigned long nanosec_rem;
 
-				t = cpu_clock(printk_cpu);
-				nanosec_rem = do_div(t, 1000000000);
+				nanosec_rem = do_div(sec, 1000000000);
 				tlen = sprintf(tbuf, "[%5lu.%06lu] ",
-						(unsigned long) t,
+						(unsigned long) sec,
 						nanosec_rem / 1000);
 
 				for (tp = tbuf; tp < tbuf + tlen; tp++)
@@ -960,6 +955,17 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 				printed_len += tlen;
 			}
 
+			if (printk_cpu_prefix) {
+				/* Add the cpu the message was printed on */
+				char cbuf[16], *cp;
+				unsigned clen;
+
+				clen = sprintf(cbuf, "C%u ", cpu);
+				for (cp = cbuf; cp < cbuf + clen; cp++)
+					emit_log_char(*cp);
+				printed_len += clen;
+			}
+
 			if (!*p)
 				break;
 		}
@@ -969,6 +975,376 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 			new_text_line = 1;
 	}
 
+	return printed_len;
+}
+
+#ifdef CONFIG_PRINTK_ASYNC
+/*
+ * Unless an emergency forces it to be printed synchronously, printk()
+ * only formats its message into a ring of records on the local cpu,
+ * with interrupts disabled but without taking any lock: each ring has a
+ * single writer, the cpu it belongs to, and a single reader, whoever
+ * holds printk_drain_lock. The printk thread moves the records into
+ * log_buf, oldest first across the cpus, and then prints them to the
+ * consoles from its own context, so that neither logbuf_lock nor the
+ * console drivers are in the way of the callers any more. dmesg,
+ * /proc/kmsg and kmsg_dump keep reading log_buf as before.
+ */
+#define PRINTK_RING_SIZE	(1 << CONFIG_PRINTK_ASYNC_BUF_SHIFT)
+#define PRINTK_REC_ALIGN	sizeof(struct printk_rec)
+#define PRINTK_REC_PAD		0xffff
+
+/*
+ * Records moved into log_buf per pass with interrupts disabled. This is
+ * also all a synchronous printk() drains ahead of its own message, so it
+ * bounds the interrupts-off time of either.
+ */
+#define PRINTK_DRAIN_BATCH	32
+
+struct printk_rec {
+	u64		ts_nsec;	/* cpu_clock() when printed */
+	u16		len;		/* of text, or PRINTK_REC_PAD */
+	u16		cpu;		/* printed on */
+	char		text[0];	/* NUL terminated, log prefix included */
+} __aligned(8);
+
+struct printk_ring {
+	unsigned long	head;		/* written by the owning cpu */
+	unsigned long	tail;		/* written by the drainer */
+	int		busy;		/* the owning cpu is writing */
+	char		scratch[1024];
+	char		data[PRINTK_RING_SIZE];
+};
+
+static DEFINE_PER_CPU(struct printk_ring *, printk_rings);
+static DECLARE_WAIT_QUEUE_HEAD(printk_thread_wait);
+static struct task_struct *printk_thread_task;
+static int printk_async_ready;
+
+static int printk_sync;
+module_param_named(sync, printk_sync, bool, S_IRUGO | S_IWUSR);
+
+static inline unsigned int printk_rec_size(unsigned int len)
+{
+	return ALIGN(sizeof(struct printk_rec) + len + 1, PRINTK_REC_ALIGN);
+}
+
+/*
+ * Format a message into this cpu's ring. Returns its length, or -1 if it
+ * has to go through log_buf synchronously instead: for the most severe
+ * log levels, when printk() nests on this cpu (an NMI interrupting it),
+ * or when the ring is full. Called with interrupts disabled.
+ */
+static int printk_ring_store(unsigned int cpu, const char *fmt, va_list args)
+{
+	struct printk_ring *r = per_cpu(printk_rings, cpu);
+	unsigned int level = default_message_loglevel;
+	unsigned long head, tail, off, size, pad = 0;
+	struct printk_rec *rec;
+	char special = 0;
+	int len;
+
+	if (!r || r->busy)
+		return -1;
+	r->busy = 1;
+	barrier();
+
+	len = vscnprintf(r->scratch, sizeof(r->scratch), fmt, args);
+	log_prefix(r->scratch, &level, &special);
+	if (level <= 2 && special != 'c')
+		goto sync;
+
+	head = r->head;
+	tail = ACCESS_ONCE(r->tail);
+	/* do not write over records before the drainer is done with them */
+	smp_mb();
+
+	size = printk_rec_size(len);
+	off = head & (PRINTK_RING_SIZE - 1);
+	if (off + size > PRINTK_RING_SIZE)
+		pad = PRINTK_RING_SIZE - off;
+	if (head + pad + size - tail > PRINTK_RING_SIZE)
+		goto sync;
+
+	if (pad) {
+		rec = (struct printk_rec *)(r->data + off);
+		rec->len = PRINTK_REC_PAD;
+		head += pad;
+		off = 0;
+	}
+
+	rec = (struct printk_rec *)(r->data + off);
+	rec->ts_nsec = cpu_clock(cpu);
+	rec->len = len;
+	rec->cpu = cpu;
+	memcpy(rec->text, r->scratch, len + 1);
+
+#ifdef	CONFIG_DEBUG_LL
+	printascii(r->scratch);
+#endif
+
+	/* publish the record only once it is complete */
+	smp_wmb();
+	r->head = head + size;
+	barrier();
+	r->busy = 0;
+
+	__this_cpu_or(printk_pending, PRINTK_PENDING_DRAIN);
+	return len;
+
+sync:
+	barrier();
+	r->busy = 0;
+	return -1;
+}
+
+/* the oldest record of @r not yet drained, or NULL */
+static struct printk_rec *printk_ring_peek(struct printk_ring *r)
+{
+	struct printk_rec *rec;
+	unsigned long head = ACCESS_ONCE(r->head);
+
+	smp_rmb();
+	while (r->tail != head) {
+		rec = (struct printk_rec *)
+			(r->data + (r->tail & (PRINTK_RING_SIZE - 1)));
+		if (rec->len != PRINTK_REC_PAD)
+			return rec;
+		smp_mb();
+		r->tail = ALIGN(r->tail + 1, PRINTK_RING_SIZE);
+	}
+	return NULL;
+}
+
+/*
+ * Move up to @budget records from the cpu rings into log_buf, oldest
+ * first. Returns true if records are left. Unless @wait, gives up when
+ * someone else is draining. Called with interrupts disabled.
+ */
+static bool printk_drain_rings(int budget, bool wait)
+{
+	struct printk_ring *r, *oldest_r;
+	struct printk_rec *rec, *oldest;
+	int cpu;
+
+	/* printk() from under the lock, from a spinlock debug check say */
+	if (printk_drain_cpu == smp_processor_id())
+		return true;
+
+	if (wait)
+		spin_lock(&printk_drain_lock);
+	else if (!spin_trylock(&printk_drain_lock))
+		return true;
+	printk_drain_cpu = smp_processor_id();
+
+	for (;;) {
+		oldest = NULL;
+		oldest_r = NULL;
+		for_each_possible_cpu(cpu) {
+			r = per_cpu(printk_rings, cpu);
+			if (!r)
+				continue;
+			rec = printk_ring_peek(r);
+			if (rec && (!oldest || rec->ts_nsec < oldest->ts_nsec)) {
+				oldest = rec;
+				oldest_r = r;
+			}
+		}
+		if (!oldest || !budget--)
+			break;
+
+		spin_lock(&logbuf_lock);
+		log_store(oldest->text, oldest->ts_nsec, oldest->cpu);
+		spin_unlock(&logbuf_lock);
+
+		smp_mb();
+		oldest_r->tail += printk_rec_size(oldest->len);
+	}
+	printk_drain_cpu = UINT_MAX;
+	spin_unlock(&printk_drain_lock);
+
+	return oldest != NULL;
+}
+
+/*
+ * Bring log_buf up to date with everything printed so far, a batch at a
+ * time with interrupts restored in between. While oopsing, the drain
+ * lock may be held by a cpu which will never release it, so make one
+ * pass without waiting for it.
+ */
+static void printk_drain_all(void)
+{
+	unsigned long flags;
+	bool more;
+
+	if (oops_in_progress) {
+		local_irq_save(flags);
+		printk_drain_rings(INT_MAX, false);
+		local_irq_restore(flags);
+		return;
+	}
+
+	do {
+		local_irq_save(flags);
+		more = printk_drain_rings(PRINTK_DRAIN_BATCH, true);
+		local_irq_restore(flags);
+	} while (more);
+}
+
+static bool printk_rings_pending(void)
+{
+	struct printk_ring *r;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		r = per_cpu(printk_rings, cpu);
+		if (r && ACCESS_ONCE(r->head) != ACCESS_ONCE(r->tail))
+			return true;
+	}
+	return false;
+}
+
+static int printk_thread(void *unused)
+{
+	bool more;
+
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(printk_thread_wait,
+					 printk_rings_pending() ||
+					 kthread_should_stop());
+		do {
+			local_irq_disable();
+			more = printk_drain_rings(PRINTK_DRAIN_BATCH, true);
+			local_irq_enable();
+			cond_resched();
+		} while (more);
+
+		/* prints what is new in log_buf and wakes up klogd */
+		console_lock();
+		console_unlock();
+	}
+	return 0;
+}
+
+static int __init printk_async_init(void)
+{
+	struct task_struct *tsk;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct printk_ring *r;
+
+		r = kzalloc_node(sizeof(*r), GFP_KERNEL, cpu_to_node(cpu));
+		if (!r)
+			goto fail;
+		per_cpu(printk_rings, cpu) = r;
+	}
+
+	tsk = kthread_run(printk_thread, NULL, "printk");
+	if (IS_ERR(tsk))
+		goto fail;
+	printk_thread_task = tsk;
+	smp_wmb();
+	printk_async_ready = 1;
+	return 0;
+
+fail:
+	for_each_possible_cpu(cpu) {
+		kfree(per_cpu(printk_rings, cpu));
+		per_cpu(printk_rings, cpu) = NULL;
+	}
+	printk(KERN_WARNING "printk: no per-cpu buffers, printing "
+	       "synchronously\n");
+	return 0;
+}
+early_initcall(printk_async_init);
+
+static inline bool printk_can_defer(void)
+{
+	if (!printk_async_ready || printk_sync || oops_in_progress)
+		return false;
+	if (in_nmi())
+		return false;
+	/* nothing may be left to drain the rings once the machine stops */
+	return system_state == SYSTEM_BOOTING ||
+	       system_state == SYSTEM_RUNNING;
+}
+#endif /* CONFIG_PRINTK_ASYNC */
+
+asmlinkage int vprintk(const char *fmt, va_list args)
+{
+	int printed_len = 0;
+	unsigned long flags;
+	int this_cpu;
+
+	boot_delay_msec();
+	printk_delay();
+
+	preempt_disable();
+	/* This stops the holder of console_sem just where we want him */
+	raw_local_irq_save(flags);
+	this_cpu = smp_processor_id();
+
+#ifdef CONFIG_PRINTK_ASYNC
+	if (printk_can_defer()) {
+		va_list ap;
+
+		va_copy(ap, args);
+		printed_len = printk_ring_store(this_cpu, fmt, ap);
+		va_end(ap);
+		if (printed_len >= 0)
+			goto out_restore_irqs;
+		printed_len = 0;
+	}
+#endif
+
+	/*
+	 * Ouch, printk recursed into itself!
+	 */
+	if (unlikely(printk_cpu == this_cpu)) {
+		/*
+		 * If a crash is occurring during printk() on this CPU,
+		 * then try to get the crash message out but make sure
+		 * we can't deadlock. Otherwise just return to avoid the
+		 * recursion and return - but flag the recursion so that
+		 * it can be printed at the next appropriate moment:
+		 */
+		if (!oops_in_progress) {
+			recursion_bug = 1;
+			goto out_restore_irqs;
+		}
+		zap_locks();
+	}
+
+	lockdep_off();
+#ifdef CONFIG_PRINTK_ASYNC
+	/*
+	 * Keep the oldest records still queued on the cpus ahead of this
+	 * message. Only a batch of them: interrupts are off here, and the
+	 * rings of all cpus may be full. The rest follow it into log_buf.
+	 */
+	if (printk_async_ready)
+		printk_drain_rings(PRINTK_DRAIN_BATCH, !oops_in_progress);
+#endif
+	spin_lock(&logbuf_lock);
+	printk_cpu = this_cpu;
+
+	if (recursion_bug) {
+		recursion_bug = 0;
+		strcpy(printk_buf, recursion_bug_msg);
+		printed_len = strlen(recursion_bug_msg);
+	}
+	/* Emit the output into the temporary buffer */
+	printed_len += vscnprintf(printk_buf + printed_len,
+				  sizeof(printk_buf) - printed_len, fmt, args);
+
+#ifdef	CONFIG_DEBUG_LL
+	printascii(printk_buf);
+#endif
+
+	printed_len += log_store(printk_buf, cpu_clock(printk_cpu),
+				 printk_cpu);
+
 	/*
 	 * Try to acquire and then immediately release the
 	 * console semaphore. The release will do all the
@@ -1226,13 +1602,17 @@ int is_console_locked(void)
 	return console_locked;
 }
 
-static DEFINE_PER_CPU(int, printk_pending);
-
 void printk_tick(void)
 {
 	if (__this_cpu_read(printk_pending)) {
-		__this_cpu_write(printk_pending, 0);
-		wake_up_interruptible(&log_wait);
+		int pending = __this_cpu_xchg(printk_pending, 0);
+
+		if (pending & PRINTK_PENDING_WAKEUP)
+			wake_up_interruptible(&log_wait);
+#ifdef CONFIG_PRINTK_ASYNC
+		if (pending & PRINTK_PENDING_DRAIN)
+			wake_up(&printk_thread_wait);
+#endif
 	}
 }
 
@@ -1246,7 +1626,7 @@ int printk_needs_cpu(int cpu)
 void wake_up_klogd(void)
 {
 	if (waitqueue_active(&log_wait))
-		this_cpu_write(printk_pending, 1);
+		this_cpu_or(printk_pending, PRINTK_PENDING_WAKEUP);
 }
 
 /**
@@ -1733,6 +2113,8 @@ void kmsg_dump(enum kmsg_dump_reason reason)
 	unsigned long l1, l2;
 	unsigned long flags;
 
+	printk_drain_all();
+
 	/* Theoretically, the log could move on after we do this, but
 	   there's not a lot we can do about that. The new messages
 	   will overwrite the start of what we dump. */
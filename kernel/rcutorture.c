@@ -46,6 +46,8 @@
 #include <linux/stat.h>
 #include <linux/srcu.h>
 #include <linux/slab.h>
+#include <linux/hrtimer.h>
+#include <linux/math64.h>
 #include <asm/byteorder.h>
 
 MODULE_LICENSE("GPL");
@@ -67,6 +69,8 @@ static int fqs_stutter = 3;	/* Wait time between bursts (s). */
 static int test_boost = 1;	/* Test RCU prio boost: 0=no, 1=maybe, 2=yes. */
 static int test_boost_interval = 7; /* Interval between boost tests, seconds. */
 static int test_boost_duration = 4; /* Duration of each boost test, seconds. */
+static int test_flood;		/* call_rcu() callbacks per jiffy, 0=no flood. */
+static int test_flood_cpu;	/* CPU to flood and measure softirq latency. */
 static char *torture_type = "rcu"; /* What RCU implementation to torture. */
 
 module_param(nreaders, int, 0444);
@@ -97,6 +101,10 @@ module_param(test_boost_interval, int, 0444);
 MODULE_PARM_DESC(test_boost_interval, "Interval between boost tests, seconds.");
 module_param(test_boost_duration, int, 0444);
 MODULE_PARM_DESC(test_boost_duration, "Duration of each boost test, seconds.");
+module_param(test_flood, int, 0444);
+MODULE_PARM_DESC(test_flood, "call_rcu() callbacks queued per jiffy, 0=no flood.");
+module_param(test_flood_cpu, int, 0444);
+MODULE_PARM_DESC(test_flood_cpu, "CPU to flood and measure softirq latency on.");
 module_param(torture_type, charp, 0444);
 MODULE_PARM_DESC(torture_type, "Type of RCU to torture (rcu, rcu_bh, srcu)");
 
@@ -119,6 +127,7 @@ static struct task_struct *shuffler_task;
 static struct task_struct *stutter_task;
 static struct task_struct *fqs_task;
 static struct task_struct *boost_tasks[NR_CPUS];
+static struct task_struct *flood_task;
 
 #define RCU_TORTURE_PIPE_LEN 10
 
@@ -151,6 +160,12 @@ static long n_rcu_torture_boost_afferror;
 static long n_rcu_torture_boost_failure;
 static long n_rcu_torture_boosts;
 static long n_rcu_torture_timers;
+static long n_rcu_torture_flood_cbs;
+static long n_rcu_torture_flood_allocerror;
+static atomic_t n_rcu_torture_flood_inflight;
+static unsigned long n_rcu_torture_flood_lat;
+static u64 rcu_torture_flood_lat_sum;
+static u64 rcu_torture_flood_lat_max;
 static struct list_head rcu_torture_removed;
 static cpumask_var_t shuffle_tmp_mask;
 
@@ -817,6 +832,82 @@ checkwait:	rcu_stutter_wait("rcu_torture_boost");
 	return 0;
 }
 
+/*
+ * RCU torture callback-flood testing.  One thread bound to test_flood_cpu
+ * queues test_flood call_rcu() callbacks per jiffy, the way a file-close
+ * storm queues dentries and files, while a per-millisecond hrtimer on
+ * that CPU schedules a tasklet.  The delay from the hrtimer to the
+ * tasklet is the softirq latency, which grows with the time RCU_SOFTIRQ
+ * spends invoking the flood's callbacks, unless the CPU's callbacks are
+ * offloaded with rcu_nocbs=.
+ */
+
+static struct hrtimer flood_timer;
+static ktime_t flood_timer_stamp;
+
+static void rcu_torture_flood_tasklet_fn(unsigned long unused)
+{
+	u64 lat = ktime_to_ns(ktime_sub(ktime_get(), flood_timer_stamp));
+
+	n_rcu_torture_flood_lat++;
+	rcu_torture_flood_lat_sum += lat;
+	if (lat > rcu_torture_flood_lat_max)
+		rcu_torture_flood_lat_max = lat;
+}
+
+static DECLARE_TASKLET(flood_tasklet, rcu_torture_flood_tasklet_fn, 0);
+
+static enum hrtimer_restart rcu_torture_flood_timer_fn(struct hrtimer *timer)
+{
+	/* Don't restamp a tasklet that is still waiting to run. */
+	if (!test_bit(TASKLET_STATE_SCHED, &flood_tasklet.state)) {
+		flood_timer_stamp = ktime_get();
+		tasklet_schedule(&flood_tasklet);
+	}
+	hrtimer_forward_now(timer, ns_to_ktime(NSEC_PER_MSEC));
+	return HRTIMER_RESTART;
+}
+
+static void rcu_torture_flood_cb(struct rcu_head *head)
+{
+	atomic_dec(&n_rcu_torture_flood_inflight);
+	kfree(head);
+}
+
+static int rcu_torture_flood(void *arg)
+{
+	struct rcu_head *rhp;
+	int i;
+
+	VERBOSE_PRINTK_STRING("rcu_torture_flood task started");
+	hrtimer_start(&flood_timer, ns_to_ktime(NSEC_PER_MSEC),
+		      HRTIMER_MODE_REL_PINNED);
+	do {
+		for (i = 0; i < test_flood; i++) {
+			/* Keep memory bounded if grace periods fall behind. */
+			if (atomic_read(&n_rcu_torture_flood_inflight) >
+			    test_flood * HZ)
+				break;
+			rhp = kmalloc(sizeof(*rhp), GFP_KERNEL);
+			if (rhp == NULL) {
+				n_rcu_torture_flood_allocerror++;
+				break;
+			}
+			atomic_inc(&n_rcu_torture_flood_inflight);
+			call_rcu(rhp, rcu_torture_flood_cb);
+			n_rcu_torture_flood_cbs++;
+		}
+		schedule_timeout_interruptible(1);
+		rcu_stutter_wait("rcu_torture_flood");
+	} while (!kthread_should_stop() && fullstop == FULLSTOP_DONTSTOP);
+	hrtimer_cancel(&flood_timer);
+	VERBOSE_PRINTK_STRING("rcu_torture_flood task stopping");
+	rcutorture_shutdown_absorb("rcu_torture_flood");
+	while (!kthread_should_stop())
+		schedule_timeout_uninterruptible(1);
+	return 0;
+}
+
 /*
  * RCU torture force-quiescent-state kthread.  Repeatedly induces
  * bursts of calls to force_quiescent_state(), increasing the probability
@@ -1103,6 +1194,18 @@ rcu_torture_printk(char *page)
 	cnt += sprintf(&page[cnt], "Reader Batch: ");
 	for (i = 0; i < RCU_TORTURE_PIPE_LEN + 1; i++)
 		cnt += sprintf(&page[cnt], " %ld", batchsummary[i]);
+	if (test_flood) {
+		cnt += sprintf(&page[cnt], "\n%s%s ", torture_type, TORTURE_FLAG);
+		cnt += sprintf(&page[cnt],
+			       "Flood: cbs: %ld fae: %ld inflight: %d "
+			       "softirq latency avg: %llu max: %llu ns",
+			       n_rcu_torture_flood_cbs,
+			       n_rcu_torture_flood_allocerror,
+			       atomic_read(&n_rcu_torture_flood_inflight),
+			       div64_u64(rcu_torture_flood_lat_sum,
+					 max(n_rcu_torture_flood_lat, 1UL)),
+			       rcu_torture_flood_lat_max);
+	}
 	cnt += sprintf(&page[cnt], "\n%s%s ", torture_type, TORTURE_FLAG);
 	cnt += sprintf(&page[cnt], "Free-Block Circulation: ");
 	for (i = 0; i < RCU_TORTURE_PIPE_LEN + 1; i++) {
@@ -1248,12 +1351,13 @@ rcu_torture_print_module_parms(struct rcu_torture_ops *cur_ops, char *tag)
 		"shuffle_interval=%d stutter=%d irqreader=%d "
 		"fqs_duration=%d fqs_holdoff=%d fqs_stutter=%d "
 		"test_boost=%d/%d test_boost_interval=%d "
-		"test_boost_duration=%d\n",
+		"test_boost_duration=%d test_flood=%d test_flood_cpu=%d\n",
 		torture_type, tag, nrealreaders, nfakewriters,
 		stat_interval, verbose, test_no_idle_hz, shuffle_interval,
 		stutter, irqreader, fqs_duration, fqs_holdoff, fqs_stutter,
 		test_boost, cur_ops->can_boost,
-		test_boost_interval, test_boost_duration);
+		test_boost_interval, test_boost_duration,
+		test_flood, test_flood_cpu);
 }
 
 static struct notifier_block rcutorture_shutdown_nb = {
@@ -1399,6 +1503,13 @@ rcu_torture_cleanup(void)
 		kthread_stop(fqs_task);
 	}
 	fqs_task = NULL;
+	if (flood_task) {
+		VERBOSE_PRINTK_STRING("Stopping rcu_torture_flood task");
+		kthread_stop(flood_task);
+		tasklet_kill(&flood_tasklet);
+		rcu_barrier();	/* The flood uses call_rcu() whatever the type. */
+	}
+	flood_task = NULL;
 	if ((test_boost == 1 && cur_ops->can_boost) ||
 	    test_boost == 2) {
 		unregister_cpu_notifier(&rcutorture_cpu_nb);
@@ -1490,6 +1601,12 @@ rcu_torture_init(void)
 	n_rcu_torture_boost_afferror = 0;
 	n_rcu_torture_boost_failure = 0;
 	n_rcu_torture_boosts = 0;
+	n_rcu_torture_flood_cbs = 0;
+	n_rcu_torture_flood_allocerror = 0;
+	atomic_set(&n_rcu_torture_flood_inflight, 0);
+	n_rcu_torture_flood_lat = 0;
+	rcu_torture_flood_lat_sum = 0;
+	rcu_torture_flood_lat_max = 0;
 	for (i = 0; i < RCU_TORTURE_PIPE_LEN + 1; i++)
 		atomic_set(&rcu_torture_wcount[i], 0);
 	for_each_possible_cpu(cpu) {
@@ -1603,6 +1720,29 @@ rcu_torture_init(void)
 			goto unwind;
 		}
 	}
+	if (test_flood < 0)
+		test_flood = 0;
+	if (test_flood) {
+		if (test_flood_cpu < 0 || test_flood_cpu >= nr_cpu_ids ||
+		    !cpu_online(test_flood_cpu)) {
+			firsterr = -EINVAL;
+			VERBOSE_PRINTK_ERRSTRING("test_flood_cpu not online");
+			goto unwind;
+		}
+		hrtimer_init(&flood_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		flood_timer.function = rcu_torture_flood_timer_fn;
+		VERBOSE_PRINTK_STRING("Creating rcu_torture_flood task");
+		flood_task = kthread_create(rcu_torture_flood, NULL,
+					    "rcu_torture_flood");
+		if (IS_ERR(flood_task)) {
+			firsterr = PTR_ERR(flood_task);
+			VERBOSE_PRINTK_ERRSTRING("Failed to create flood");
+			flood_task = NULL;
+			goto unwind;
+		}
+		kthread_bind(flood_task, test_flood_cpu);
+		wake_up_process(flood_task);
+	}
 	if (test_boost_interval < 1)
 		test_boost_interval = 1;
 	if (test_boost_duration < 2)
@@ -47,6 +47,8 @@
 #include <linux/mutex.h>
 #include <linux/time.h>
 #include <linux/kernel_stat.h>
+#include <linux/kthread.h>
+#include <linux/tick.h>
 
 #include "rcutree.h"
 
@@ -234,6 +236,9 @@ static int rcu_implicit_offline_qs(struct rcu_data *rdp)
 		return 1;
 	}
 
+	/* A nohz_full CPU notes quiescent states from its tick. */
+	tick_nohz_full_kick_cpu(rdp->cpu);
+
 	/* If preemptable RCU, no point in sending reschedule IPI. */
 	if (rdp->preemptable)
 		return 0;
@@ -1111,13 +1116,15 @@ static void rcu_offline_cpu(int cpu)
 
 /*
  * Invoke any RCU callbacks that have made it to the end of their grace
- * period.  Thottle as specified by rdp->blimit.
+ * period.  Thottle as specified by rdp->blimit.  On a no-CBs CPU, hand
+ * all of them to the CPU's rcuo kthread instead.
  */
 static void rcu_do_batch(struct rcu_state *rsp, struct rcu_data *rdp)
 {
 	unsigned long flags;
 	struct rcu_head *next, *list, **tail;
-	int count;
+	long count;
+	u64 start, delta;
 
 	/* If no callbacks are ready, just return.*/
 	if (!cpu_has_callbacks_ready_to_invoke(rdp))
@@ -1137,23 +1144,33 @@ static void rcu_do_batch(struct rcu_state *rsp, struct rcu_data *rdp)
 			rdp->nxttail[count] = &rdp->nxtlist;
 	local_irq_restore(flags);
 
-	/* Invoke callbacks. */
-	count = 0;
-	while (list) {
-		next = list->next;
-		prefetch(next);
-		debug_rcu_head_unqueue(list);
-		list->func(list);
-		list = next;
-		if (++count >= rdp->blimit)
-			break;
+	/* Invoke callbacks, unless the rcuo kthread takes them. */
+	count = rcu_nocb_enqueue(rdp, list, tail);
+	if (count) {
+		list = NULL;
+	} else {
+		start = local_clock();
+		while (list) {
+			next = list->next;
+			prefetch(next);
+			debug_rcu_head_unqueue(list);
+			list->func(list);
+			list = next;
+			if (++count >= rdp->blimit)
+				break;
+		}
+		delta = local_clock() - start;
+		rdp->n_cbs_invoked += count;
+		rdp->n_batches++;
+		rdp->batch_ns += delta;
+		if (delta > rdp->batch_max_ns)
+			rdp->batch_max_ns = delta;
 	}
 
 	local_irq_save(flags);
 
 	/* Update count, and requeue any remaining callbacks. */
 	rdp->qlen -= count;
-	rdp->n_cbs_invoked += count;
 	if (list != NULL) {
 		*tail = rdp->nxtlist;
 		rdp->nxtlist = list;
@@ -1447,7 +1464,9 @@ __call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
 	 * invoking force_quiescent_state() if the newly enqueued callback
 	 * is the only one waiting for a grace period to complete.
 	 */
-	if (unlikely(++rdp->qlen > rdp->qlen_last_fqs_check + qhimark)) {
+	if (++rdp->qlen > rdp->qlen_max)
+		rdp->qlen_max = rdp->qlen;
+	if (unlikely(rdp->qlen > rdp->qlen_last_fqs_check + qhimark)) {
 
 		/* Are we ignoring a completed grace period? */
 		rcu_process_gp_end(rsp, rdp);
@@ -1471,6 +1490,9 @@ __call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
 		}
 	} else if (ULONG_CMP_LT(ACCESS_ONCE(rsp->jiffies_force_qs), jiffies))
 		force_quiescent_state(rsp, 1);
+
+	/* The callback must not wait for a stretched tick. */
+	tick_nohz_full_kick_cpu(rdp->cpu);
 	local_irq_restore(flags);
 }
 
@@ -1653,6 +1675,16 @@ static int rcu_needs_cpu_quick_check(int cpu)
 	       rcu_preempt_needs_cpu(cpu);
 }
 
+/*
+ * Does RCU need the scheduling-clock tick on this CPU, either to note
+ * and report a quiescent state or to advance and invoke callbacks?
+ * Used by full dynticks to decide whether the tick can be stretched.
+ */
+int rcu_needs_tick(int cpu)
+{
+	return rcu_pending(cpu) || rcu_needs_cpu_quick_check(cpu);
+}
+
 static DEFINE_PER_CPU(struct rcu_head, rcu_barrier_head) = {NULL};
 static atomic_t rcu_barrier_cpu_count;
 static DEFINE_MUTEX(rcu_barrier_mutex);
@@ -1704,6 +1736,7 @@ static void _rcu_barrier(struct rcu_state *rsp,
 	 */
 	atomic_set(&rcu_barrier_cpu_count, 1);
 	on_each_cpu(rcu_barrier_func, (void *)call_rcu_func, 1);
+	rcu_nocb_barrier(rsp);
 	if (atomic_dec_and_test(&rcu_barrier_cpu_count))
 		complete(&rcu_barrier_completion);
 	wait_for_completion(&rcu_barrier_completion);
@@ -1750,6 +1783,7 @@ rcu_boot_init_percpu_data(int cpu, struct rcu_state *rsp)
 	rdp->dynticks = &per_cpu(rcu_dynticks, cpu);
 #endif /* #ifdef CONFIG_NO_HZ */
 	rdp->cpu = cpu;
+	rcu_boot_init_nocb_percpu_data(rdp);
 	raw_spin_unlock_irqrestore(&rnp->lock, flags);
 }
 
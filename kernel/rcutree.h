@@ -27,6 +27,7 @@
 #include <linux/threads.h>
 #include <linux/cpumask.h>
 #include <linux/seqlock.h>
+#include <linux/wait.h>
 
 /*
  * Define shape of hierarchy based on NR_CPUS and CONFIG_RCU_FANOUT.
@@ -205,6 +206,7 @@ struct rcu_data {
 	struct rcu_head *nxtlist;
 	struct rcu_head **nxttail[RCU_NEXT_SIZE];
 	long		qlen;		/* # of queued callbacks */
+	long		qlen_max;	/* High-water mark of ->qlen. */
 	long		qlen_last_fqs_check;
 					/* qlen at last check for QS forcing */
 	unsigned long	n_cbs_invoked;	/* count of RCU cbs invoked. */
@@ -239,6 +241,25 @@ struct rcu_data {
 	unsigned long n_rp_need_fqs;
 	unsigned long n_rp_need_nothing;
 
+	/* 6) rcu_do_batch() statistics. */
+	unsigned long n_batches;	/* Batches invoked from softirq. */
+	u64		batch_ns;	/* Total time spent in those batches. */
+	u64		batch_max_ns;	/* Longest of those batches. */
+
+#ifdef CONFIG_RCU_NOCB_CPU
+	/* 7) callbacks offloaded to this CPU's rcuo kthread. */
+	struct rcu_head *nocb_head;	/* Callbacks waiting for the kthread. */
+	struct rcu_head **nocb_tail;
+	raw_spinlock_t	nocb_lock;	/* Protects ->nocb_head and _tail. */
+	atomic_long_t	nocb_q_count;	/* # of callbacks on ->nocb_head. */
+	unsigned long	n_cbs_offloaded; /* RCU cbs handed to the kthread. */
+	unsigned long	n_nocb_invoked;	/* RCU cbs invoked by the kthread. */
+	unsigned long	n_nocb_batches;	/* # of kthread wakeups with work. */
+	wait_queue_head_t nocb_wq;	/* For the kthread to sleep on. */
+	struct task_struct *nocb_kthread;
+	struct rcu_head	nocb_barrier;	/* For rcu_barrier() on the kthread. */
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
+
 	int cpu;
 };
 
@@ -390,5 +411,9 @@ static void __cpuinit rcu_preempt_init_percpu_data(int cpu);
 static void rcu_preempt_send_cbs_to_online(void);
 static void __init __rcu_init_preempt(void);
 static void rcu_needs_cpu_flush(void);
+static long rcu_nocb_enqueue(struct rcu_data *rdp, struct rcu_head *list,
+			     struct rcu_head **tail);
+static void rcu_nocb_barrier(struct rcu_state *rsp);
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp);
 
 #endif /* #ifndef RCU_TREE_NONCORE */
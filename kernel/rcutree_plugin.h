@@ -1260,3 +1260,203 @@ static void rcu_needs_cpu_flush(void)
 }
 
 #endif /* #else #if !defined(CONFIG_RCU_FAST_NO_HZ) */
+
+#ifdef CONFIG_RCU_NOCB_CPU
+
+/*
+ * Offload callback invocation from the CPUs listed in the rcu_nocbs=
+ * boot parameter.  Grace-period processing is unchanged, but once a
+ * no-CBs CPU's callbacks are ready to invoke, rcu_do_batch() moves them
+ * to a per-CPU, per-flavor list drained by an "rcuo" kthread.  The
+ * kthreads are not bound to their CPU, so that they can be affined to
+ * housekeeping CPUs, taking callback floods out of the softirq of the
+ * CPU that queued them.
+ */
+
+static cpumask_var_t rcu_nocb_mask;	/* CPUs to have callbacks offloaded. */
+static bool have_rcu_nocb_mask;		/* Was rcu_nocb_mask allocated? */
+
+static int __init rcu_nocb_setup(char *str)
+{
+	alloc_bootmem_cpumask_var(&rcu_nocb_mask);
+	have_rcu_nocb_mask = true;
+	cpulist_parse(str, rcu_nocb_mask);
+	return 1;
+}
+__setup("rcu_nocbs=", rcu_nocb_setup);
+
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
+{
+	rdp->nocb_head = NULL;
+	rdp->nocb_tail = &rdp->nocb_head;
+	raw_spin_lock_init(&rdp->nocb_lock);
+	atomic_long_set(&rdp->nocb_q_count, 0);
+	init_waitqueue_head(&rdp->nocb_wq);
+}
+
+/*
+ * Append the callbacks from @list to @tail to the rcuo kthread's list
+ * and wake it up.  The kthread invokes them in order, after any that
+ * were handed to it earlier.
+ */
+static void __rcu_nocb_enqueue(struct rcu_data *rdp, struct rcu_head *list,
+			       struct rcu_head **tail, long count)
+{
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&rdp->nocb_lock, flags);
+	*rdp->nocb_tail = list;
+	rdp->nocb_tail = tail;
+	atomic_long_add(count, &rdp->nocb_q_count);
+	raw_spin_unlock_irqrestore(&rdp->nocb_lock, flags);
+	wake_up(&rdp->nocb_wq);
+}
+
+/*
+ * If this is a no-CBs CPU whose kthread is running, hand it the ready
+ * callbacks extracted by rcu_do_batch() and return how many there were.
+ * Return zero if rcu_do_batch() is to invoke them itself.
+ */
+static long rcu_nocb_enqueue(struct rcu_data *rdp, struct rcu_head *list,
+			     struct rcu_head **tail)
+{
+	struct rcu_head *rhp;
+	long count = 0;
+
+	if (!rdp->nocb_kthread)
+		return 0;
+	for (rhp = list; rhp; rhp = rhp->next)
+		count++;
+	__rcu_nocb_enqueue(rdp, list, tail, count);
+	rdp->n_cbs_offloaded += count;
+	return count;
+}
+
+/*
+ * Make rcu_barrier() also wait for the callbacks already handed to the
+ * rcuo kthreads, including those of CPUs that have since gone offline.
+ * Callbacks still waiting for a grace period on an online CPU reach
+ * the kthread ahead of that CPU's ordinary barrier callback.
+ */
+static void rcu_nocb_barrier(struct rcu_state *rsp)
+{
+	struct rcu_data *rdp;
+	int cpu;
+
+	if (!have_rcu_nocb_mask)
+		return;
+	for_each_cpu(cpu, rcu_nocb_mask) {
+		rdp = per_cpu_ptr(rsp->rda, cpu);
+		if (!rdp->nocb_kthread)
+			continue;
+		atomic_inc(&rcu_barrier_cpu_count);
+		debug_rcu_head_queue(&rdp->nocb_barrier);
+		rdp->nocb_barrier.func = rcu_barrier_callback;
+		rdp->nocb_barrier.next = NULL;
+		__rcu_nocb_enqueue(rdp, &rdp->nocb_barrier,
+				   &rdp->nocb_barrier.next, 1);
+	}
+}
+
+/*
+ * Per-CPU, per-flavor kthread that invokes the callbacks offloaded from
+ * a no-CBs CPU.  Callbacks run with bottom halves disabled, as they
+ * would from RCU_SOFTIRQ, but the kthread gives up the CPU every
+ * blimit callbacks.
+ */
+static int rcu_nocb_kthread(void *arg)
+{
+	struct rcu_data *rdp = arg;
+	struct rcu_head *list, *next;
+	unsigned long flags;
+	long count;
+
+	for (;;) {
+		wait_event_interruptible(rdp->nocb_wq,
+					 ACCESS_ONCE(rdp->nocb_head));
+
+		raw_spin_lock_irqsave(&rdp->nocb_lock, flags);
+		list = rdp->nocb_head;
+		rdp->nocb_head = NULL;
+		rdp->nocb_tail = &rdp->nocb_head;
+		raw_spin_unlock_irqrestore(&rdp->nocb_lock, flags);
+		if (!list)
+			continue;
+
+		count = 0;
+		local_bh_disable();
+		while (list) {
+			next = list->next;
+			prefetch(next);
+			debug_rcu_head_unqueue(list);
+			list->func(list);
+			list = next;
+			if (++count % max(blimit, 1) == 0) {
+				local_bh_enable();
+				cond_resched();
+				local_bh_disable();
+			}
+		}
+		local_bh_enable();
+
+		atomic_long_sub(count, &rdp->nocb_q_count);
+		rdp->n_nocb_invoked += count;
+		rdp->n_nocb_batches++;
+	}
+	return 0;
+}
+
+static void __init rcu_spawn_nocb_kthreads_one(struct rcu_state *rsp,
+					       char flavor)
+{
+	struct task_struct *t;
+	struct rcu_data *rdp;
+	int cpu;
+
+	for_each_cpu(cpu, rcu_nocb_mask) {
+		rdp = per_cpu_ptr(rsp->rda, cpu);
+		t = kthread_run(rcu_nocb_kthread, rdp, "rcuo%c/%d", flavor, cpu);
+		if (IS_ERR(t)) {
+			pr_err("RCU: failed to start rcuo%c/%d, callbacks "
+			       "stay in softirq\n", flavor, cpu);
+			continue;
+		}
+		rdp->nocb_kthread = t;
+	}
+}
+
+static int __init rcu_spawn_nocb_kthreads(void)
+{
+	static char buf[256] __initdata;
+
+	if (!have_rcu_nocb_mask)
+		return 0;
+	cpumask_and(rcu_nocb_mask, rcu_nocb_mask, cpu_possible_mask);
+	cpulist_scnprintf(buf, sizeof(buf), rcu_nocb_mask);
+	pr_info("RCU: offloading callbacks from CPUs %s\n", buf);
+	rcu_spawn_nocb_kthreads_one(&rcu_sched_state, 's');
+	rcu_spawn_nocb_kthreads_one(&rcu_bh_state, 'b');
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	rcu_spawn_nocb_kthreads_one(&rcu_preempt_state, 'p');
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+	return 0;
+}
+early_initcall(rcu_spawn_nocb_kthreads);
+
+#else /* #ifdef CONFIG_RCU_NOCB_CPU */
+
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
+{
+}
+
+static long rcu_nocb_enqueue(struct rcu_data *rdp, struct rcu_head *list,
+			     struct rcu_head **tail)
+{
+	return 0;
+}
+
+static void rcu_nocb_barrier(struct rcu_state *rsp)
+{
+}
+
+#endif /* #else #ifdef CONFIG_RCU_NOCB_CPU */
@@ -42,6 +42,7 @@
 #include <linux/mutex.h>
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
+#include <linux/math64.h>
 
 #define RCU_TREE_NONCORE
 #include "rcutree.h"
@@ -298,6 +299,63 @@ static const struct file_operations rcu_pending_fops = {
 	.release = single_release,
 };
 
+static void print_one_rcu_batch(struct seq_file *m, struct rcu_data *rdp)
+{
+	seq_printf(m, "%3d%cql=%ld qm=%ld ci=%lu nb=%lu ba=%llu bm=%llu",
+		   rdp->cpu,
+		   cpu_is_offline(rdp->cpu) ? '!' : ' ',
+		   rdp->qlen, rdp->qlen_max,
+		   rdp->n_cbs_invoked, rdp->n_batches,
+		   div64_u64(rdp->batch_ns, max(rdp->n_batches, 1UL)),
+		   rdp->batch_max_ns);
+#ifdef CONFIG_RCU_NOCB_CPU
+	if (rdp->nocb_kthread)
+		seq_printf(m, " no=%lu nq=%ld ni=%lu nk=%lu",
+			   rdp->n_cbs_offloaded,
+			   atomic_long_read(&rdp->nocb_q_count),
+			   rdp->n_nocb_invoked, rdp->n_nocb_batches);
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
+	seq_putc(m, '\n');
+}
+
+static void print_rcu_batches(struct seq_file *m, struct rcu_state *rsp)
+{
+	int cpu;
+	struct rcu_data *rdp;
+
+	for_each_possible_cpu(cpu) {
+		rdp = per_cpu_ptr(rsp->rda, cpu);
+		if (rdp->beenonline)
+			print_one_rcu_batch(m, rdp);
+	}
+}
+
+static int show_rcu_batch(struct seq_file *m, void *unused)
+{
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	seq_puts(m, "rcu_preempt:\n");
+	print_rcu_batches(m, &rcu_preempt_state);
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+	seq_puts(m, "rcu_sched:\n");
+	print_rcu_batches(m, &rcu_sched_state);
+	seq_puts(m, "rcu_bh:\n");
+	print_rcu_batches(m, &rcu_bh_state);
+	return 0;
+}
+
+static int rcu_batch_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, show_rcu_batch, NULL);
+}
+
+static const struct file_operations rcu_batch_fops = {
+	.owner = THIS_MODULE,
+	.open = rcu_batch_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static struct dentry *rcudir;
 
 static int __init rcutree_trace_init(void)
@@ -331,6 +389,11 @@ static int __init rcutree_trace_init(void)
 						NULL, &rcu_pending_fops);
 	if (!retval)
 		goto free_out;
+
+	retval = debugfs_create_file("rcu_batch", 0444, rcudir,
+						NULL, &rcu_batch_fops);
+	if (!retval)
+		goto free_out;
 	return 0;
 free_out:
 	debugfs_remove_recursive(rcudir);
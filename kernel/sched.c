@@ -257,6 +257,9 @@ struct task_group {
 	unsigned long shares;
 
 	atomic_t load_weight;
+	atomic_long_t load_avg;
+
+	int latency_nice;
 #endif
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -328,6 +331,11 @@ struct cfs_rq {
 
 	unsigned int nr_spread_over;
 
+#ifdef CONFIG_SMP
+	/* sum of the load_avg_contrib of the queued entities */
+	unsigned long runnable_load_avg;
+#endif
+
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	struct rq *rq;	/* cpu runqueue to which this cfs_rq is attached */
 
@@ -369,6 +377,9 @@ struct cfs_rq {
 	u64 load_stamp, load_last, load_unacc_exec_time;
 
 	unsigned long load_contribution;
+
+	/* the part of tg->load_avg accounted to this cfs_rq */
+	unsigned long tg_load_contrib;
 #endif
 #endif
 };
@@ -468,6 +479,10 @@ struct rq {
 	unsigned long nr_load_updates;
 	u64 nr_switches;
 
+	/* time-decayed nr_running, FIXED_1 scaled, see avg_nr_running() */
+	unsigned long avg_nr_running;
+	u64 avg_nr_running_stamp;
+
 	struct cfs_rq cfs;
 	struct rt_rq rt;
 
@@ -520,6 +535,11 @@ struct rq {
 	u64 avg_idle;
 #endif
 
+#ifdef CONFIG_CPU_IDLE
+	/* exit latency in usecs of the cpuidle state the cpu is in, or 0 */
+	unsigned int idle_exit_latency;
+#endif
+
 #ifdef CONFIG_IRQ_TIME_ACCOUNTING
 	u64 prev_irq_time;
 #endif
@@ -1182,7 +1202,8 @@ static void resched_cpu(int cpu)
 #ifdef CONFIG_NO_HZ
 /*
  * In the semi idle case, use the nearest busy cpu for migrating timers
- * from an idle cpu.  This is good for power-savings.
+ * from an idle cpu.  This is good for power-savings.  nohz_full cpus
+ * are not used, their tick would have to come back for the timers.
  *
  * We don't do similar optimization for completely idle system, as
  * selecting an idle cpu will add more delays to the timers than intended
@@ -1196,7 +1217,7 @@ int get_nohz_timer_target(void)
 
 	for_each_domain(cpu, sd) {
 		for_each_cpu(i, sched_domain_span(sd))
-			if (!idle_cpu(i))
+			if (!idle_cpu(i) && !tick_nohz_full_cpu(i))
 				return i;
 	}
 	return cpu;
@@ -1410,10 +1431,12 @@ enum cpuacct_stat_index {
 
 #ifdef CONFIG_CGROUP_CPUACCT
 static void cpuacct_charge(struct task_struct *tsk, u64 cputime);
+static void cpuacct_flush(int cpu);
 static void cpuacct_update_stats(struct task_struct *tsk,
 		enum cpuacct_stat_index idx, cputime_t val);
 #else
 static inline void cpuacct_charge(struct task_struct *tsk, u64 cputime) {}
+static inline void cpuacct_flush(int cpu) {}
 static inline void cpuacct_update_stats(struct task_struct *tsk,
 		enum cpuacct_stat_index idx, cputime_t val) {}
 #endif
@@ -1428,6 +1451,29 @@ static inline void dec_cpu_load(struct rq *rq, unsigned long load)
 	update_load_sub(&rq->load, load);
 }
 
+/*
+ * The load the balancer and wake placement see: with LOAD_AVG the
+ * runnable averages, so that a task that mostly sleeps weighs little
+ * whatever its nice level, otherwise the weight of what is queued now.
+ */
+static inline unsigned long cfs_rq_load(struct cfs_rq *cfs_rq)
+{
+#ifdef CONFIG_SMP
+	if (sched_feat(LOAD_AVG))
+		return cfs_rq->runnable_load_avg;
+#endif
+	return cfs_rq->load.weight;
+}
+
+static inline unsigned long se_load(struct sched_entity *se)
+{
+#ifdef CONFIG_SMP
+	if (sched_feat(LOAD_AVG))
+		return se->avg.load_avg_contrib;
+#endif
+	return se->load.weight;
+}
+
 #if (defined(CONFIG_SMP) && defined(CONFIG_FAIR_GROUP_SCHED)) || defined(CONFIG_RT_GROUP_SCHED)
 typedef int (*tg_visitor)(struct task_group *, void *);
 
@@ -1477,7 +1523,7 @@ static int tg_nop(struct task_group *tg, void *data)
 /* Used instead of source_load when we know the type == 0 */
 static unsigned long weighted_cpuload(const int cpu)
 {
-	return cpu_rq(cpu)->load.weight;
+	return cfs_rq_load(&cpu_rq(cpu)->cfs);
 }
 
 /*
@@ -1526,7 +1572,7 @@ static unsigned long cpu_avg_load_per_task(int cpu)
 	unsigned long nr_running = ACCESS_ONCE(rq->nr_running);
 
 	if (nr_running)
-		rq->avg_load_per_task = rq->load.weight / nr_running;
+		rq->avg_load_per_task = weighted_cpuload(cpu) / nr_running;
 	else
 		rq->avg_load_per_task = 0;
 
@@ -1546,11 +1592,11 @@ static int tg_load_down(struct task_group *tg, void *data)
 	long cpu = (long)data;
 
 	if (!tg->parent) {
-		load = cpu_rq(cpu)->load.weight;
+		load = weighted_cpuload(cpu);
 	} else {
 		load = tg->parent->cfs_rq[cpu]->h_load;
-		load *= tg->se[cpu]->load.weight;
-		load /= tg->parent->cfs_rq[cpu]->load.weight + 1;
+		load *= se_load(tg->se[cpu]);
+		load /= cfs_rq_load(tg->parent->cfs_rq[cpu]) + 1;
 	}
 
 	tg->cfs_rq[cpu]->h_load = load;
@@ -1744,14 +1790,64 @@ static const struct sched_class rt_sched_class;
 
 #include "sched_stats.h"
 
+/*
+ * The runqueue depth is smoothed with a first order filter whose time
+ * constant is 2^NR_AVG_PERIOD_SHIFT ns (~134ms), long enough to ride out
+ * the wakeup/sleep ping-pong of a single thread but short enough for a
+ * burst of runnable threads to show up within a couple of ticks.
+ */
+#define NR_AVG_PERIOD_SHIFT	27
+
+static inline unsigned long
+__avg_nr_running(unsigned long avg, unsigned long nr, u64 delta)
+{
+	s64 diff;
+
+	if (delta >= (1ULL << NR_AVG_PERIOD_SHIFT))
+		return nr * FIXED_1;
+
+	diff = (s64)(nr * FIXED_1) - (s64)avg;
+	return avg + (long)((diff * (s64)delta) >> NR_AVG_PERIOD_SHIFT);
+}
+
+/*
+ * Folding the average costs a multiply and two stores on every enqueue and
+ * dequeue, so it is only kept up to date while a user has asked for it.
+ */
+static __read_mostly int avg_nr_running_enabled;
+
+void set_avg_nr_running(bool enable)
+{
+	avg_nr_running_enabled = enable;
+}
+
+static inline void update_avg_nr_running(struct rq *rq)
+{
+	if (!avg_nr_running_enabled)
+		return;
+
+	rq->avg_nr_running = __avg_nr_running(rq->avg_nr_running,
+			rq->nr_running, rq->clock - rq->avg_nr_running_stamp);
+	rq->avg_nr_running_stamp = rq->clock;
+}
+
+/*
+ * A nohz_full CPU runs a lone task with its tick stretched; a second
+ * runnable task needs the tick for preemption, and the task leaving
+ * needs its skipped ticks accounted before idle takes over.
+ */
 static void inc_nr_running(struct rq *rq)
 {
-	rq->nr_running++;
+	update_avg_nr_running(rq);
+	if (++rq->nr_running == 2)
+		tick_nohz_full_kick_cpu(cpu_of(rq));
 }
 
 static void dec_nr_running(struct rq *rq)
 {
-	rq->nr_running--;
+	update_avg_nr_running(rq);
+	if (!--rq->nr_running)
+		tick_nohz_full_kick_cpu(cpu_of(rq));
 }
 
 static void set_load_weight(struct task_struct *p)
@@ -2654,6 +2750,9 @@ void sched_fork(struct task_struct *p, int clone_flags)
 			set_load_weight(p);
 		}
 
+		if (p->se.latency_nice < 0)
+			p->se.latency_nice = 0;
+
 		/*
 		 * We don't need the reset flag anymore after the fork. It has
 		 * fulfilled its duty:
@@ -3018,6 +3117,33 @@ unsigned long nr_running(void)
 	return sum;
 }
 
+/*
+ * avg_nr_running: time-decayed number of runnable threads summed over all
+ * online CPUs, scaled by FIXED_1. Only meaningful while enabled with
+ * set_avg_nr_running().
+ *
+ * The per-runqueue averages are only folded when nr_running changes, so
+ * they are projected up to the current time here to avoid reporting a
+ * stale value for CPUs that have been sitting idle (or busy with the same
+ * threads) for a long time. Read locklessly; the result is approximate.
+ */
+unsigned long avg_nr_running(void)
+{
+	unsigned long i, sum = 0;
+
+	for_each_online_cpu(i) {
+		struct rq *rq = cpu_rq(i);
+		u64 stamp = ACCESS_ONCE(rq->avg_nr_running_stamp);
+		u64 now = cpu_clock(i);
+
+		sum += __avg_nr_running(ACCESS_ONCE(rq->avg_nr_running),
+					ACCESS_ONCE(rq->nr_running),
+					now > stamp ? now - stamp : 0);
+	}
+
+	return sum;
+}
+
 unsigned long nr_uninterruptible(void)
 {
 	unsigned long i, sum = 0;
@@ -3396,7 +3522,7 @@ decay_load_missed(unsigned long load, unsigned long missed_updates, int idx)
  */
 static void update_cpu_load(struct rq *this_rq)
 {
-	unsigned long this_load = this_rq->load.weight;
+	unsigned long this_load = cfs_rq_load(&this_rq->cfs);
 	unsigned long curr_jiffies = jiffies;
 	unsigned long pending_updates;
 	int i, scale;
@@ -3920,6 +4046,7 @@ void scheduler_tick(void)
 	update_rq_clock(rq);
 	update_cpu_load_active(rq);
 	curr->sched_class->task_tick(rq, curr, 0);
+	cpuacct_flush(cpu);
 	raw_spin_unlock(&rq->lock);
 
 	perf_event_task_tick();
@@ -4769,6 +4896,31 @@ out_unlock:
 }
 EXPORT_SYMBOL(set_user_nice);
 
+/**
+ * sched_set_latency_nice - set the latency nice value of a task
+ * @p: the task
+ * @latency_nice: new value, MIN_LATENCY_NICE to MAX_LATENCY_NICE
+ *
+ * Lowering the value is subject to the same limits as lowering the
+ * nice value.
+ */
+int sched_set_latency_nice(struct task_struct *p, int latency_nice)
+{
+	unsigned long flags;
+	struct rq *rq;
+
+	if (latency_nice < MIN_LATENCY_NICE || latency_nice > MAX_LATENCY_NICE)
+		return -EINVAL;
+	if (latency_nice < p->se.latency_nice && !can_nice(p, latency_nice))
+		return -EPERM;
+
+	rq = task_rq_lock(p, &flags);
+	p->se.latency_nice = latency_nice;
+	task_rq_unlock(rq, &flags);
+
+	return 0;
+}
+
 /*
  * can_nice - check if a task can reduce its nice value
  * @p: task
@@ -4857,6 +5009,43 @@ int idle_cpu(int cpu)
 	return cpu_curr(cpu) == cpu_rq(cpu)->idle;
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+/**
+ * sched_can_stop_tick - can this cpu run without the scheduler tick?
+ *
+ * Only when a single task is running: preemption between tasks and
+ * SCHED_RR time slices are driven by the tick, and so is the RT
+ * watchdog enforcing RLIMIT_RTTIME, which counts ticks.
+ */
+bool sched_can_stop_tick(void)
+{
+	struct rq *rq = this_rq();
+	struct task_struct *curr = rq->curr;
+
+	if (rq->nr_running != 1 || curr == rq->idle)
+		return false;
+	if (curr->policy == SCHED_RR)
+		return false;
+	if (rt_task(curr) && task_rlimit(curr, RLIMIT_RTTIME) != RLIM_INFINITY)
+		return false;
+	return true;
+}
+#endif
+
+#ifdef CONFIG_CPU_IDLE
+/**
+ * sched_idle_set_exit_latency - note the idle state this cpu is entering
+ * @exit_latency: exit latency of the state in usecs, 0 once it is left
+ *
+ * Called by cpuidle with interrupts disabled, so that wake placement can
+ * tell idle cpus that wake up quickly from those in deep states.
+ */
+void sched_idle_set_exit_latency(unsigned int exit_latency)
+{
+	this_rq()->idle_exit_latency = exit_latency;
+}
+#endif
+
 /**
  * idle_task - return the idle task for a given cpu.
  * @cpu: the processor in question.
@@ -8759,6 +8948,33 @@ done:
 	return 0;
 }
 
+int sched_group_set_latency_nice(struct task_group *tg, int latency_nice)
+{
+	unsigned long flags;
+	int i;
+
+	/*
+	 * The root cgroup has no entities of its own.
+	 */
+	if (!tg->se[0])
+		return -EINVAL;
+
+	if (latency_nice < MIN_LATENCY_NICE || latency_nice > MAX_LATENCY_NICE)
+		return -EINVAL;
+
+	mutex_lock(&shares_mutex);
+	tg->latency_nice = latency_nice;
+	for_each_possible_cpu(i) {
+		struct rq *rq = cpu_rq(i);
+
+		raw_spin_lock_irqsave(&rq->lock, flags);
+		tg->se[i]->latency_nice = latency_nice;
+		raw_spin_unlock_irqrestore(&rq->lock, flags);
+	}
+	mutex_unlock(&shares_mutex);
+	return 0;
+}
+
 unsigned long sched_group_shares(struct task_group *tg)
 {
 	return tg->shares;
@@ -9160,6 +9376,20 @@ static u64 cpu_shares_read_u64(struct cgroup *cgrp, struct cftype *cft)
 
 	return (u64) tg->shares;
 }
+
+static int cpu_latency_nice_write_s64(struct cgroup *cgrp, struct cftype *cft,
+				      s64 val)
+{
+	if (val < MIN_LATENCY_NICE || val > MAX_LATENCY_NICE)
+		return -EINVAL;
+
+	return sched_group_set_latency_nice(cgroup_tg(cgrp), val);
+}
+
+static s64 cpu_latency_nice_read_s64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return cgroup_tg(cgrp)->latency_nice;
+}
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -9193,6 +9423,11 @@ static struct cftype cpu_files[] = {
 		.read_u64 = cpu_shares_read_u64,
 		.write_u64 = cpu_shares_write_u64,
 	},
+	{
+		.name = "latency_nice",
+		.read_s64 = cpu_latency_nice_read_s64,
+		.write_s64 = cpu_latency_nice_write_s64,
+	},
 #endif
 #ifdef CONFIG_RT_GROUP_SCHED
 	{
@@ -9236,11 +9471,26 @@ struct cgroup_subsys cpu_cgroup_subsys = {
  * (balbir@in.ibm.com).
  */
 
+/*
+ * Usage of a group on one cpu. Time is charged to the group a task is
+ * in only, and added to the ancestors later by cpuacct_flush(): at the
+ * next tick of the cpu, or when the usage of any group is read. Both
+ * the charge and the flush run under the cpu's rq->lock.
+ */
+struct cpuacct_usage {
+	u64 usage;		/* this group and its flushed children */
+	u64 pending;		/* charged here, not added to the ancestors */
+	struct list_head dirty;	/* on cpuacct_dirty while pending */
+	struct cpuacct *ca;
+};
+
+/* groups with pending usage on each cpu */
+static DEFINE_PER_CPU(struct list_head, cpuacct_dirty);
+
 /* track cpu usage of a group of tasks and its child groups */
 struct cpuacct {
 	struct cgroup_subsys_state css;
-	/* cpuusage holds pointer to a u64-type object on every cpu */
-	u64 __percpu *cpuusage;
+	struct cpuacct_usage __percpu *cpuusage;
 	struct percpu_counter cpustat[CPUACCT_STAT_NSTATS];
 	struct cpuacct *parent;
 	struct cpuacct_charge_calls *cpufreq_fn;
@@ -9293,10 +9543,19 @@ static struct cgroup_subsys_state *cpuacct_create(
 	if (!ca)
 		goto out;
 
-	ca->cpuusage = alloc_percpu(u64);
+	ca->cpuusage = alloc_percpu(struct cpuacct_usage);
 	if (!ca->cpuusage)
 		goto out_free_ca;
 
+	for_each_possible_cpu(i) {
+		struct cpuacct_usage *u = per_cpu_ptr(ca->cpuusage, i);
+
+		INIT_LIST_HEAD(&u->dirty);
+		u->ca = ca;
+		if (!cgrp->parent)
+			INIT_LIST_HEAD(&per_cpu(cpuacct_dirty, i));
+	}
+
 	for (i = 0; i < CPUACCT_STAT_NSTATS; i++)
 		if (percpu_counter_init(&ca->cpustat[i], 0))
 			goto out_free_counters;
@@ -9331,45 +9590,42 @@ cpuacct_destroy(struct cgroup_subsys *ss, struct cgroup *cgrp)
 	struct cpuacct *ca = cgroup_ca(cgrp);
 	int i;
 
+	/* hand the time still pending here to the parent */
+	for_each_possible_cpu(i) {
+		raw_spin_lock_irq(&cpu_rq(i)->lock);
+		cpuacct_flush(i);
+		raw_spin_unlock_irq(&cpu_rq(i)->lock);
+	}
+
 	for (i = 0; i < CPUACCT_STAT_NSTATS; i++)
 		percpu_counter_destroy(&ca->cpustat[i]);
 	free_percpu(ca->cpuusage);
 	kfree(ca);
 }
 
+/*
+ * Reads flush the cpu first, so that a group's usage includes all the
+ * time charged to its children; rq->lock also makes the 64-bit access
+ * safe on 32-bit platforms.
+ */
 static u64 cpuacct_cpuusage_read(struct cpuacct *ca, int cpu)
 {
-	u64 *cpuusage = per_cpu_ptr(ca->cpuusage, cpu);
 	u64 data;
 
-#ifndef CONFIG_64BIT
-	/*
-	 * Take rq->lock to make 64-bit read safe on 32-bit platforms.
-	 */
 	raw_spin_lock_irq(&cpu_rq(cpu)->lock);
-	data = *cpuusage;
+	cpuacct_flush(cpu);
+	data = per_cpu_ptr(ca->cpuusage, cpu)->usage;
 	raw_spin_unlock_irq(&cpu_rq(cpu)->lock);
-#else
-	data = *cpuusage;
-#endif
 
 	return data;
 }
 
 static void cpuacct_cpuusage_write(struct cpuacct *ca, int cpu, u64 val)
 {
-	u64 *cpuusage = per_cpu_ptr(ca->cpuusage, cpu);
-
-#ifndef CONFIG_64BIT
-	/*
-	 * Take rq->lock to make 64-bit write safe on 32-bit platforms.
-	 */
 	raw_spin_lock_irq(&cpu_rq(cpu)->lock);
-	*cpuusage = val;
+	cpuacct_flush(cpu);
+	per_cpu_ptr(ca->cpuusage, cpu)->usage = val;
 	raw_spin_unlock_irq(&cpu_rq(cpu)->lock);
-#else
-	*cpuusage = val;
-#endif
 }
 
 /* return total cpu usage (in nanoseconds) of a group */
@@ -9500,6 +9756,7 @@ static int cpuacct_populate(struct cgroup_subsys *ss, struct cgroup *cgrp)
  */
 static void cpuacct_charge(struct task_struct *tsk, u64 cputime)
 {
+	struct cpuacct_usage *u;
 	struct cpuacct *ca;
 	int cpu;
 
@@ -9511,12 +9768,21 @@ static void cpuacct_charge(struct task_struct *tsk, u64 cputime)
 	rcu_read_lock();
 
 	ca = task_ca(tsk);
+	u = per_cpu_ptr(ca->cpuusage, cpu);
+	u->usage += cputime;
+	if (ca->parent) {
+		if (list_empty(&u->dirty))
+			list_add(&u->dirty, &per_cpu(cpuacct_dirty, cpu));
+		u->pending += cputime;
+	}
 
-	for (; ca; ca = ca->parent) {
-		u64 *cpuusage = per_cpu_ptr(ca->cpuusage, cpu);
-		*cpuusage += cputime;
-
-		/* Call back into platform code to account for CPU speeds */
+	/*
+	 * Call back into platform code to account for CPU speeds. This
+	 * needs the speed at the time of the charge, so it is not
+	 * deferred like the usage, but only walks the hierarchy when the
+	 * platform registered its calls.
+	 */
+	for (; cpuacct_cpufreq && ca; ca = ca->parent) {
 		if (ca->cpufreq_fn && ca->cpufreq_fn->charge)
 			ca->cpufreq_fn->charge(ca->cpuacct_data, cputime, cpu);
 	}
@@ -9524,6 +9790,29 @@ static void cpuacct_charge(struct task_struct *tsk, u64 cputime)
 	rcu_read_unlock();
 }
 
+/*
+ * Add the time pending on @cpu to the ancestors of the groups it was
+ * charged to. Called with the cpu's rq->lock held, from the tick and
+ * before usage is read, so the hierarchy is walked once per group and
+ * tick instead of on every context switch.
+ */
+static void cpuacct_flush(int cpu)
+{
+	struct list_head *dirty = &per_cpu(cpuacct_dirty, cpu);
+	struct cpuacct_usage *u, *next;
+	struct cpuacct *ca;
+
+	if (unlikely(!cpuacct_subsys.active))
+		return;
+
+	list_for_each_entry_safe(u, next, dirty, dirty) {
+		for (ca = u->ca->parent; ca; ca = ca->parent)
+			per_cpu_ptr(ca->cpuusage, cpu)->usage += u->pending;
+		u->pending = 0;
+		list_del_init(&u->dirty);
+	}
+}
+
 /*
  * When CONFIG_VIRT_CPU_ACCOUNTING is enabled one jiffy can be very large
  * in cputime_t units. As a result, cpuacct_update_stats calls
@@ -528,6 +528,17 @@ static u64 sched_slice(struct cfs_rq *cfs_rq, struct sched_entity *se)
 			load = &lw;
 		}
 		slice = calc_delta_mine(slice, se->load.weight, load);
+
+		/*
+		 * Latency nice shortens or stretches the slice, from half
+		 * to about one and a half times its length; vruntime still
+		 * advances by weight, so the share stays the same.
+		 */
+		if (unlikely(se->latency_nice)) {
+			slice = div_u64(slice * (LATENCY_NICE_WIDTH +
+						 se->latency_nice),
+					LATENCY_NICE_WIDTH);
+		}
 	}
 	return slice;
 }
@@ -702,6 +713,226 @@ account_entity_dequeue(struct cfs_rq *cfs_rq, struct sched_entity *se)
 	cfs_rq->nr_running--;
 }
 
+#ifdef CONFIG_SMP
+/*
+ * Per-entity load tracking
+ *
+ * Time is split into periods of 1024us. A period that is p periods in
+ * the past counts y^p as much as the current one, with y^32 = 1/2, so
+ * the load of an entity is mostly decided by the last ~100ms. Every
+ * entity, task or group, tracks the fraction of that time it was
+ * runnable; scaled by its weight, it contributes that fraction to the
+ * runnable_load_avg of the cfs_rq it is queued on, which therefore is
+ * the load a cpu (or a group on a cpu) is expected to carry.
+ */
+#define LOAD_AVG_PERIOD	32
+#define LOAD_AVG_MAX	47742	/* maximum possible runnable_avg_sum */
+#define LOAD_AVG_MAX_N	345	/* periods it takes to get there */
+
+/* 2^32 * y^n */
+static const u32 runnable_avg_yN_inv[] = {
+	0xffffffff, 0xfa83b2da, 0xf5257d14, 0xefe4b99a, 0xeac0c6e6, 0xe5b906e6,
+	0xe0ccdeeb, 0xdbfbb796, 0xd744fcc9, 0xd2a81d91, 0xce248c14, 0xc9b9bd85,
+	0xc5672a10, 0xc12c4cc9, 0xbd08a39e, 0xb8fbaf46, 0xb504f333, 0xb123f581,
+	0xad583ee9, 0xa9a15ab4, 0xa5fed6a9, 0xa2704302, 0x9ef5325f, 0x9b8d39b9,
+	0x9837f050, 0x94f4efa8, 0x91c3d373, 0x8ea4398a, 0x8b95c1e3, 0x88980e80,
+	0x85aac367, 0x82cd8698,
+};
+
+/* 1024 * (y^1 + y^2 + ... + y^n) */
+static const u32 runnable_avg_yN_sum[] = {
+	    0,  1002,  1982,  2942,  3881,  4800,  5699,  6579,  7440,  8282,
+	 9107,  9914, 10704, 11476, 12232, 12972, 13696, 14405, 15098, 15777,
+	16441, 17091, 17726, 18349, 18957, 19553, 20136, 20707, 21265, 21812,
+	22346, 22870, 23382,
+};
+
+/* val * y^n */
+static u64 decay_load(u64 val, u64 n)
+{
+	if (!n)
+		return val;
+	if (unlikely(n > LOAD_AVG_PERIOD * 63))
+		return 0;
+
+	if (n >= LOAD_AVG_PERIOD) {
+		val >>= n / LOAD_AVG_PERIOD;
+		n %= LOAD_AVG_PERIOD;
+	}
+
+	val *= runnable_avg_yN_inv[n];
+	return val >> 32;
+}
+
+/* 1024 * (y^1 + ... + y^n): n full periods of running, seen from now */
+static u32 __compute_runnable_contrib(u64 n)
+{
+	u32 contrib = 0;
+
+	if (likely(n <= LOAD_AVG_PERIOD))
+		return runnable_avg_yN_sum[n];
+	if (unlikely(n >= LOAD_AVG_MAX_N))
+		return LOAD_AVG_MAX;
+
+	/* each block of 32 periods is worth half the one after it */
+	do {
+		contrib /= 2;
+		contrib += runnable_avg_yN_sum[LOAD_AVG_PERIOD];
+		n -= LOAD_AVG_PERIOD;
+	} while (n > LOAD_AVG_PERIOD);
+
+	contrib = decay_load(contrib, n);
+	return contrib + runnable_avg_yN_sum[n];
+}
+
+/*
+ * Account the time since the last update as runnable or not. Returns true
+ * if a period boundary was crossed, that is if the average changed enough
+ * to be worth recomputing the contribution.
+ */
+static int __update_entity_runnable_avg(u64 now, struct sched_avg *sa,
+					int runnable)
+{
+	u64 delta, periods;
+	u32 runnable_contrib;
+	int delta_w, decayed = 0;
+
+	delta = now - sa->last_runnable_update;
+	/* clocks of different cpus can be slightly out of step */
+	if ((s64)delta < 0) {
+		sa->last_runnable_update = now;
+		return 0;
+	}
+
+	/* count in units of 1024ns, ~1us */
+	delta >>= 10;
+	if (!delta)
+		return 0;
+	sa->last_runnable_update += delta << 10;
+
+	delta_w = sa->runnable_avg_period % 1024;
+	if (delta + delta_w >= 1024) {
+		decayed = 1;
+
+		/* finish the period in progress */
+		delta_w = 1024 - delta_w;
+		if (runnable)
+			sa->runnable_avg_sum += delta_w;
+		sa->runnable_avg_period += delta_w;
+		delta -= delta_w;
+
+		/* decay it and every full period after it */
+		periods = div64_u64(delta, 1024);
+		delta -= periods * 1024;
+
+		sa->runnable_avg_sum = decay_load(sa->runnable_avg_sum,
+						  periods + 1);
+		sa->runnable_avg_period = decay_load(sa->runnable_avg_period,
+						     periods + 1);
+
+		runnable_contrib = __compute_runnable_contrib(periods);
+		if (runnable)
+			sa->runnable_avg_sum += runnable_contrib;
+		sa->runnable_avg_period += runnable_contrib;
+	}
+
+	/* and start the current one */
+	if (runnable)
+		sa->runnable_avg_sum += delta;
+	sa->runnable_avg_period += delta;
+
+	return decayed;
+}
+
+/* Recompute se's load_avg_contrib, returning by how much it changed */
+static long __update_entity_load_avg_contrib(struct sched_entity *se)
+{
+	struct sched_avg *sa = &se->avg;
+	long old_contrib = sa->load_avg_contrib;
+
+	sa->load_avg_contrib = div_u64((u64)sa->runnable_avg_sum *
+				       se->load.weight,
+				       sa->runnable_avg_period + 1);
+
+	return (long)sa->load_avg_contrib - old_contrib;
+}
+
+#ifdef CONFIG_FAIR_GROUP_SCHED
+/*
+ * Fold a change of a cfs_rq's runnable_load_avg into the load of its task
+ * group across all cpus, once it is big enough to matter.
+ */
+static void update_tg_load_avg(struct cfs_rq *cfs_rq, int force_update)
+{
+	long delta = cfs_rq->runnable_load_avg - cfs_rq->tg_load_contrib;
+
+	if (force_update || abs(delta) > cfs_rq->tg_load_contrib / 8) {
+		atomic_long_add(delta, &cfs_rq->tg->load_avg);
+		cfs_rq->tg_load_contrib += delta;
+	}
+}
+#else
+static inline void update_tg_load_avg(struct cfs_rq *cfs_rq,
+				      int force_update) { }
+#endif
+
+/* Bring se's average up to date; it is runnable if it is queued */
+static void update_entity_load_avg(struct sched_entity *se)
+{
+	struct cfs_rq *cfs_rq = cfs_rq_of(se);
+	long contrib_delta;
+
+	if (!__update_entity_runnable_avg(rq_of(cfs_rq)->clock_task,
+					  &se->avg, se->on_rq))
+		return;
+
+	contrib_delta = __update_entity_load_avg_contrib(se);
+	if (se->on_rq) {
+		cfs_rq->runnable_load_avg += contrib_delta;
+		update_tg_load_avg(cfs_rq, 0);
+	}
+}
+
+/* Called before se->on_rq is set: the time up to now it was not runnable */
+static void enqueue_entity_load_avg(struct cfs_rq *cfs_rq,
+				    struct sched_entity *se)
+{
+	__update_entity_runnable_avg(rq_of(cfs_rq)->clock_task, &se->avg, 0);
+	__update_entity_load_avg_contrib(se);
+
+	cfs_rq->runnable_load_avg += se->avg.load_avg_contrib;
+	update_tg_load_avg(cfs_rq, 0);
+}
+
+/* Called before se->on_rq is cleared: the time up to now it was runnable */
+static void dequeue_entity_load_avg(struct cfs_rq *cfs_rq,
+				    struct sched_entity *se)
+{
+	__update_entity_runnable_avg(rq_of(cfs_rq)->clock_task, &se->avg, 1);
+
+	cfs_rq->runnable_load_avg -= se->avg.load_avg_contrib;
+	__update_entity_load_avg_contrib(se);
+	update_tg_load_avg(cfs_rq, 0);
+}
+
+/* A new task starts out as if it had always been runnable */
+static void init_task_load_avg(struct rq *rq, struct sched_entity *se)
+{
+	se->avg.runnable_avg_sum = LOAD_AVG_MAX;
+	se->avg.runnable_avg_period = LOAD_AVG_MAX;
+	se->avg.last_runnable_update = rq->clock_task;
+	__update_entity_load_avg_contrib(se);
+}
+#else
+static inline void update_entity_load_avg(struct sched_entity *se) { }
+static inline void enqueue_entity_load_avg(struct cfs_rq *cfs_rq,
+					   struct sched_entity *se) { }
+static inline void dequeue_entity_load_avg(struct cfs_rq *cfs_rq,
+					   struct sched_entity *se) { }
+static inline void init_task_load_avg(struct rq *rq,
+				      struct sched_entity *se) { }
+#endif /* CONFIG_SMP */
+
 #ifdef CONFIG_FAIR_GROUP_SCHED
 # ifdef CONFIG_SMP
 static void update_cfs_rq_load_contribution(struct cfs_rq *cfs_rq,
@@ -767,15 +998,24 @@ static void update_cfs_load(struct cfs_rq *cfs_rq, int global_update)
 		list_del_leaf_cfs_rq(cfs_rq);
 }
 
+/*
+ * The load of tg on all cpus but this cfs_rq's one, in the same metric as
+ * cfs_rq_load(): the runnable averages with LOAD_AVG, the weights otherwise.
+ */
+static long tg_load_elsewhere(struct cfs_rq *cfs_rq, struct task_group *tg)
+{
+	if (sched_feat(LOAD_AVG))
+		return atomic_long_read(&tg->load_avg) - cfs_rq->tg_load_contrib;
+
+	return atomic_read(&tg->load_weight) - cfs_rq->load_contribution;
+}
+
 static long calc_cfs_shares(struct cfs_rq *cfs_rq, struct task_group *tg)
 {
 	long load_weight, load, shares;
 
-	load = cfs_rq->load.weight;
-
-	load_weight = atomic_read(&tg->load_weight);
-	load_weight += load;
-	load_weight -= cfs_rq->load_contribution;
+	load = cfs_rq_load(cfs_rq);
+	load_weight = tg_load_elsewhere(cfs_rq, tg) + load;
 
 	shares = (tg->shares * load);
 	if (load_weight)
@@ -980,6 +1220,7 @@ enqueue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
 	 */
 	update_curr(cfs_rq);
 	update_cfs_load(cfs_rq, 0);
+	enqueue_entity_load_avg(cfs_rq, se);
 	account_entity_enqueue(cfs_rq, se);
 	update_cfs_shares(cfs_rq);
 
@@ -1071,6 +1312,7 @@ dequeue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
 
 	if (se != cfs_rq->curr)
 		__dequeue_entity(cfs_rq, se);
+	dequeue_entity_load_avg(cfs_rq, se);
 	se->on_rq = 0;
 	update_cfs_load(cfs_rq, 0);
 	account_entity_dequeue(cfs_rq, se);
@@ -1214,6 +1456,7 @@ static void put_prev_entity(struct cfs_rq *cfs_rq, struct sched_entity *prev)
 
 	check_spread(cfs_rq, prev);
 	if (prev->on_rq) {
+		update_entity_load_avg(prev);
 		update_stats_wait_start(cfs_rq, prev);
 		/* Put 'current' back into the tree. */
 		__enqueue_entity(cfs_rq, prev);
@@ -1228,6 +1471,7 @@ entity_tick(struct cfs_rq *cfs_rq, struct sched_entity *curr, int queued)
 	 * Update run-time statistics of the 'current'.
 	 */
 	update_curr(cfs_rq);
+	update_entity_load_avg(curr);
 
 	/*
 	 * Update share accounting for long-running entities.
@@ -1403,12 +1647,10 @@ static long effective_load(struct task_group *tg, int cpu, long wl, long wg)
 		long lw, w;
 
 		tg = se->my_q->tg;
-		w = se->my_q->load.weight;
+		w = cfs_rq_load(se->my_q);
 
 		/* use this cpu's instantaneous contribution */
-		lw = atomic_read(&tg->load_weight);
-		lw -= se->my_q->load_contribution;
-		lw += w + wg;
+		lw = tg_load_elsewhere(se->my_q, tg) + w + wg;
 
 		wl += w;
 
@@ -1420,7 +1662,7 @@ static long effective_load(struct task_group *tg, int cpu, long wl, long wg)
 		/* zero point is MIN_SHARES */
 		if (wl < MIN_SHARES)
 			wl = MIN_SHARES;
-		wl -= se->load.weight;
+		wl -= se_load(se);
 		wg = 0;
 	}
 
@@ -1460,14 +1702,14 @@ static int wake_affine(struct sched_domain *sd, struct task_struct *p, int sync)
 	rcu_read_lock();
 	if (sync) {
 		tg = task_group(current);
-		weight = current->se.load.weight;
+		weight = se_load(&current->se);
 
 		this_load += effective_load(tg, this_cpu, -weight, -weight);
 		load += effective_load(tg, prev_cpu, 0, -weight);
 	}
 
 	tg = task_group(p);
-	weight = p->se.load.weight;
+	weight = se_load(&p->se);
 
 	/*
 	 * In low-load situations, where prev_cpu is idle and this_cpu is idle
@@ -1600,28 +1842,67 @@ find_idlest_cpu(struct sched_group *group, struct task_struct *p, int this_cpu)
 }
 
 /*
- * Try and locate an idle CPU in the sched_domain.
+ * Idle states exiting within this many usecs, WFI-like states such as
+ * the 10us tegra LP3, are as good as polling for a wakeup.
+ */
+#define SHALLOW_IDLE_LATENCY	20
+
+/*
+ * Exit latency in usecs of the idle state @cpu is in, 0 when it is
+ * polling or its state is not known.
+ */
+static inline unsigned int idle_exit_latency(int cpu)
+{
+#ifdef CONFIG_CPU_IDLE
+	if (sched_feat(IDLE_DEPTH))
+		return ACCESS_ONCE(cpu_rq(cpu)->idle_exit_latency);
+#endif
+	return 0;
+}
+
+/*
+ * Try and locate an idle CPU in the sched_domain, the one in the
+ * shallowest idle state if there are several.
  */
 static int select_idle_sibling(struct task_struct *p, int target)
 {
 	int cpu = smp_processor_id();
 	int prev_cpu = task_cpu(p);
+	unsigned int latency, best_latency = UINT_MAX;
+	int best_cpu = -1;
 	struct sched_domain *sd;
-	int i;
+	u64 avg_idle, time;
+	int i, nr = INT_MAX;
 
 	/*
 	 * If the task is going to be woken-up on this cpu and if it is
-	 * already idle, then it is the right target.
+	 * already idle, then it is the right target, unless it sits in a
+	 * deep idle state and a sibling is in a shallower one.
 	 */
-	if (target == cpu && idle_cpu(cpu))
-		return cpu;
+	if (target == cpu && idle_cpu(cpu)) {
+		best_latency = idle_exit_latency(cpu);
+		if (best_latency <= SHALLOW_IDLE_LATENCY)
+			return cpu;
+		best_cpu = cpu;
+	}
 
 	/*
 	 * If the task is going to be woken-up on the cpu where it previously
 	 * ran and if it is currently idle, then it the right target.
 	 */
-	if (target == prev_cpu && idle_cpu(prev_cpu))
-		return prev_cpu;
+	if (target == prev_cpu && idle_cpu(prev_cpu)) {
+		best_latency = idle_exit_latency(prev_cpu);
+		if (best_latency <= SHALLOW_IDLE_LATENCY)
+			return prev_cpu;
+		best_cpu = prev_cpu;
+	}
+
+	/*
+	 * The waking cpu's average idle time stands in for how long an
+	 * idle cpu found here would stay idle: spending more than a small
+	 * fraction of that on the search does not pay.
+	 */
+	avg_idle = this_rq()->avg_idle / 512;
 
 	/*
 	 * Otherwise, iterate the domains and find an elegible idle cpu.
@@ -1630,13 +1911,43 @@ static int select_idle_sibling(struct task_struct *p, int target)
 		if (!(sd->flags & SD_SHARE_PKG_RESOURCES))
 			break;
 
+		if (sched_feat(SIS_BOUND)) {
+			u64 avg_cost = ACCESS_ONCE(sd->avg_scan_cost) + 1;
+			u64 span_avg = sd->span_weight * avg_idle;
+
+			if (span_avg > 4 * avg_cost)
+				nr = div64_u64(span_avg, avg_cost);
+			else
+				nr = 4;
+		}
+
+		time = local_clock();
+
 		for_each_cpu_and(i, sched_domain_span(sd), &p->cpus_allowed) {
-			if (idle_cpu(i)) {
-				target = i;
+			if (!nr--)
 				break;
+			if (!idle_cpu(i))
+				continue;
+
+			latency = idle_exit_latency(i);
+			if (latency < best_latency) {
+				best_latency = latency;
+				best_cpu = i;
+				if (latency <= SHALLOW_IDLE_LATENCY)
+					break;
 			}
 		}
 
+		/*
+		 * An unsigned long, so that a 32-bit cpu reading it in
+		 * another wakeup never sees half an update.
+		 */
+		time = local_clock() - time;
+		sd->avg_scan_cost += ((long)time - (long)sd->avg_scan_cost) / 8;
+
+		if (best_cpu >= 0 && best_latency <= SHALLOW_IDLE_LATENCY)
+			break;
+
 		/*
 		 * Lets stop looking for an idle sibling when we reached
 		 * the domain that spans the current cpu and prev_cpu.
@@ -1646,7 +1957,20 @@ static int select_idle_sibling(struct task_struct *p, int target)
 			break;
 	}
 
-	return target;
+	if (best_cpu < 0)
+		return target;
+
+	/*
+	 * Only deep idle states left: when the target runs a single task,
+	 * the woken one gets the cpu within about a minimum granularity,
+	 * which is cheaper than an exit latency longer than that.
+	 */
+	if (best_cpu != target && !idle_cpu(target) &&
+	    cpu_rq(target)->nr_running <= 1 &&
+	    (u64)best_latency * NSEC_PER_USEC > sysctl_sched_min_granularity)
+		return target;
+
+	return best_cpu;
 }
 
 /*
@@ -1822,6 +2146,17 @@ wakeup_preempt_entity(struct sched_entity *curr, struct sched_entity *se)
 		return -1;
 
 	gran = wakeup_gran(curr, se);
+
+	/*
+	 * Every step of latency nice between the two moves the threshold
+	 * by a twentieth of the wakeup granularity: a task 20 steps more
+	 * latency sensitive than curr preempts it whenever it is behind.
+	 */
+	if (unlikely(se->latency_nice != curr->latency_nice)) {
+		gran += div_s64((s64)sysctl_sched_wakeup_granularity *
+				(se->latency_nice - curr->latency_nice),
+				LATENCY_NICE_WIDTH / 2);
+	}
 	if (vdiff > gran)
 		return 1;
 
@@ -2111,6 +2446,7 @@ balance_tasks(struct rq *this_rq, int this_cpu, struct rq *busiest,
 	int loops = 0, pulled = 0;
 	long rem_load_move = max_load_move;
 	struct task_struct *p, *n;
+	unsigned long load;
 
 	if (max_load_move == 0)
 		goto out;
@@ -2119,14 +2455,15 @@ balance_tasks(struct rq *this_rq, int this_cpu, struct rq *busiest,
 		if (loops++ > sysctl_sched_nr_migrate)
 			break;
 
-		if ((p->se.load.weight >> 1) > rem_load_move ||
+		load = se_load(&p->se);
+		if ((load >> 1) > rem_load_move ||
 		    !can_migrate_task(p, busiest, this_cpu, sd, idle,
 				      all_pinned))
 			continue;
 
 		pull_task(busiest, p, this_rq, this_cpu);
 		pulled++;
-		rem_load_move -= p->se.load.weight;
+		rem_load_move -= load;
 
 #ifdef CONFIG_PREEMPT
 		/*
@@ -2218,7 +2555,7 @@ load_balance_fair(struct rq *this_rq, int this_cpu, struct rq *busiest,
 	list_for_each_entry_rcu(tg, &task_groups, list) {
 		struct cfs_rq *busiest_cfs_rq = tg->cfs_rq[busiest_cpu];
 		unsigned long busiest_h_load = busiest_cfs_rq->h_load;
-		unsigned long busiest_weight = busiest_cfs_rq->load.weight;
+		unsigned long busiest_weight = cfs_rq_load(busiest_cfs_rq);
 		u64 rem_load, moved_load;
 
 		/*
@@ -4099,6 +4436,7 @@ static void task_fork_fair(struct task_struct *p)
 	}
 
 	update_curr(cfs_rq);
+	init_task_load_avg(rq, se);
 
 	if (curr)
 		se->vruntime = curr->vruntime;
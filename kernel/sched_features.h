@@ -49,6 +49,20 @@ SCHED_FEAT(CACHE_HOT_BUDDY, 1)
  */
 SCHED_FEAT(ARCH_POWER, 0)
 
+/*
+ * Balance and place wakeups by the runnable averages of the entities
+ * rather than by the weight of what is queued at the moment.
+ */
+SCHED_FEAT(LOAD_AVG, 1)
+
+/*
+ * Prefer idle cpus in shallow cpuidle states when placing wakeups, and
+ * bound the search for one by what it costs against how long cpus stay
+ * idle on average.
+ */
+SCHED_FEAT(IDLE_DEPTH, 1)
+SCHED_FEAT(SIS_BOUND, 1)
+
 SCHED_FEAT(HRTICK, 0)
 SCHED_FEAT(DOUBLE_TICK, 0)
 SCHED_FEAT(LB_BIAS, 1)
@@ -45,6 +45,8 @@
 #include <linux/user_namespace.h>
 
 #include <linux/kmsg_dump.h>
+#include <linux/futex.h>
+#include <linux/tick.h>
 
 #include <asm/uaccess.h>
 #include <asm/io.h>
@@ -1398,6 +1400,11 @@ int do_prlimit(struct task_struct *tsk, unsigned int resource,
 	 if (!retval && new_rlim && resource == RLIMIT_CPU &&
 			 new_rlim->rlim_cur != RLIM_INFINITY)
 		update_rlimit_cpu(tsk, new_rlim->rlim_cur);
+
+	/* The RT watchdog counts ticks, which may be stretched */
+	if (!retval && new_rlim && resource == RLIMIT_RTTIME &&
+	    new_rlim->rlim_cur != RLIM_INFINITY)
+		tick_nohz_full_kick_group(tsk);
 out:
 	read_unlock(&tasklist_lock);
 	return retval;
@@ -1763,6 +1770,37 @@ SYSCALL_DEFINE5(prctl, int, option, unsigned long, arg2, unsigned long, arg3,
 			else
 				error = PR_MCE_KILL_DEFAULT;
 			break;
+		case PR_SET_FUTEX_HASH:
+		case PR_GET_FUTEX_HASH:
+			if (arg3 | arg4 | arg5)
+				return -EINVAL;
+			error = futex_hash_prctl(option, arg2);
+			break;
+#ifdef CONFIG_RECLAIM_OFFLOAD
+		case PR_SET_RECLAIM_OFFLOAD:
+			if (arg2 > 1 || arg3 | arg4 | arg5)
+				return -EINVAL;
+			current->reclaim_offload = arg2;
+			error = 0;
+			break;
+		case PR_GET_RECLAIM_OFFLOAD:
+			if (arg3 | arg4 | arg5)
+				return -EINVAL;
+			error = put_user(current->reclaim_offload,
+					 (int __user *)arg2);
+			break;
+#endif
+		case PR_SET_LATENCY_NICE:
+			if (arg3 | arg4 | arg5)
+				return -EINVAL;
+			error = sched_set_latency_nice(me, (int)arg2);
+			break;
+		case PR_GET_LATENCY_NICE:
+			if (arg3 | arg4 | arg5)
+				return -EINVAL;
+			error = put_user(me->se.latency_nice,
+					 (int __user *)arg2);
+			break;
 		default:
 			error = -EINVAL;
 			break;
@@ -20,6 +20,8 @@
 #include <linux/profile.h>
 #include <linux/sched.h>
 #include <linux/module.h>
+#include <linux/bootmem.h>
+#include <linux/smp.h>
 
 #include <asm/irq_regs.h>
 
@@ -123,6 +125,46 @@ static int __init setup_tick_nohz(char *str)
 
 __setup("nohz=", setup_tick_nohz);
 
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * CPUs on which the tick is stretched while a single task runs
+ */
+cpumask_var_t tick_nohz_full_mask;
+int tick_nohz_full_running __read_mostly;
+
+static int __init tick_nohz_full_setup(char *str)
+{
+	int cpu = smp_processor_id();
+
+	alloc_bootmem_cpumask_var(&tick_nohz_full_mask);
+	if (cpulist_parse(str, tick_nohz_full_mask) < 0) {
+		printk(KERN_WARNING "NOHZ: bad nohz_full= cpu list\n");
+		return 1;
+	}
+	/* The boot CPU keeps the timekeeping duty */
+	if (cpumask_test_cpu(cpu, tick_nohz_full_mask)) {
+		printk(KERN_WARNING "NOHZ: CPU %d kept out of nohz_full\n", cpu);
+		cpumask_clear_cpu(cpu, tick_nohz_full_mask);
+	}
+	tick_nohz_full_running = !cpumask_empty(tick_nohz_full_mask);
+	return 1;
+}
+__setup("nohz_full=", tick_nohz_full_setup);
+
+/*
+ * The nohz_full CPUs do not update jiffies while their tick is
+ * stretched, so the CPU which has the do_timer duty keeps its tick
+ * across idle instead of handing the duty to whoever ticks next.
+ */
+static inline int tick_nohz_full_housekeeping(int cpu)
+{
+	return tick_nohz_full_running && cpu == tick_do_timer_cpu &&
+	       !tick_nohz_full_cpu(cpu);
+}
+#else
+static inline int tick_nohz_full_housekeeping(int cpu) { return 0; }
+#endif
+
 /**
  * tick_nohz_update_jiffies - update jiffies when idle was interrupted
  *
@@ -324,7 +366,7 @@ void tick_nohz_stop_sched_tick(int inidle)
 	} while (read_seqretry(&xtime_lock, seq));
 
 	if (rcu_needs_cpu(cpu) || printk_needs_cpu(cpu) ||
-	    arch_needs_cpu(cpu)) {
+	    arch_needs_cpu(cpu) || tick_nohz_full_housekeeping(cpu)) {
 		next_jiffies = last_jiffies + 1;
 		delta_jiffies = 1;
 	} else {
@@ -569,6 +611,8 @@ static void tick_nohz_handler(struct clock_event_device *dev)
 	ktime_t now = ktime_get();
 
 	dev->next_event.tv64 = KTIME_MAX;
+	if (idle_cpu(cpu))
+		timer_stats_cpu_event(TIMER_STATS_CPU_WAKEUP);
 
 	/*
 	 * Check if the do_timer duty was dropped. We don't care about
@@ -711,6 +755,192 @@ void tick_check_idle(int cpu)
  * High resolution timer specific code
  */
 #ifdef CONFIG_HIGH_RES_TIMERS
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * Full dynticks: when the tick of a nohz_full CPU finds a single task
+ * running and nothing else depending on the tick, it is pushed out to
+ * the next timer wheel event, but at most a second. The residual tick
+ * keeps the scheduler statistics, the load average and the CPU-time
+ * limits going. Whatever needs the tick back earlier - a second
+ * runnable task, the task blocking, a new timer, RCU - kicks the CPU,
+ * which charges the skipped ticks to the task and restores the period.
+ */
+static void tick_nohz_full_kick(void *info);
+
+static DEFINE_PER_CPU(struct call_single_data, tick_nohz_full_csd) = {
+	.func	= tick_nohz_full_kick,
+};
+
+/* CPU-time timers and RLIMIT_CPU are checked from the tick */
+static int tick_nohz_full_task_needs_tick(struct task_struct *p)
+{
+	return !cputime_eq(p->cputime_expires.prof_exp, cputime_zero) ||
+	       !cputime_eq(p->cputime_expires.virt_exp, cputime_zero) ||
+	       p->cputime_expires.sched_exp ||
+	       p->signal->cputimer.running;
+}
+
+static int tick_nohz_full_can_stretch(int cpu)
+{
+	if (cpu == tick_do_timer_cpu || !sched_can_stop_tick())
+		return 0;
+	if (tick_nohz_full_task_needs_tick(current))
+		return 0;
+	return !rcu_needs_tick(cpu) && !printk_needs_cpu(cpu) &&
+	       !arch_needs_cpu(cpu);
+}
+
+/*
+ * Charge @ticks skipped ticks to the current task, in the mode it was
+ * in when the tick was stretched.
+ */
+static void tick_nohz_full_account(struct tick_sched *ts, unsigned long ticks)
+{
+#ifndef CONFIG_VIRT_CPU_ACCOUNTING
+	cputime_t delta = jiffies_to_cputime(ticks);
+
+	if (ts->full_user)
+		account_user_time(current, delta, cputime_to_scaled(delta));
+	else
+		account_system_time(current, hardirq_count(), delta,
+				    cputime_to_scaled(delta));
+#endif
+	ts->full_ticks_suppressed += ticks;
+}
+
+/*
+ * Called from tick_sched_timer() before the tick is processed.
+ */
+static void tick_nohz_full_tick(struct tick_sched *ts)
+{
+	unsigned long ticks = jiffies - ts->full_jiffies;
+
+	if (ts->tick_stretched) {
+		ts->tick_stretched = 0;
+		/* this tick itself is accounted by update_process_times() */
+		if (ticks > 1 && ticks < LONG_MAX)
+			tick_nohz_full_account(ts, ticks - 1);
+	}
+	ts->full_jiffies = jiffies;
+}
+
+/*
+ * Called from tick_sched_timer() after the tick was forwarded to the
+ * next period: push it out if nothing needs it.
+ */
+static void tick_nohz_full_stretch(struct tick_sched *ts, int cpu, int user)
+{
+	unsigned long last_jiffies = ts->full_jiffies, next_jiffies, delta;
+
+	if (ts->nohz_mode != NOHZ_MODE_HIGHRES)
+		return;
+
+	/*
+	 * Publish the stretch before looking at the run queue and the
+	 * timer wheel: a task or a timer queued concurrently is either
+	 * seen below, or its queueing sees the stretch and kicks us.
+	 */
+	ts->full_next_jiffies = last_jiffies + HZ;
+	ts->tick_stretched = 1;
+	smp_mb();
+
+	if (!tick_nohz_full_can_stretch(cpu))
+		goto out;
+
+	next_jiffies = get_next_timer_interrupt(last_jiffies);
+	if (time_before_eq(next_jiffies, last_jiffies + 1))
+		goto out;
+	delta = min_t(unsigned long, next_jiffies - last_jiffies, HZ);
+
+	ts->full_next_jiffies = last_jiffies + delta;
+	ts->full_user = user;
+	ts->full_last_tick = ktime_sub(hrtimer_get_expires(&ts->sched_timer),
+				       tick_period);
+	hrtimer_add_expires_ns(&ts->sched_timer,
+			       (u64)(delta - 1) * tick_period.tv64);
+	ts->full_stretches++;
+	return;
+out:
+	ts->tick_stretched = 0;
+}
+
+/*
+ * Put the periodic tick of this CPU back. Interrupts are disabled, and
+ * the caller may hold rq->lock, so the timer softirq is not woken.
+ */
+static void tick_nohz_full_restart(struct tick_sched *ts)
+{
+	unsigned long ticks = jiffies - ts->full_jiffies;
+
+	ts->tick_stretched = 0;
+	ts->full_kicks++;
+	if (ticks && ticks < LONG_MAX)
+		tick_nohz_full_account(ts, ticks);
+	ts->full_jiffies = jiffies;
+
+	hrtimer_cancel(&ts->sched_timer);
+	hrtimer_set_expires(&ts->sched_timer, ts->full_last_tick);
+	hrtimer_forward(&ts->sched_timer, ktime_get(), tick_period);
+	__hrtimer_start_range_ns(&ts->sched_timer,
+				 hrtimer_get_expires(&ts->sched_timer), 0,
+				 HRTIMER_MODE_ABS_PINNED, 0);
+}
+
+static void tick_nohz_full_kick(void *info)
+{
+	struct tick_sched *ts = &__get_cpu_var(tick_cpu_sched);
+
+	clear_bit(0, &ts->full_kick);
+	if (ts->tick_stretched)
+		tick_nohz_full_restart(ts);
+}
+
+void __tick_nohz_full_kick_cpu(int cpu)
+{
+	struct tick_sched *ts = &per_cpu(tick_cpu_sched, cpu);
+	unsigned long flags;
+
+	/* Pairs with the barrier in tick_nohz_full_stretch() */
+	smp_mb();
+	if (!ts->tick_stretched)
+		return;
+
+	if (cpu == smp_processor_id()) {
+		local_irq_save(flags);
+		if (ts->tick_stretched)
+			tick_nohz_full_restart(ts);
+		local_irq_restore(flags);
+		return;
+	}
+
+	/* One kick in flight is enough */
+	if (test_and_set_bit(0, &ts->full_kick))
+		return;
+	__smp_call_function_single(cpu, &per_cpu(tick_nohz_full_csd, cpu), 0);
+}
+
+void __tick_nohz_full_kick_group(struct task_struct *p)
+{
+	struct task_struct *t = p;
+
+	do {
+		tick_nohz_full_kick_cpu(task_cpu(t));
+	} while_each_thread(p, t);
+}
+
+void __tick_nohz_full_check_timer(int cpu, unsigned long expires)
+{
+	struct tick_sched *ts = &per_cpu(tick_cpu_sched, cpu);
+
+	if (ts->tick_stretched && time_before(expires, ts->full_next_jiffies))
+		__tick_nohz_full_kick_cpu(cpu);
+}
+#else
+static inline void tick_nohz_full_tick(struct tick_sched *ts) { }
+static inline void
+tick_nohz_full_stretch(struct tick_sched *ts, int cpu, int user) { }
+#endif /* NO_HZ_FULL */
+
 /*
  * We rearm the timer until we get disabled by the idle code.
  * Called with interrupts disabled and timer->base->cpu_base->lock held.
@@ -756,12 +986,17 @@ static enum hrtimer_restart tick_sched_timer(struct hrtimer *timer)
 			touch_softlockup_watchdog();
 			ts->idle_jiffies++;
 		}
+		if (tick_nohz_full_cpu(cpu))
+			tick_nohz_full_tick(ts);
 		update_process_times(user_mode(regs));
 		profile_tick(CPU_PROFILING);
 	}
 
 	hrtimer_forward(timer, now, tick_period);
 
+	if (regs && tick_nohz_full_cpu(cpu))
+		tick_nohz_full_stretch(ts, cpu, user_mode(regs));
+
 	return HRTIMER_RESTART;
 }
 
@@ -810,6 +1045,9 @@ void tick_cancel_sched_timer(int cpu)
 	if (ts->sched_timer.base)
 		hrtimer_cancel(&ts->sched_timer);
 # endif
+# ifdef CONFIG_NO_HZ_FULL
+	ts->tick_stretched = 0;
+# endif
 
 	ts->nohz_mode = NOHZ_MODE_INACTIVE;
 }
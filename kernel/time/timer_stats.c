@@ -118,6 +118,13 @@ static struct entry entries[MAX_ENTRIES];
 
 static atomic_t overflow_count;
 
+/*
+ * Per-CPU event counters, to tell how often each CPU is woken up and
+ * how many timers it runs per wakeup:
+ */
+static DEFINE_PER_CPU(unsigned long [NR_TIMER_STATS_CPU_EVENTS],
+		      tstats_cpu_events);
+
 /*
  * The entries are in a hash-table, for fast lookup:
  */
@@ -137,10 +144,15 @@ static struct entry *tstat_hash_table[TSTAT_HASH_SIZE] __read_mostly;
 
 static void reset_entries(void)
 {
+	int cpu;
+
 	nr_entries = 0;
 	memset(entries, 0, sizeof(entries));
 	memset(tstat_hash_table, 0, sizeof(tstat_hash_table));
 	atomic_set(&overflow_count, 0);
+	for_each_possible_cpu(cpu)
+		memset(per_cpu(tstats_cpu_events, cpu), 0,
+		       sizeof(per_cpu(tstats_cpu_events, cpu)));
 }
 
 static struct entry *alloc_entry(void)
@@ -267,6 +279,11 @@ void timer_stats_update_stats(void *timer, pid_t pid, void *startf,
 	raw_spin_unlock_irqrestore(lock, flags);
 }
 
+void __timer_stats_cpu_event(enum timer_stats_cpu_event event)
+{
+	this_cpu_inc(tstats_cpu_events[event]);
+}
+
 static void print_name_offset(struct seq_file *m, unsigned long addr)
 {
 	char symname[KSYM_NAME_LEN];
@@ -298,7 +315,7 @@ static int tstats_show(struct seq_file *m, void *v)
 	period = ktime_to_timespec(time);
 	ms = period.tv_nsec / 1000000;
 
-	seq_puts(m, "Timer Stats Version: v0.2\n");
+	seq_puts(m, "Timer Stats Version: v0.3\n");
 	seq_printf(m, "Sample period: %ld.%03ld s\n", period.tv_sec, ms);
 	if (atomic_read(&overflow_count))
 		seq_printf(m, "Overflow: %d entries\n",
@@ -333,6 +350,18 @@ static int tstats_show(struct seq_file *m, void *v)
 	else
 		seq_printf(m, "%ld total events\n", events);
 
+	seq_printf(m, "CPU   wakeups    timers  hrtimers coalesced  migrated\n");
+	for_each_online_cpu(i) {
+		unsigned long *ev = per_cpu(tstats_cpu_events, i);
+
+		seq_printf(m, "%3d %9lu %9lu %9lu %9lu %9lu\n", i,
+			   ev[TIMER_STATS_CPU_WAKEUP],
+			   ev[TIMER_STATS_CPU_TIMER],
+			   ev[TIMER_STATS_CPU_HRTIMER],
+			   ev[TIMER_STATS_CPU_COALESCED],
+			   ev[TIMER_STATS_CPU_MIGRATED]);
+	}
+
 	mutex_unlock(&show_mutex);
 
 	return 0;
@@ -77,6 +77,7 @@ struct tvec_base {
 	struct timer_list *running_timer;
 	unsigned long timer_jiffies;
 	unsigned long next_timer;
+	int cpu;
 	struct tvec_root tv1;
 	struct tvec tv2;
 	struct tvec tv3;
@@ -387,6 +388,7 @@ static void timer_stats_account_timer(struct timer_list *timer)
 {
 	unsigned int flag = 0;
 
+	timer_stats_cpu_event(TIMER_STATS_CPU_TIMER);
 	if (likely(!timer->start_site))
 		return;
 	if (unlikely(tbase_get_deferrable(timer->base)))
@@ -653,9 +655,100 @@ static struct tvec_base *lock_timer_base(struct timer_list *timer,
 	}
 }
 
+/*
+ * Slack of a task's own sleeps in whole jiffies, rounded down so that
+ * only tasks which asked for a jiffy or more get their wakeups moved.
+ * Realtime tasks get none, as in hrtimer_nanosleep().
+ */
+static inline unsigned long task_slack_jiffies(void)
+{
+	if (rt_task(current))
+		return 0;
+	return nsecs_to_jiffies(current->timer_slack_ns);
+}
+
+/*
+ * Decide where to put the timer while taking the slack into account
+ *
+ * Algorithm:
+ *   1) take the maximum (absolute) time allowed by the slack
+ *   2) calculate the highest bit where the expires and new max are different
+ *   3) use this bit to make a mask
+ *   4) use the bitmask to round down the maximum time, so that all last
+ *      bits are zeros
+ */
+static inline
+unsigned long apply_slack(unsigned long expires, unsigned long expires_limit)
+{
+	unsigned long mask;
+	int bit;
+
+	mask = expires ^ expires_limit;
+	if (mask == 0)
+		return expires;
+
+	bit = find_last_bit(&mask, BITS_PER_LONG);
+
+	mask = (1 << bit) - 1;
+
+	expires_limit = expires_limit & ~(mask);
+
+	return expires_limit;
+}
+
+/*
+ * Does a non-deferrable timer on @base fire at @when?  base->next_timer
+ * is only a hint, it may still name a timer which has run or been
+ * requeued, so look for one in the tv1 slot.  Timers further out than
+ * tv1, or not cascaded into it yet, are missed; that only costs the
+ * chance to coalesce.
+ */
+static int wheel_fires_at(struct tvec_base *base, unsigned long when)
+{
+	struct timer_list *t;
+
+	if (time_before(when, base->timer_jiffies) ||
+	    when - base->timer_jiffies >= TVR_SIZE)
+		return 0;
+
+	list_for_each_entry(t, base->tv1.vec + (when & TVR_MASK), entry)
+		if (t->expires == when && !tbase_get_deferrable(t->base))
+			return 1;
+	return 0;
+}
+
+/*
+ * Pick the expiry of a timer going onto @base which may fire anywhere
+ * in [@expires, @expires_limit].  If the wheel of @base already fires
+ * within that window, fire together with it rather than adding another
+ * wakeup.  Otherwise round as apply_slack() does, which lines the timer
+ * up with those on other CPUs.  Deferrable timers only get rounded.
+ */
+static inline unsigned long
+coalesce_expiry(struct tvec_base *base, struct timer_list *timer,
+		unsigned long expires, unsigned long expires_limit)
+{
+	unsigned long next = base->next_timer;
+
+	if (expires == expires_limit)
+		return expires;
+
+	if (!tbase_get_deferrable(timer->base) &&
+	    time_in_range(next, expires, expires_limit) &&
+	    wheel_fires_at(base, next)) {
+		timer_stats_cpu_event(TIMER_STATS_CPU_COALESCED);
+		return next;
+	}
+	return apply_slack(expires, expires_limit);
+}
+
+/*
+ * Queue @timer to fire no earlier than @expires and, if the caller
+ * allows slack, no later than @expires_limit.
+ */
 static inline int
 __mod_timer(struct timer_list *timer, unsigned long expires,
-						bool pending_only, int pinned)
+	    unsigned long expires_limit, bool pending_only, int pinned)
 {
 	struct tvec_base *base, *new_base;
 	unsigned long flags;
@@ -682,8 +775,11 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 	cpu = smp_processor_id();
 
 #if defined(CONFIG_NO_HZ) && defined(CONFIG_SMP)
-	if (!pinned && get_sysctl_timer_migration() && idle_cpu(cpu))
+	if (!pinned && get_sysctl_timer_migration() && idle_cpu(cpu)) {
 		cpu = get_nohz_timer_target();
+		if (cpu != smp_processor_id())
+			timer_stats_cpu_event(TIMER_STATS_CPU_MIGRATED);
+	}
 #endif
 	new_base = per_cpu(tvec_bases, cpu);
 
@@ -705,10 +801,13 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 		}
 	}
 
-	timer->expires = expires;
-	if (time_before(timer->expires, base->next_timer) &&
-	    !tbase_get_deferrable(timer->base))
-		base->next_timer = timer->expires;
+	timer->expires = coalesce_expiry(base, timer, expires, expires_limit);
+	if (!tbase_get_deferrable(timer->base)) {
+		if (time_before(timer->expires, base->next_timer))
+			base->next_timer = timer->expires;
+		/* A running timer stays on its old base, see above */
+		tick_nohz_full_check_timer(base->cpu, timer->expires);
+	}
 	internal_add_timer(base, timer);
 
 out_unlock:
@@ -729,27 +828,18 @@ out_unlock:
  */
 int mod_timer_pending(struct timer_list *timer, unsigned long expires)
 {
-	return __mod_timer(timer, expires, true, TIMER_NOT_PINNED);
+	return __mod_timer(timer, expires, expires, true, TIMER_NOT_PINNED);
 }
 EXPORT_SYMBOL(mod_timer_pending);
 
 /*
- * Decide where to put the timer while taking the slack into account
- *
- * Algorithm:
- *   1) calculate the maximum (absolute) time
- *   2) calculate the highest bit where the expires and new max are different
- *   3) use this bit to make a mask
- *   4) use the bitmask to round down the maximum time, so that all last
- *      bits are zeros
+ * Return the latest time the slack of @timer allows it to fire at,
+ * when asked to fire at @expires.
  */
 static inline
-unsigned long apply_slack(struct timer_list *timer, unsigned long expires)
+unsigned long slack_limit(struct timer_list *timer, unsigned long expires)
 {
-	unsigned long expires_limit, mask;
-	int bit;
-
-	expires_limit = expires;
+	unsigned long expires_limit = expires;
 
 	if (timer->slack >= 0) {
 		expires_limit = expires + timer->slack;
@@ -760,16 +850,6 @@ unsigned long apply_slack(struct timer_list *timer, unsigned long expires)
 		if (time_after(expires, now))
 			expires_limit = expires + (expires - now)/256;
 	}
-	mask = expires ^ expires_limit;
-	if (mask == 0)
-		return expires;
-
-	bit = find_last_bit(&mask, BITS_PER_LONG);
-
-	mask = (1 << bit) - 1;
-
-	expires_limit = expires_limit & ~(mask);
-
 	return expires_limit;
 }
 
@@ -803,9 +883,8 @@ int mod_timer(struct timer_list *timer, unsigned long expires)
 	if (timer_pending(timer) && timer->expires == expires)
 		return 1;
 
-	expires = apply_slack(timer, expires);
-
-	return __mod_timer(timer, expires, false, TIMER_NOT_PINNED);
+	return __mod_timer(timer, expires, slack_limit(timer, expires), false,
+			   TIMER_NOT_PINNED);
 }
 EXPORT_SYMBOL(mod_timer);
 
@@ -827,7 +906,7 @@ int mod_timer_pinned(struct timer_list *timer, unsigned long expires)
 	if (timer->expires == expires && timer_pending(timer))
 		return 1;
 
-	return __mod_timer(timer, expires, false, TIMER_PINNED);
+	return __mod_timer(timer, expires, expires, false, TIMER_PINNED);
 }
 EXPORT_SYMBOL(mod_timer_pinned);
 
@@ -882,6 +961,8 @@ void add_timer_on(struct timer_list *timer, int cpu)
 	 * the timer wheel.
 	 */
 	wake_up_idle_cpu(cpu);
+	if (!tbase_get_deferrable(timer->base))
+		tick_nohz_full_check_timer(cpu, timer->expires);
 	spin_unlock_irqrestore(&base->lock, flags);
 }
 EXPORT_SYMBOL_GPL(add_timer_on);
@@ -1468,8 +1549,14 @@ signed long __sched schedule_timeout(signed long timeout)
 
 	expire = timeout + jiffies;
 
+	/*
+	 * The task's timer slack, which its hrtimer sleeps get, lets the
+	 * wakeup share an expiry with other timers on this CPU.  Moving
+	 * the timer to another CPU would not spare this one the wakeup.
+	 */
 	setup_timer_on_stack(&timer, process_timeout, (unsigned long)current);
-	__mod_timer(&timer, expire, false, TIMER_NOT_PINNED);
+	__mod_timer(&timer, expire, expire + task_slack_jiffies(), false,
+		    TIMER_PINNED);
 	schedule();
 	del_singleshot_timer_sync(&timer);
 
@@ -1647,6 +1734,7 @@ static int __cpuinit init_timers_cpu(int cpu)
 
 	base->timer_jiffies = jiffies;
 	base->next_timer = base->timer_jiffies;
+	base->cpu = cpu;
 	return 0;
 }
 
@@ -41,6 +41,8 @@
 #include <linux/debug_locks.h>
 #include <linux/lockdep.h>
 #include <linux/idr.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "workqueue_sched.h"
 
@@ -116,6 +118,30 @@ enum {
 
 struct global_cwq;
 
+#ifdef CONFIG_WQ_STATS
+/* queue-to-start latency buckets: < 16us, < 64us, ... < 256ms, longer */
+#define WQ_LAT_BUCKETS		9
+#define WQ_LAT_MIN_NS		(16 * NSEC_PER_USEC)
+
+/* works running longer than this hold up others on a bound gcwq */
+#define WQ_LONG_WORK_NS		(10 * NSEC_PER_MSEC)
+
+struct cwq_stats {
+	u64			nr_queued;
+	u64			nr_delayed;	/* queued over max_active */
+	u64			nr_executed;
+	u64			nr_cpu_intensive; /* run unmanaged */
+	u64			nr_long;	/* ran over WQ_LONG_WORK_NS */
+	u64			nr_mayday;	/* rescue requested */
+	u64			nr_rescued;	/* executed by the rescuer */
+	u64			lat_sum;	/* ns from queueing to start */
+	u64			lat_max;
+	u64			exec_sum;	/* ns of execution */
+	u64			exec_max;
+	unsigned long		lat_hist[WQ_LAT_BUCKETS];
+};
+#endif
+
 /*
  * The poor guys doing the actual heavy lifting.  All on-duty workers
  * are either serving the manager role, on idle list or on busy hash.
@@ -167,6 +193,12 @@ struct global_cwq {
 	unsigned int		trustee_state;	/* L: trustee state */
 	wait_queue_head_t	trustee_wait;	/* trustee wait */
 	struct worker		*first_idle;	/* L: first idle worker */
+
+#ifdef CONFIG_WQ_STATS
+	unsigned long		nr_created;	/* L: workers started */
+	unsigned long		nr_destroyed;	/* L: idle workers stopped */
+	unsigned long		nr_mayday_timeouts; /* L: rescues called */
+#endif
 } ____cacheline_aligned_in_smp;
 
 /*
@@ -184,6 +216,9 @@ struct cpu_workqueue_struct {
 	int			nr_active;	/* L: nr of active works */
 	int			max_active;	/* L: max active works */
 	struct list_head	delayed_works;	/* L: delayed works */
+#ifdef CONFIG_WQ_STATS
+	struct cwq_stats	stats;		/* L: statistics */
+#endif
 };
 
 /*
@@ -978,6 +1013,80 @@ static bool is_chained_work(struct workqueue_struct *wq)
 	return false;
 }
 
+#ifdef CONFIG_WQ_STATS
+static void wq_barrier_func(struct work_struct *work);
+
+/*
+ * Account @work being queued on @cwq.  @delayed is set if it went on
+ * the delayed list because @cwq already has max_active works active.
+ *
+ * CONTEXT:
+ * spin_lock_irq(gcwq->lock).
+ */
+static void wq_stats_queued(struct cpu_workqueue_struct *cwq,
+			    struct work_struct *work, bool delayed)
+{
+	work->queued = local_clock();
+	cwq->stats.nr_queued++;
+	if (delayed)
+		cwq->stats.nr_delayed++;
+}
+
+static int wq_lat_bucket(u64 lat)
+{
+	u64 limit = WQ_LAT_MIN_NS;
+	int i;
+
+	for (i = 0; i < WQ_LAT_BUCKETS - 1; i++, limit <<= 2)
+		if (lat < limit)
+			break;
+	return i;
+}
+
+/*
+ * Account a work executed by @worker for @cwq, queued at @queued and
+ * run from @start to @end.  @work may already be freed and is only
+ * reported by address.  Flush barriers are inserted directly by
+ * insert_wq_barrier(), never went through wq_stats_queued() and carry
+ * no queueing time, so they aren't accounted.
+ *
+ * CONTEXT:
+ * spin_lock_irq(gcwq->lock).
+ */
+static void wq_stats_executed(struct worker *worker,
+			      struct cpu_workqueue_struct *cwq,
+			      struct work_struct *work, work_func_t f,
+			      u64 queued, u64 start, u64 end)
+{
+	struct cwq_stats *stats = &cwq->stats;
+	/* local_clock() isn't synchronized across cpus, clamp at zero */
+	u64 lat = start > queued ? start - queued : 0;
+	u64 exec = end > start ? end - start : 0;
+
+	if (f == wq_barrier_func)
+		return;
+
+	stats->nr_executed++;
+	if (worker->flags & WORKER_CPU_INTENSIVE)
+		stats->nr_cpu_intensive++;
+	if (worker == cwq->wq->rescuer)
+		stats->nr_rescued++;
+	if (exec >= WQ_LONG_WORK_NS)
+		stats->nr_long++;
+
+	stats->lat_sum += lat;
+	stats->lat_max = max(stats->lat_max, lat);
+	stats->exec_sum += exec;
+	stats->exec_max = max(stats->exec_max, exec);
+	stats->lat_hist[wq_lat_bucket(lat)]++;
+
+	trace_workqueue_work_done(work, f, cwq->wq->name, lat, exec);
+}
+#else
+static inline void wq_stats_queued(struct cpu_workqueue_struct *cwq,
+				   struct work_struct *work, bool delayed) { }
+#endif
+
 static void __queue_work(unsigned int cpu, struct workqueue_struct *wq,
 			 struct work_struct *work)
 {
@@ -1048,6 +1157,7 @@ static void __queue_work(unsigned int cpu, struct workqueue_struct *wq,
 		worklist = &cwq->delayed_works;
 	}
 
+	wq_stats_queued(cwq, work, work_flags & WORK_STRUCT_DELAYED);
 	insert_work(cwq, work, worklist, work_flags);
 
 	spin_unlock_irqrestore(&gcwq->lock, flags);
@@ -1419,6 +1529,10 @@ static void start_worker(struct worker *worker)
 {
 	worker->flags |= WORKER_STARTED;
 	worker->gcwq->nr_workers++;
+#ifdef CONFIG_WQ_STATS
+	worker->gcwq->nr_created++;
+#endif
+	trace_workqueue_worker_create(worker->gcwq->cpu, worker->id);
 	worker_enter_idle(worker);
 	wake_up_process(worker->task);
 }
@@ -1445,6 +1559,10 @@ static void destroy_worker(struct worker *worker)
 		gcwq->nr_workers--;
 	if (worker->flags & WORKER_IDLE)
 		gcwq->nr_idle--;
+#ifdef CONFIG_WQ_STATS
+	gcwq->nr_destroyed++;
+#endif
+	trace_workqueue_worker_destroy(gcwq->cpu, id);
 
 	list_del_init(&worker->entry);
 	worker->flags |= WORKER_DIE;
@@ -1498,8 +1616,13 @@ static bool send_mayday(struct work_struct *work)
 	/* WORK_CPU_UNBOUND can't be set in cpumask, use cpu 0 instead */
 	if (cpu == WORK_CPU_UNBOUND)
 		cpu = 0;
-	if (!mayday_test_and_set_cpu(cpu, wq->mayday_mask))
+	if (!mayday_test_and_set_cpu(cpu, wq->mayday_mask)) {
+#ifdef CONFIG_WQ_STATS
+		cwq->stats.nr_mayday++;
+#endif
+		trace_workqueue_mayday(wq->name, cwq->gcwq->cpu, work);
 		wake_up_process(wq->rescuer->task);
+	}
 	return true;
 }
 
@@ -1517,6 +1640,9 @@ static void gcwq_mayday_timeout(unsigned long __gcwq)
 		 * allocation deadlock.  Send distress signals to
 		 * rescuers.
 		 */
+#ifdef CONFIG_WQ_STATS
+		gcwq->nr_mayday_timeouts++;
+#endif
 		list_for_each_entry(work, &gcwq->worklist, entry)
 			send_mayday(work);
 	}
@@ -1804,6 +1930,9 @@ __acquires(&gcwq->lock)
 	work_func_t f = work->func;
 	int work_color;
 	struct worker *collision;
+#ifdef CONFIG_WQ_STATS
+	u64 queued = work->queued, start, end;
+#endif
 #ifdef CONFIG_LOCKDEP
 	/*
 	 * It is permissible to free the struct work_struct from
@@ -1865,7 +1994,13 @@ __acquires(&gcwq->lock)
 	lock_map_acquire_read(&cwq->wq->lockdep_map);
 	lock_map_acquire(&lockdep_map);
 	trace_workqueue_execute_start(work);
+#ifdef CONFIG_WQ_STATS
+	start = local_clock();
+#endif
 	f(work);
+#ifdef CONFIG_WQ_STATS
+	end = local_clock();
+#endif
 	/*
 	 * While we must be careful to not use "work" after this, the trace
 	 * point will only record its address.
@@ -1886,6 +2021,10 @@ __acquires(&gcwq->lock)
 
 	spin_lock_irq(&gcwq->lock);
 
+#ifdef CONFIG_WQ_STATS
+	wq_stats_executed(worker, cwq, work, f, queued, start, end);
+#endif
+
 	/* clear cpu intensive status */
 	if (unlikely(cpu_intensive))
 		worker_clr_flags(worker, WORKER_CPU_INTENSIVE);
@@ -3739,6 +3878,166 @@ out_unlock:
 }
 #endif /* CONFIG_FREEZER */
 
+#ifdef CONFIG_WQ_STATS
+/*
+ * debugfs interface.  workqueue/stats and workqueue/latency show the
+ * statistics of each workqueue summed over its cwqs, workqueue/pools the
+ * worker pool of each gcwq.
+ */
+static void wq_sum_stats(struct workqueue_struct *wq, struct cwq_stats *sum)
+{
+	unsigned int cpu;
+	int i;
+
+	memset(sum, 0, sizeof(*sum));
+
+	for_each_cwq_cpu(cpu, wq) {
+		struct cpu_workqueue_struct *cwq = get_cwq(cpu, wq);
+		struct cwq_stats *stats = &cwq->stats;
+
+		spin_lock_irq(&cwq->gcwq->lock);
+		sum->nr_queued += stats->nr_queued;
+		sum->nr_delayed += stats->nr_delayed;
+		sum->nr_executed += stats->nr_executed;
+		sum->nr_cpu_intensive += stats->nr_cpu_intensive;
+		sum->nr_long += stats->nr_long;
+		sum->nr_mayday += stats->nr_mayday;
+		sum->nr_rescued += stats->nr_rescued;
+		sum->lat_sum += stats->lat_sum;
+		sum->lat_max = max(sum->lat_max, stats->lat_max);
+		sum->exec_sum += stats->exec_sum;
+		sum->exec_max = max(sum->exec_max, stats->exec_max);
+		for (i = 0; i < WQ_LAT_BUCKETS; i++)
+			sum->lat_hist[i] += stats->lat_hist[i];
+		spin_unlock_irq(&cwq->gcwq->lock);
+	}
+}
+
+static unsigned long long wq_avg_us(u64 sum, u64 nr)
+{
+	return nr ? div64_u64(sum, nr) / NSEC_PER_USEC : 0;
+}
+
+static int wq_stats_show(struct seq_file *m, void *v)
+{
+	struct workqueue_struct *wq;
+	struct cwq_stats sum;
+
+	seq_printf(m, "%-24s %10s %10s %10s %8s %8s %8s %8s "
+		   "%9s %9s %9s %9s\n", "# workqueue", "queued", "delayed",
+		   "executed", "cpuint", "long", "mayday", "rescued",
+		   "lat_avg", "lat_max", "exec_avg", "exec_max");
+
+	spin_lock(&workqueue_lock);
+	list_for_each_entry(wq, &workqueues, list) {
+		wq_sum_stats(wq, &sum);
+		seq_printf(m, "%-24s %10llu %10llu %10llu %8llu %8llu %8llu "
+			   "%8llu %9llu %9llu %9llu %9llu\n", wq->name,
+			   (unsigned long long)sum.nr_queued,
+			   (unsigned long long)sum.nr_delayed,
+			   (unsigned long long)sum.nr_executed,
+			   (unsigned long long)sum.nr_cpu_intensive,
+			   (unsigned long long)sum.nr_long,
+			   (unsigned long long)sum.nr_mayday,
+			   (unsigned long long)sum.nr_rescued,
+			   wq_avg_us(sum.lat_sum, sum.nr_executed),
+			   (unsigned long long)sum.lat_max / NSEC_PER_USEC,
+			   wq_avg_us(sum.exec_sum, sum.nr_executed),
+			   (unsigned long long)sum.exec_max / NSEC_PER_USEC);
+	}
+	spin_unlock(&workqueue_lock);
+
+	seq_printf(m, "# lat and exec in usecs, long: ran over %llu msecs\n",
+		   (unsigned long long)WQ_LONG_WORK_NS / NSEC_PER_MSEC);
+	return 0;
+}
+
+static int wq_latency_show(struct seq_file *m, void *v)
+{
+	static const char * const bucket[WQ_LAT_BUCKETS] = {
+		"<16us", "<64us", "<256us", "<1ms", "<4ms",
+		"<16ms", "<64ms", "<256ms", ">=256ms",
+	};
+	struct workqueue_struct *wq;
+	struct cwq_stats sum;
+	int i;
+
+	seq_printf(m, "%-24s", "# workqueue");
+	for (i = 0; i < WQ_LAT_BUCKETS; i++)
+		seq_printf(m, " %9s", bucket[i]);
+	seq_putc(m, '\n');
+
+	spin_lock(&workqueue_lock);
+	list_for_each_entry(wq, &workqueues, list) {
+		wq_sum_stats(wq, &sum);
+		seq_printf(m, "%-24s", wq->name);
+		for (i = 0; i < WQ_LAT_BUCKETS; i++)
+			seq_printf(m, " %9lu", sum.lat_hist[i]);
+		seq_putc(m, '\n');
+	}
+	spin_unlock(&workqueue_lock);
+	return 0;
+}
+
+static int wq_pools_show(struct seq_file *m, void *v)
+{
+	unsigned int cpu;
+
+	seq_printf(m, "%-8s %8s %8s %8s %10s %10s %10s\n", "# pool",
+		   "workers", "idle", "running", "created", "destroyed",
+		   "mayday");
+
+	for_each_gcwq_cpu(cpu) {
+		struct global_cwq *gcwq = get_gcwq(cpu);
+		char name[16];
+
+		if (cpu == WORK_CPU_UNBOUND)
+			strcpy(name, "unbound");
+		else
+			snprintf(name, sizeof(name), "cpu%u", cpu);
+
+		spin_lock_irq(&gcwq->lock);
+		seq_printf(m, "%-8s %8d %8d %8d %10lu %10lu %10lu\n", name,
+			   gcwq->nr_workers, gcwq->nr_idle,
+			   atomic_read(get_gcwq_nr_running(cpu)),
+			   gcwq->nr_created, gcwq->nr_destroyed,
+			   gcwq->nr_mayday_timeouts);
+		spin_unlock_irq(&gcwq->lock);
+	}
+	return 0;
+}
+
+static int wq_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, inode->i_private, NULL);
+}
+
+static const struct file_operations wq_stats_fops = {
+	.open		= wq_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init wq_stats_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("workqueue", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	debugfs_create_file("stats", 0444, dir, wq_stats_show,
+			    &wq_stats_fops);
+	debugfs_create_file("latency", 0444, dir, wq_latency_show,
+			    &wq_stats_fops);
+	debugfs_create_file("pools", 0444, dir, wq_pools_show,
+			    &wq_stats_fops);
+	return 0;
+}
+late_initcall(wq_stats_init);
+#endif	/* CONFIG_WQ_STATS */
+
 static int __init init_workqueues(void)
 {
 	unsigned int cpu;
@@ -14,6 +14,8 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 #include "internal.h"
 
 #define CREATE_TRACE_POINTS
@@ -34,6 +36,9 @@ struct compact_control {
 	unsigned long free_pfn;		/* isolate_freepages search base */
 	unsigned long migrate_pfn;	/* isolate_migratepages search base */
 	bool sync;			/* Synchronous migration */
+	bool kcompactd;			/* Background compaction by kcompactd */
+	unsigned long deadline;		/* kcompactd: jiffies to stop at */
+	unsigned long nr_migrated;	/* Number of pages migrated */
 
 	/* Account for isolated anon and file pages */
 	unsigned long nr_anon;
@@ -442,6 +447,10 @@ static int compact_finished(struct zone *zone,
 	if (cc->free_pfn <= cc->migrate_pfn)
 		return COMPACT_COMPLETE;
 
+	/* Background compaction is out of time, it resumes from here */
+	if (cc->kcompactd && time_after_eq(jiffies, cc->deadline))
+		return COMPACT_PARTIAL;
+
 	/* Compaction run is not finished if the watermark is not met */
 	watermark = low_wmark_pages(zone);
 	watermark += (1 << cc->order);
@@ -538,6 +547,14 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 	cc->free_pfn = cc->migrate_pfn + zone->spanned_pages;
 	cc->free_pfn &= ~(pageblock_nr_pages-1);
 
+	/* kcompactd picks up where its last pass ran out of time */
+	if (cc->kcompactd && zone->kcompactd_migrate_pfn &&
+	    zone->kcompactd_migrate_pfn >= cc->migrate_pfn &&
+	    zone->kcompactd_free_pfn <= cc->free_pfn) {
+		cc->migrate_pfn = zone->kcompactd_migrate_pfn;
+		cc->free_pfn = zone->kcompactd_free_pfn;
+	}
+
 	migrate_prep_local();
 
 	while ((ret = compact_finished(zone, cc)) == COMPACT_CONTINUE) {
@@ -561,6 +578,7 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 		update_nr_listpages(cc);
 		nr_remaining = cc->nr_migratepages;
 
+		cc->nr_migrated += nr_migrate - nr_remaining;
 		count_vm_event(COMPACTBLOCKS);
 		count_vm_events(COMPACTPAGES, nr_migrate - nr_remaining);
 		if (nr_remaining)
@@ -581,6 +599,16 @@ out:
 	cc->nr_freepages -= release_freepages(&cc->freepages);
 	VM_BUG_ON(cc->nr_freepages != 0);
 
+	if (cc->kcompactd) {
+		if (ret == COMPACT_COMPLETE) {
+			zone->kcompactd_migrate_pfn = 0;
+			zone->kcompactd_free_pfn = 0;
+		} else {
+			zone->kcompactd_migrate_pfn = cc->migrate_pfn;
+			zone->kcompactd_free_pfn = cc->free_pfn;
+		}
+	}
+
 	return ret;
 }
 
@@ -722,6 +750,192 @@ int sysctl_extfrag_handler(struct ctl_table *table, int write,
 	return 0;
 }
 
+/*
+ * Background compaction
+ *
+ * Every node has a kcompactd thread that sleeps until an allocation wakes
+ * kswapd for a high order. It then checks the fragmentation index of its
+ * zones for sysctl_kcompactd_order. A zone whose index is above
+ * sysctl_kcompactd_threshold is compacted until a free block of that order
+ * exists, using asynchronous migration only so that kcompactd never waits
+ * on page locks or writeback.
+ *
+ * kcompactd gets sysctl_kcompactd_budget_ms of every
+ * sysctl_kcompactd_interval_ms. A pass that runs out of time stops, and
+ * resumes from the same scanner positions in the next interval without
+ * waiting for another wakeup, so a large zone is compacted a slice at a
+ * time. Otherwise kcompactd does not wake up by itself. A full pass that
+ * leaves the zone fragmented makes kcompactd skip the zone for twice as
+ * many checks as the last time, up to 64.
+ */
+int sysctl_kcompactd_order = PAGE_ALLOC_COSTLY_ORDER + 1;
+int sysctl_kcompactd_threshold = 500;
+int sysctl_kcompactd_interval_ms = 500;
+int sysctl_kcompactd_budget_ms = 50;
+
+#define KCOMPACTD_MAX_BACKOFF	64
+
+static bool kcompactd_zone_fragmented(struct zone *zone, int order)
+{
+	return fragmentation_index(zone, order) > sysctl_kcompactd_threshold;
+}
+
+static void kcompactd_compact_zone(struct zone *zone, int order,
+				   unsigned long deadline)
+{
+	struct compact_control cc = {
+		.nr_freepages = 0,
+		.nr_migratepages = 0,
+		.order = order,
+		.migratetype = MIGRATE_MOVABLE,
+		.zone = zone,
+		.sync = false,
+		.kcompactd = true,
+		.deadline = deadline,
+	};
+	int ret;
+
+	INIT_LIST_HEAD(&cc.freepages);
+	INIT_LIST_HEAD(&cc.migratepages);
+
+	ret = compact_zone(zone, &cc);
+	count_vm_events(KCOMPACTD_PAGES, cc.nr_migrated);
+
+	VM_BUG_ON(!list_empty(&cc.freepages));
+	VM_BUG_ON(!list_empty(&cc.migratepages));
+
+	if (!kcompactd_zone_fragmented(zone, order)) {
+		count_vm_event(KCOMPACTD_SUCCESS);
+		zone->kcompactd_backoff = 0;
+	} else if (ret == COMPACT_COMPLETE) {
+		count_vm_event(KCOMPACTD_FAIL);
+		zone->kcompactd_backoff = min_t(unsigned int,
+					zone->kcompactd_backoff * 2 ? : 1,
+					KCOMPACTD_MAX_BACKOFF);
+		zone->kcompactd_skip = zone->kcompactd_backoff;
+	} else if (time_after_eq(jiffies, deadline))
+		count_vm_event(KCOMPACTD_BUDGET);
+}
+
+static void kcompactd_do_work(pg_data_t *pgdat, unsigned long deadline)
+{
+	int order = sysctl_kcompactd_order;
+	int zoneid;
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+
+		if (!populated_zone(zone))
+			continue;
+		if (kthread_should_stop() || time_after_eq(jiffies, deadline))
+			break;
+
+		if (zone->kcompactd_skip) {
+			zone->kcompactd_skip--;
+			continue;
+		}
+		if (!kcompactd_zone_fragmented(zone, order)) {
+			/* done without us, start afresh next time */
+			zone->kcompactd_migrate_pfn = 0;
+			zone->kcompactd_free_pfn = 0;
+			continue;
+		}
+
+		count_vm_event(KCOMPACTD_WAKE);
+		kcompactd_compact_zone(zone, order, deadline);
+	}
+}
+
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+	unsigned long period = jiffies, used = 0;
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		unsigned long interval, budget, start;
+		long timeout;
+
+		interval = msecs_to_jiffies(sysctl_kcompactd_interval_ms);
+		budget = msecs_to_jiffies(sysctl_kcompactd_budget_ms);
+
+		/*
+		 * With the budget spent, a pass was cut short: resume it in
+		 * the next period. Otherwise only an allocation wakes us.
+		 */
+		if (budget && used >= budget) {
+			timeout = max_t(long, period + interval - jiffies, 1);
+			wait_event_freezable_timeout(pgdat->kcompactd_wait,
+				pgdat->kcompactd_wake || kthread_should_stop(),
+				timeout);
+		} else {
+			wait_event_freezable(pgdat->kcompactd_wait,
+				pgdat->kcompactd_wake || kthread_should_stop());
+		}
+		pgdat->kcompactd_wake = false;
+		if (kthread_should_stop())
+			break;
+
+		if (time_after_eq(jiffies, period + interval)) {
+			period = jiffies;
+			used = 0;
+		}
+		if (used >= budget)
+			continue;
+
+		start = jiffies;
+		kcompactd_do_work(pgdat, start + budget - used);
+		used += jiffies - start;
+	}
+
+	return 0;
+}
+
+/*
+ * A high-order allocation found a zone below its watermark: let kcompactd
+ * check the node now instead of at the end of the interval.
+ */
+void wakeup_kcompactd(struct zone *zone, int order)
+{
+	pg_data_t *pgdat = zone->zone_pgdat;
+
+	if (!order || !pgdat->kcompactd || pgdat->kcompactd_wake)
+		return;
+	if (!waitqueue_active(&pgdat->kcompactd_wait))
+		return;
+
+	pgdat->kcompactd_wake = true;
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+/* Started and stopped along with kswapd */
+void kcompactd_run(pg_data_t *pgdat)
+{
+	struct task_struct *tsk;
+
+	if (pgdat->kcompactd)
+		return;
+
+	tsk = kthread_run(kcompactd, pgdat, "kcompactd%d", pgdat->node_id);
+	if (IS_ERR(tsk))
+		printk(KERN_WARNING "Failed to start kcompactd on node %d\n",
+		       pgdat->node_id);
+	else
+		pgdat->kcompactd = tsk;
+}
+
+void kcompactd_stop(pg_data_t *pgdat)
+{
+	if (pgdat->kcompactd) {
+		kthread_stop(pgdat->kcompactd);
+		pgdat->kcompactd = NULL;
+	}
+}
+
 #if defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
 ssize_t sysfs_compact_node(struct sys_device *dev,
 			struct sysdev_attribute *attr,
@@ -503,10 +503,13 @@ int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 
 	ret = add_to_page_cache(page, mapping, offset, gfp_mask);
 	if (ret == 0) {
-		if (page_is_file_cache(page))
-			lru_cache_add_file(page);
-		else
+		if (!page_is_file_cache(page))
 			lru_cache_add_anon(page);
+		else if (workingset_refault(mapping, offset)) {
+			workingset_activation(page);
+			lru_cache_add_lru(page, LRU_ACTIVE_FILE);
+		} else
+			lru_cache_add_file(page);
 	}
 	return ret;
 }
@@ -1554,6 +1557,8 @@ static void do_sync_mmap_readahead(struct vm_area_struct *vma,
 		ra->start = max_t(long, 0, offset - ra_pages/2);
 		ra->size = ra_pages;
 		ra->async_size = 0;
+		/* there is no telling which of these pages get used */
+		ra->used = ra->start + ra->size;
 		ra_submit(ra, mapping, file);
 	}
 }
@@ -23,12 +23,11 @@
 #include <linux/pagemap.h>
 #include <linux/rmap.h>
 #include <linux/spinlock.h>
-#include <linux/jhash.h>
 #include <linux/delay.h>
 #include <linux/kthread.h>
 #include <linux/wait.h>
 #include <linux/slab.h>
-#include <linux/rbtree.h>
+#include <linux/vmalloc.h>
 #include <linux/memory.h>
 #include <linux/mmu_notifier.h>
 #include <linux/swap.h>
@@ -68,11 +67,12 @@
  *    memory areas, and then the tree is rebuilt again from the beginning.
  * 2) KSM will only insert into the unstable tree, pages whose hash value
  *    has not changed since the previous scan of all memory areas.
- * 3) The unstable tree is a RedBlack Tree - so its balancing is based on the
- *    colors of the nodes and not on their contents, assuring that even when
- *    the tree gets "corrupted" it won't get out of balance, so scanning time
- *    remains the same (also, searching and inserting nodes in an rbtree uses
- *    the same algorithm, so we have no overhead when we flush and rebuild).
+ * 3) Neither tree is sorted by comparing whole pages: both are hash tables
+ *    keyed by a checksum of the page contents, so that a lookup costs one
+ *    checksum and a full compare only against pages with the same checksum,
+ *    however many pages are mergeable.  A page of the unstable tree that is
+ *    modified just stops matching, it cannot corrupt the lookup of others,
+ *    and flushing the unstable tree is a matter of emptying its buckets.
  * 4) KSM never flushes the stable tree, which means that even if it were to
  *    take 10 attempts to find a page in the unstable tree, once it is found,
  *    it is secured in the stable tree.  (When we scan a new page, we first
@@ -110,15 +110,17 @@ struct ksm_scan {
 };
 
 /**
- * struct stable_node - node of the stable rbtree
- * @node: rb node of this ksm page in the stable tree
+ * struct stable_node - node of the stable tree
+ * @node: link of this ksm page in its stable tree hash chain
  * @hlist: hlist head of rmap_items using this ksm page
  * @kpfn: page frame number of this ksm page
+ * @checksum: checksum of the contents of this ksm page
  */
 struct stable_node {
-	struct rb_node node;
+	struct hlist_node node;
 	struct hlist_head hlist;
 	unsigned long kpfn;
+	u32 checksum;
 };
 
 /**
@@ -128,7 +130,7 @@ struct stable_node {
  * @mm: the memory structure this rmap_item is pointing into
  * @address: the virtual address this rmap_item tracks (+ flags in low bits)
  * @oldchecksum: previous checksum of the page at that virtual address
- * @node: rb node of this rmap_item in the unstable tree
+ * @node: link of this rmap_item in its unstable tree hash chain
  * @head: pointer to stable_node heading this list in the stable tree
  * @hlist: link into hlist of rmap_items hanging off that stable_node
  */
@@ -139,7 +141,7 @@ struct rmap_item {
 	unsigned long address;		/* + low bits used for flags below */
 	unsigned int oldchecksum;	/* when unstable */
 	union {
-		struct rb_node node;	/* when node of unstable tree */
+		struct hlist_node node;	/* when node of unstable tree */
 		struct {		/* when listed from stable tree */
 			struct stable_node *head;
 			struct hlist_node hlist;
@@ -151,9 +153,47 @@ struct rmap_item {
 #define UNSTABLE_FLAG	0x100	/* is a node of the unstable tree */
 #define STABLE_FLAG	0x200	/* is listed from the stable tree */
 
-/* The stable and unstable tree heads */
-static struct rb_root root_stable_tree = RB_ROOT;
-static struct rb_root root_unstable_tree = RB_ROOT;
+/*
+ * The stable and unstable tree hash tables, both 1 << ksm_hash_shift long:
+ * allocated by ksm_alloc_hash() when ksmd is first set running.
+ */
+static struct hlist_head *stable_tree_hash;
+static struct hlist_head *unstable_tree_hash;
+static unsigned int ksm_hash_shift;
+
+static inline struct hlist_head *ksm_hash_head(struct hlist_head *table,
+					       u32 checksum)
+{
+	return &table[checksum & ((1U << ksm_hash_shift) - 1)];
+}
+
+/*
+ * Most systems never run ksmd, so the trees are only sized when it is
+ * first asked to merge: one bucket for every 32 pages of memory in each.
+ * Called with ksm_thread_mutex held, which ksmd holds while scanning.
+ */
+static int ksm_alloc_hash(void)
+{
+	unsigned int shift;
+	unsigned long size;
+
+	if (stable_tree_hash)
+		return 0;
+
+	shift = ilog2(roundup_pow_of_two(max(totalram_pages >> 5, 1UL)));
+	size = sizeof(struct hlist_head) << shift;
+
+	stable_tree_hash = vzalloc(size);
+	unstable_tree_hash = vzalloc(size);
+	if (!stable_tree_hash || !unstable_tree_hash) {
+		vfree(stable_tree_hash);
+		vfree(unstable_tree_hash);
+		stable_tree_hash = unstable_tree_hash = NULL;
+		return -ENOMEM;
+	}
+	ksm_hash_shift = shift;
+	return 0;
+}
 
 #define MM_SLOTS_HASH_SHIFT 10
 #define MM_SLOTS_HASH_HEADS (1 << MM_SLOTS_HASH_SHIFT)
@@ -182,12 +222,25 @@ static unsigned long ksm_pages_unshared;
 /* The number of rmap_items in use: to calculate pages_volatile */
 static unsigned long ksm_rmap_items;
 
+/* The number of merges that freed a page */
+static unsigned long ksm_pages_merged;
+
 /* Number of pages ksmd should scan in one batch */
 static unsigned int ksm_thread_pages_to_scan = 100;
 
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 20;
 
+/* Scale the batch between 1/8 and 8 times pages_to_scan by merge yield */
+static unsigned int ksm_thread_adaptive_scan;
+static unsigned int ksm_scan_batch = 100;
+#define KSM_SCAN_RANGE	8
+
+/* Pages merged per second of ksmd cpu time, over the last full scan */
+static unsigned long ksm_merge_rate;
+static unsigned long ksm_scan_merged;
+static u64 ksm_scan_runtime;
+
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
@@ -457,7 +510,7 @@ static void remove_node_from_stable_tree(struct stable_node *stable_node)
 		cond_resched();
 	}
 
-	rb_erase(&stable_node->node, &root_stable_tree);
+	hlist_del(&stable_node->node);
 	free_stable_node(stable_node);
 }
 
@@ -546,16 +599,16 @@ static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 	} else if (rmap_item->address & UNSTABLE_FLAG) {
 		unsigned char age;
 		/*
-		 * Usually ksmd can and must skip the rb_erase, because
-		 * root_unstable_tree was already reset to RB_ROOT.
-		 * But be careful when an mm is exiting: do the rb_erase
+		 * Usually ksmd can and must skip the hlist_del, because
+		 * unstable_tree_hash was already emptied.
+		 * But be careful when an mm is exiting: do the hlist_del
 		 * if this rmap_item was inserted by this scan, rather
 		 * than left over from before.
 		 */
 		age = (unsigned char)(ksm_scan.seqnr - rmap_item->address);
 		BUG_ON(age > 1);
 		if (!age)
-			rb_erase(&rmap_item->node, &root_unstable_tree);
+			hlist_del(&rmap_item->node);
 
 		ksm_pages_unshared--;
 		rmap_item->address &= PAGE_MASK;
@@ -668,13 +721,32 @@ error:
 }
 #endif /* CONFIG_SYSFS */
 
+/*
+ * The checksum is both the hash key of the trees and the test of whether a
+ * page is changing, so it has to cover every word of the page; but it need
+ * not be strong, a match is always confirmed by memcmp_pages().  Four
+ * independent multiply-xor lanes over native words keep the multiplier
+ * pipelines busy without a dependency chain through the whole page; each
+ * step is invertible, so any single changed word changes the result.
+ */
 static u32 calc_checksum(struct page *page)
 {
-	u32 checksum;
-	void *addr = kmap_atomic(page, KM_USER0);
-	checksum = jhash2(addr, PAGE_SIZE / 4, 17);
+	unsigned long *addr = kmap_atomic(page, KM_USER0);
+	unsigned long a = 0, b = 0, c = 0, d = 0;
+	unsigned int i;
+
+	for (i = 0; i < PAGE_SIZE / sizeof(long); i += 4) {
+		a = (a ^ addr[i]) * GOLDEN_RATIO_PRIME;
+		b = (b ^ addr[i + 1]) * GOLDEN_RATIO_PRIME;
+		c = (c ^ addr[i + 2]) * GOLDEN_RATIO_PRIME;
+		d = (d ^ addr[i + 3]) * GOLDEN_RATIO_PRIME;
+	}
 	kunmap_atomic(addr, KM_USER0);
-	return checksum;
+
+	a = (a ^ b) * GOLDEN_RATIO_PRIME;
+	a = (a ^ c) * GOLDEN_RATIO_PRIME;
+	a = (a ^ d) * GOLDEN_RATIO_PRIME;
+	return hash_long(a, 32);
 }
 
 static int memcmp_pages(struct page *page1, struct page *page2)
@@ -982,10 +1054,10 @@ static struct page *try_to_merge_two_pages(struct rmap_item *rmap_item,
  * This function returns the stable tree node of identical content if found,
  * NULL otherwise.
  */
-static struct page *stable_tree_search(struct page *page)
+static struct page *stable_tree_search(struct page *page, u32 checksum)
 {
-	struct rb_node *node = root_stable_tree.rb_node;
 	struct stable_node *stable_node;
+	struct hlist_node *node, *next;
 
 	stable_node = page_stable_node(page);
 	if (stable_node) {			/* ksm page forked */
@@ -993,26 +1065,21 @@ static struct page *stable_tree_search(struct page *page)
 		return page;
 	}
 
-	while (node) {
+	hlist_for_each_entry_safe(stable_node, node, next,
+			ksm_hash_head(stable_tree_hash, checksum), node) {
 		struct page *tree_page;
-		int ret;
+
+		if (stable_node->checksum != checksum)
+			continue;
 
 		cond_resched();
-		stable_node = rb_entry(node, struct stable_node, node);
 		tree_page = get_ksm_page(stable_node);
 		if (!tree_page)
-			return NULL;
-
-		ret = memcmp_pages(page, tree_page);
+			continue;
 
-		if (ret < 0) {
-			put_page(tree_page);
-			node = node->rb_left;
-		} else if (ret > 0) {
-			put_page(tree_page);
-			node = node->rb_right;
-		} else
+		if (pages_identical(page, tree_page))
 			return tree_page;
+		put_page(tree_page);
 	}
 
 	return NULL;
@@ -1027,29 +1094,33 @@ static struct page *stable_tree_search(struct page *page)
  */
 static struct stable_node *stable_tree_insert(struct page *kpage)
 {
-	struct rb_node **new = &root_stable_tree.rb_node;
-	struct rb_node *parent = NULL;
 	struct stable_node *stable_node;
+	struct hlist_node *node, *next;
+	struct hlist_head *head;
+	u32 checksum;
 
-	while (*new) {
+	/*
+	 * kpage is write-protected now, but may have changed since the
+	 * checksum of the page it was made from was taken.
+	 */
+	checksum = calc_checksum(kpage);
+	head = ksm_hash_head(stable_tree_hash, checksum);
+
+	hlist_for_each_entry_safe(stable_node, node, next, head, node) {
 		struct page *tree_page;
 		int ret;
 
+		if (stable_node->checksum != checksum)
+			continue;
+
 		cond_resched();
-		stable_node = rb_entry(*new, struct stable_node, node);
 		tree_page = get_ksm_page(stable_node);
 		if (!tree_page)
-			return NULL;
+			continue;
 
 		ret = memcmp_pages(kpage, tree_page);
 		put_page(tree_page);
-
-		parent = *new;
-		if (ret < 0)
-			new = &parent->rb_left;
-		else if (ret > 0)
-			new = &parent->rb_right;
-		else {
+		if (!ret) {
 			/*
 			 * It is not a bug that stable_tree_search() didn't
 			 * find this node: because at that time our page was
@@ -1063,12 +1134,12 @@ static struct stable_node *stable_tree_insert(struct page *kpage)
 	if (!stable_node)
 		return NULL;
 
-	rb_link_node(&stable_node->node, parent, new);
-	rb_insert_color(&stable_node->node, &root_stable_tree);
+	hlist_add_head(&stable_node->node, head);
 
 	INIT_HLIST_HEAD(&stable_node->hlist);
 
 	stable_node->kpfn = page_to_pfn(kpage);
+	stable_node->checksum = checksum;
 	set_page_stable_node(kpage, stable_node);
 
 	return stable_node;
@@ -1086,7 +1157,7 @@ static struct stable_node *stable_tree_insert(struct page *kpage)
  * to the currently scanned page, NULL otherwise.
  *
  * This function does both searching and inserting, because they share
- * the same walking algorithm in an rbtree.
+ * the same hash chain; rmap_item->oldchecksum is the checksum of the page.
  */
 static
 struct rmap_item *unstable_tree_search_insert(struct rmap_item *rmap_item,
@@ -1094,19 +1165,21 @@ struct rmap_item *unstable_tree_search_insert(struct rmap_item *rmap_item,
 					      struct page **tree_pagep)
 
 {
-	struct rb_node **new = &root_unstable_tree.rb_node;
-	struct rb_node *parent = NULL;
+	u32 checksum = rmap_item->oldchecksum;
+	struct hlist_head *head = ksm_hash_head(unstable_tree_hash, checksum);
+	struct rmap_item *tree_rmap_item;
+	struct hlist_node *node;
 
-	while (*new) {
-		struct rmap_item *tree_rmap_item;
+	hlist_for_each_entry(tree_rmap_item, node, head, node) {
 		struct page *tree_page;
-		int ret;
+
+		if (tree_rmap_item->oldchecksum != checksum)
+			continue;
 
 		cond_resched();
-		tree_rmap_item = rb_entry(*new, struct rmap_item, node);
 		tree_page = get_mergeable_page(tree_rmap_item);
 		if (IS_ERR_OR_NULL(tree_page))
-			return NULL;
+			continue;
 
 		/*
 		 * Don't substitute a ksm page for a forked page.
@@ -1116,25 +1189,16 @@ struct rmap_item *unstable_tree_search_insert(struct rmap_item *rmap_item,
 			return NULL;
 		}
 
-		ret = memcmp_pages(page, tree_page);
-
-		parent = *new;
-		if (ret < 0) {
-			put_page(tree_page);
-			new = &parent->rb_left;
-		} else if (ret > 0) {
-			put_page(tree_page);
-			new = &parent->rb_right;
-		} else {
+		if (pages_identical(page, tree_page)) {
 			*tree_pagep = tree_page;
 			return tree_rmap_item;
 		}
+		put_page(tree_page);
 	}
 
 	rmap_item->address |= UNSTABLE_FLAG;
 	rmap_item->address |= (ksm_scan.seqnr & SEQNR_MASK);
-	rb_link_node(&rmap_item->node, parent, new);
-	rb_insert_color(&rmap_item->node, &root_unstable_tree);
+	hlist_add_head(&rmap_item->node, head);
 
 	ksm_pages_unshared++;
 	return NULL;
@@ -1179,7 +1243,8 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 	remove_rmap_item_from_tree(rmap_item);
 
 	/* We first start with searching the page inside the stable tree */
-	kpage = stable_tree_search(page);
+	checksum = calc_checksum(page);
+	kpage = stable_tree_search(page, checksum);
 	if (kpage) {
 		err = try_to_merge_with_ksm_page(rmap_item, page, kpage);
 		if (!err) {
@@ -1190,6 +1255,7 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 			lock_page(kpage);
 			stable_tree_append(rmap_item, page_stable_node(kpage));
 			unlock_page(kpage);
+			ksm_pages_merged++;
 		}
 		put_page(kpage);
 		return;
@@ -1201,7 +1267,6 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 	 * don't want to insert it in the unstable tree, and we don't want
 	 * to waste our time searching for something identical to it there.
 	 */
-	checksum = calc_checksum(page);
 	if (rmap_item->oldchecksum != checksum) {
 		rmap_item->oldchecksum = checksum;
 		return;
@@ -1226,6 +1291,7 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 			if (stable_node) {
 				stable_tree_append(tree_rmap_item, stable_node);
 				stable_tree_append(rmap_item, stable_node);
+				ksm_pages_merged++;
 			}
 			unlock_page(kpage);
 
@@ -1295,7 +1361,8 @@ static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 		 */
 		lru_add_drain_all();
 
-		root_unstable_tree = RB_ROOT;
+		memset(unstable_tree_hash, 0,
+		       sizeof(struct hlist_head) << ksm_hash_shift);
 
 		spin_lock(&ksm_mmlist_lock);
 		slot = list_entry(slot->mm_list.next, struct mm_slot, mm_list);
@@ -1408,18 +1475,54 @@ next_mm:
  */
 static void ksm_do_scan(unsigned int scan_npages)
 {
+	unsigned long seqnr = ksm_scan.seqnr, merged = ksm_pages_merged;
+	u64 runtime = task_sched_runtime(current);
 	struct rmap_item *rmap_item;
 	struct page *uninitialized_var(page);
+	unsigned int scanned, min_batch, max_batch;
 
-	while (scan_npages-- && likely(!freezing(current))) {
+	for (scanned = 0; scanned < scan_npages; scanned++) {
+		if (unlikely(freezing(current)))
+			break;
 		cond_resched();
 		rmap_item = scan_get_next_rmap_item(&page);
 		if (!rmap_item)
-			return;
+			break;
 		if (!PageKsm(page) || !in_stable_tree(rmap_item))
 			cmp_and_merge_page(page, rmap_item);
 		put_page(page);
 	}
+
+	merged = ksm_pages_merged - merged;
+	ksm_scan_merged += merged;
+	ksm_scan_runtime += task_sched_runtime(current) - runtime;
+	if (ksm_scan.seqnr != seqnr) {
+		ksm_merge_rate = div64_u64((u64)ksm_scan_merged * NSEC_PER_SEC,
+					   ksm_scan_runtime ? : 1);
+		ksm_scan_merged = 0;
+		ksm_scan_runtime = 0;
+	}
+
+	/*
+	 * Speed up while at least one page in a hundred scanned is merged,
+	 * slow down gently while fewer are.
+	 */
+	if (scanned && merged * 100 >= scanned)
+		ksm_scan_batch = min(ksm_scan_batch, UINT_MAX / 2) * 2;
+	else
+		ksm_scan_batch -= ksm_scan_batch / 4;
+
+	min_batch = max(ksm_thread_pages_to_scan / KSM_SCAN_RANGE, 1U);
+	max_batch = min(ksm_thread_pages_to_scan, UINT_MAX / KSM_SCAN_RANGE) *
+		    KSM_SCAN_RANGE;
+	ksm_scan_batch = clamp(ksm_scan_batch, min_batch, max_batch);
+}
+
+static unsigned int ksm_pages_to_scan(void)
+{
+	if (ksm_thread_adaptive_scan)
+		return ksm_scan_batch;
+	return ksm_thread_pages_to_scan;
 }
 
 static int ksmd_should_run(void)
@@ -1435,7 +1538,7 @@ static int ksm_scan_thread(void *nothing)
 	while (!kthread_should_stop()) {
 		mutex_lock(&ksm_thread_mutex);
 		if (ksmd_should_run())
-			ksm_do_scan(ksm_thread_pages_to_scan);
+			ksm_do_scan(ksm_pages_to_scan());
 		mutex_unlock(&ksm_thread_mutex);
 
 		try_to_freeze();
@@ -1762,15 +1865,20 @@ void ksm_migrate_page(struct page *newpage, struct page *oldpage)
 static struct stable_node *ksm_check_stable_tree(unsigned long start_pfn,
 						 unsigned long end_pfn)
 {
-	struct rb_node *node;
+	struct stable_node *stable_node;
+	struct hlist_node *node;
+	unsigned long i;
 
-	for (node = rb_first(&root_stable_tree); node; node = rb_next(node)) {
-		struct stable_node *stable_node;
+	if (!stable_tree_hash)
+		return NULL;
 
-		stable_node = rb_entry(node, struct stable_node, node);
-		if (stable_node->kpfn >= start_pfn &&
-		    stable_node->kpfn < end_pfn)
-			return stable_node;
+	for (i = 0; i < (1UL << ksm_hash_shift); i++) {
+		hlist_for_each_entry(stable_node, node,
+				     &stable_tree_hash[i], node) {
+			if (stable_node->kpfn >= start_pfn &&
+			    stable_node->kpfn < end_pfn)
+				return stable_node;
+		}
 	}
 	return NULL;
 }
@@ -1866,11 +1974,35 @@ static ssize_t pages_to_scan_store(struct kobject *kobj,
 		return -EINVAL;
 
 	ksm_thread_pages_to_scan = nr_pages;
+	ksm_scan_batch = nr_pages;
 
 	return count;
 }
 KSM_ATTR(pages_to_scan);
 
+static ssize_t adaptive_scan_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_thread_adaptive_scan);
+}
+
+static ssize_t adaptive_scan_store(struct kobject *kobj,
+				   struct kobj_attribute *attr,
+				   const char *buf, size_t count)
+{
+	unsigned long enable;
+	int err;
+
+	err = strict_strtoul(buf, 10, &enable);
+	if (err || enable > 1)
+		return -EINVAL;
+
+	ksm_thread_adaptive_scan = enable;
+
+	return count;
+}
+KSM_ATTR(adaptive_scan);
+
 static ssize_t run_show(struct kobject *kobj, struct kobj_attribute *attr,
 			char *buf)
 {
@@ -1897,6 +2029,10 @@ static ssize_t run_store(struct kobject *kobj, struct kobj_attribute *attr,
 	 */
 
 	mutex_lock(&ksm_thread_mutex);
+	if ((flags & KSM_RUN_MERGE) && ksm_alloc_hash()) {
+		mutex_unlock(&ksm_thread_mutex);
+		return -ENOMEM;
+	}
 	if (ksm_run != flags) {
 		ksm_run = flags;
 		if (flags & KSM_RUN_UNMERGE) {
@@ -1963,15 +2099,24 @@ static ssize_t full_scans_show(struct kobject *kobj,
 }
 KSM_ATTR_RO(full_scans);
 
+static ssize_t merge_rate_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_merge_rate);
+}
+KSM_ATTR_RO(merge_rate);
+
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
+	&adaptive_scan_attr.attr,
 	&run_attr.attr,
 	&pages_shared_attr.attr,
 	&pages_sharing_attr.attr,
 	&pages_unshared_attr.attr,
 	&pages_volatile_attr.attr,
 	&full_scans_attr.attr,
+	&merge_rate_attr.attr,
 	NULL,
 };
 
@@ -2005,6 +2150,11 @@ static int __init ksm_init(void)
 		goto out_free;
 	}
 #else
+	err = ksm_alloc_hash();
+	if (err) {
+		kthread_stop(ksm_thread);
+		goto out_free;
+	}
 	ksm_run = KSM_RUN_MERGE;	/* no way for user to start it */
 
 #endif /* CONFIG_SYSFS */
@@ -577,6 +577,59 @@ static inline int free_pages_check(struct page *page)
 	return 0;
 }
 
+/*
+ * zone->lock is taken through these in the allocator paths, so that the
+ * hold time, the number of pages moved per acquisition and how often the
+ * lock was found contended show up in /proc/zoneinfo.
+ *
+ * A window of ZONE_LOCK_WINDOW acquisitions with more than one in eight
+ * contended doubles the pcp batches (up to 1 << ZONE_BATCH_SHIFT_MAX),
+ * so that every acquisition moves more pages; a window with less than one
+ * in thirty-two halves them again.
+ */
+#define ZONE_LOCK_WINDOW	64
+#define ZONE_BATCH_SHIFT_MAX	2
+
+static inline u64 zone_lock(struct zone *zone)
+{
+	if (!spin_trylock(&zone->lock)) {
+		spin_lock(&zone->lock);
+		zone->lock_contended++;
+		zone->lock_window_contended++;
+	}
+	return local_clock();
+}
+
+static inline void zone_unlock(struct zone *zone, u64 start,
+			       unsigned long nr_pages)
+{
+	zone->lock_hold_ns += local_clock() - start;
+	zone->lock_acquired++;
+	zone->lock_pages += nr_pages;
+
+	if (unlikely(++zone->lock_window == ZONE_LOCK_WINDOW)) {
+		unsigned int contended = zone->lock_window_contended;
+
+		if (contended > ZONE_LOCK_WINDOW / 8 &&
+		    zone->lock_batch_shift < ZONE_BATCH_SHIFT_MAX)
+			zone->lock_batch_shift++;
+		else if (contended < ZONE_LOCK_WINDOW / 32 &&
+			 zone->lock_batch_shift > 0)
+			zone->lock_batch_shift--;
+		zone->lock_window = 0;
+		zone->lock_window_contended = 0;
+	}
+	spin_unlock(&zone->lock);
+}
+
+/* pcp->batch scaled for contention, never more than the list may hold */
+static inline int pcp_batch(struct zone *zone, struct per_cpu_pages *pcp)
+{
+	int batch = pcp->batch << ACCESS_ONCE(zone->lock_batch_shift);
+
+	return min(batch, max(pcp->high, pcp->batch));
+}
+
 /*
  * Frees a number of pages from the PCP lists
  * Assumes all pages on list are in same zone, and of same order.
@@ -594,8 +647,9 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 	int migratetype = 0;
 	int batch_free = 0;
 	int to_free = count;
+	u64 start;
 
-	spin_lock(&zone->lock);
+	start = zone_lock(zone);
 	zone->all_unreclaimable = 0;
 	zone->pages_scanned = 0;
 
@@ -631,19 +685,108 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 		} while (--to_free && --batch_free && !list_empty(list));
 	}
 	__mod_zone_page_state(zone, NR_FREE_PAGES, count);
-	spin_unlock(&zone->lock);
+	zone_unlock(zone, start, count);
+}
+
+/*
+ * Blocks of order 1..PCP_HIGH_ORDER move between the buddy lists and the
+ * per-cpu order lists in chunks worth half a pcp batch of pages, and are
+ * kept up to a quarter of pcp->high worth of pages per order. A pageset
+ * with no high mark (the boot pageset) caches nothing.
+ */
+static inline int pcp_order_high(struct per_cpu_pages *pcp, int order)
+{
+	return pcp->high >> (order + 2);
+}
+
+static inline int pcp_order_batch(struct zone *zone,
+				  struct per_cpu_pages *pcp, int order)
+{
+	int batch = pcp_batch(zone, pcp) >> (order + 1);
+
+	return max(1, min(batch, pcp_order_high(pcp, order)));
+}
+
+/*
+ * Frees up to count blocks from the per-cpu lists of the given order,
+ * under a single hold of the zone lock.
+ */
+static void free_pcp_order_bulk(struct zone *zone, int order, int count,
+				struct per_cpu_order_pages *pco)
+{
+	int migratetype;
+	int freed = 0;
+	u64 start;
+
+	start = zone_lock(zone);
+	zone->all_unreclaimable = 0;
+	zone->pages_scanned = 0;
+
+	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++) {
+		struct list_head *list = &pco->lists[migratetype];
+
+		while (freed < count && !list_empty(list)) {
+			struct page *page;
+
+			page = list_entry(list->prev, struct page, lru);
+			list_del(&page->lru);
+			__free_one_page(page, zone, order, page_private(page));
+			trace_mm_page_pcpu_drain(page, order,
+						 page_private(page));
+			freed++;
+		}
+	}
+	pco->count -= freed;
+	__mod_zone_page_state(zone, NR_FREE_PAGES, freed << order);
+	zone_unlock(zone, start, freed << order);
+}
+
+/* Returns true if there were blocks to drain */
+static bool drain_pcp_orders(struct zone *zone, struct per_cpu_pages *pcp)
+{
+	bool drained = false;
+	int i;
+
+	for (i = 0; i < PCP_HIGH_ORDER; i++)
+		if (pcp->orders[i].count) {
+			free_pcp_order_bulk(zone, i + 1, pcp->orders[i].count,
+					    &pcp->orders[i]);
+			drained = true;
+		}
+	return drained;
+}
+
+/*
+ * The blocks on the per-cpu order lists are neither in free_area nor in
+ * NR_FREE_PAGES, so a high-order watermark check, or compaction deciding
+ * whether a zone is worth compacting, does not see them, and they cannot
+ * merge with their buddies. Hand this cpu's blocks of @zone back before
+ * such a check is allowed to fail.
+ */
+static bool drain_zone_pcp_orders(struct zone *zone)
+{
+	unsigned long flags;
+	bool drained;
+
+	local_irq_save(flags);
+	drained = drain_pcp_orders(zone, &this_cpu_ptr(zone->pageset)->pcp);
+	local_irq_restore(flags);
+
+	return drained;
 }
 
 static void free_one_page(struct zone *zone, struct page *page, int order,
 				int migratetype)
 {
-	spin_lock(&zone->lock);
+	u64 start;
+
+	start = zone_lock(zone);
 	zone->all_unreclaimable = 0;
 	zone->pages_scanned = 0;
 
 	__free_one_page(page, zone, order, migratetype);
 	__mod_zone_page_state(zone, NR_FREE_PAGES, 1 << order);
-	spin_unlock(&zone->lock);
+	zone_unlock(zone, start, 1 << order);
 }
 
 static bool free_pages_prepare(struct page *page, unsigned int order)
@@ -672,6 +815,43 @@ static bool free_pages_prepare(struct page *page, unsigned int order)
 	return true;
 }
 
+/*
+ * Put a freed block of order 1..PCP_HIGH_ORDER on this cpu's lists, spilling
+ * a chunk back to the buddy allocator once they are full. Interrupts must
+ * be disabled.
+ */
+static void free_pcp_order_page(struct page *page, int order)
+{
+	struct zone *zone = page_zone(page);
+	struct per_cpu_pages *pcp;
+	struct per_cpu_order_pages *pco;
+	int migratetype;
+
+	/* the buddy allocator does this in __free_one_page() */
+	if (unlikely(PageCompound(page)))
+		if (unlikely(destroy_compound_page(page, order)))
+			return;
+
+	/* same migratetype rules as free_hot_cold_page() */
+	migratetype = get_pageblock_migratetype(page);
+	set_page_private(page, migratetype);
+	if (migratetype >= MIGRATE_PCPTYPES) {
+		if (unlikely(migratetype == MIGRATE_ISOLATE)) {
+			free_one_page(zone, page, order, migratetype);
+			return;
+		}
+		migratetype = MIGRATE_MOVABLE;
+	}
+
+	pcp = &this_cpu_ptr(zone->pageset)->pcp;
+	pco = &pcp->orders[order - 1];
+	list_add(&page->lru, &pco->lists[migratetype]);
+	pco->count++;
+	if (pco->count >= pcp_order_high(pcp, order))
+		free_pcp_order_bulk(zone, order,
+				    pcp_order_batch(zone, pcp, order), pco);
+}
+
 static void __free_pages_ok(struct page *page, unsigned int order)
 {
 	unsigned long flags;
@@ -684,7 +864,10 @@ static void __free_pages_ok(struct page *page, unsigned int order)
 	if (unlikely(wasMlocked))
 		free_page_mlock(page);
 	__count_vm_events(PGFREE, 1 << order);
-	free_one_page(page_zone(page), page, order,
+	if (order <= PCP_HIGH_ORDER)
+		free_pcp_order_page(page, order);
+	else
+		free_one_page(page_zone(page), page, order,
 					get_pageblock_migratetype(page));
 	local_irq_restore(flags);
 }
@@ -1022,8 +1205,9 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 			int migratetype, int cold)
 {
 	int i;
+	u64 start;
 	
-	spin_lock(&zone->lock);
+	start = zone_lock(zone);
 	for (i = 0; i < count; ++i) {
 		struct page *page = __rmqueue(zone, order, migratetype);
 		if (unlikely(page == NULL))
@@ -1046,7 +1230,7 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 		list = &page->lru;
 	}
 	__mod_zone_page_state(zone, NR_FREE_PAGES, -(i << order));
-	spin_unlock(&zone->lock);
+	zone_unlock(zone, start, i << order);
 	return i;
 }
 
@@ -1071,6 +1255,7 @@ void drain_zone_pages(struct zone *zone, struct per_cpu_pages *pcp)
 		to_drain = pcp->count;
 	free_pcppages_bulk(zone, to_drain, pcp);
 	pcp->count -= to_drain;
+	drain_pcp_orders(zone, pcp);
 	local_irq_restore(flags);
 }
 #endif
@@ -1099,6 +1284,7 @@ static void drain_pages(unsigned int cpu)
 			free_pcppages_bulk(zone, pcp->count, pcp);
 			pcp->count = 0;
 		}
+		drain_pcp_orders(zone, pcp);
 		local_irq_restore(flags);
 	}
 }
@@ -1199,8 +1385,10 @@ void free_hot_cold_page(struct page *page, int cold)
 		list_add(&page->lru, &pcp->lists[migratetype]);
 	pcp->count++;
 	if (pcp->count >= pcp->high) {
-		free_pcppages_bulk(zone, pcp->batch, pcp);
-		pcp->count -= pcp->batch;
+		int batch = pcp_batch(zone, pcp);
+
+		free_pcppages_bulk(zone, batch, pcp);
+		pcp->count -= batch;
 	}
 
 out:
@@ -1304,7 +1492,7 @@ again:
 		list = &pcp->lists[migratetype];
 		if (list_empty(list)) {
 			pcp->count += rmqueue_bulk(zone, 0,
-					pcp->batch, list,
+					pcp_batch(zone, pcp), list,
 					migratetype, cold);
 			if (unlikely(list_empty(list)))
 				goto failed;
@@ -1331,12 +1519,42 @@ again:
 			 */
 			WARN_ON_ONCE(order > 1);
 		}
-		spin_lock_irqsave(&zone->lock, flags);
-		page = __rmqueue(zone, order, migratetype);
-		spin_unlock(&zone->lock);
-		if (!page)
-			goto failed;
-		__mod_zone_page_state(zone, NR_FREE_PAGES, -(1 << order));
+		if (order <= PCP_HIGH_ORDER) {
+			struct per_cpu_pages *pcp;
+			struct per_cpu_order_pages *pco;
+			struct list_head *list;
+
+			local_irq_save(flags);
+			pcp = &this_cpu_ptr(zone->pageset)->pcp;
+			pco = &pcp->orders[order - 1];
+			list = &pco->lists[migratetype];
+			if (list_empty(list)) {
+				int batch = pcp_order_batch(zone, pcp, order);
+
+				pco->miss++;
+				pco->count += rmqueue_bulk(zone, order, batch,
+						list, migratetype, cold);
+				if (unlikely(list_empty(list)))
+					goto failed;
+			} else
+				pco->hit++;
+
+			page = list_entry(list->next, struct page, lru);
+			list_del(&page->lru);
+			pco->count--;
+		} else {
+			u64 start;
+
+			local_irq_save(flags);
+			start = zone_lock(zone);
+			page = __rmqueue(zone, order, migratetype);
+			if (page)
+				__mod_zone_page_state(zone, NR_FREE_PAGES,
+						      -(1 << order));
+			zone_unlock(zone, start, page ? 1 << order : 0);
+			if (!page)
+				goto failed;
+		}
 	}
 
 	__count_zone_vm_events(PGALLOC, zone, 1 << order);
@@ -1674,6 +1892,11 @@ zonelist_scan:
 				    classzone_idx, alloc_flags))
 				goto try_this_zone;
 
+			if (order && drain_zone_pcp_orders(zone) &&
+			    zone_watermark_ok(zone, order, mark,
+				    classzone_idx, alloc_flags))
+				goto try_this_zone;
+
 			if (zone_reclaim_mode == 0)
 				goto this_zone_full;
 
@@ -1823,6 +2046,14 @@ out:
 }
 
 #ifdef CONFIG_COMPACTION
+static void drain_local_pcp_orders(void *arg)
+{
+	struct zone *zone;
+
+	for_each_populated_zone(zone)
+		drain_zone_pcp_orders(zone);
+}
+
 /* Try memory compaction for high-order allocations before reclaim */
 static struct page *
 __alloc_pages_direct_compact(gfp_t gfp_mask, unsigned int order,
@@ -1836,6 +2067,9 @@ __alloc_pages_direct_compact(gfp_t gfp_mask, unsigned int order,
 	if (!order || compaction_deferred(preferred_zone))
 		return NULL;
 
+	/* let compaction see, and merge, the blocks cached on the cpus */
+	on_each_cpu(drain_local_pcp_orders, NULL, 1);
+
 	current->flags |= PF_MEMALLOC;
 	*did_some_progress = try_to_compact_pages(zonelist, order, gfp_mask,
 						nodemask, sync_migration);
@@ -1882,6 +2116,18 @@ __alloc_pages_direct_compact(gfp_t gfp_mask, unsigned int order,
 }
 #endif /* CONFIG_COMPACTION */
 
+/* Histogram of the time spent in direct reclaim, in /proc/vmstat */
+static void count_reclaim_stall(u64 start)
+{
+	u64 ms = div_u64(local_clock() - start, NSEC_PER_MSEC);
+	int i;
+
+	for (i = 0; i < ALLOCSTALL_GE_64MS - ALLOCSTALL_LT_1MS; i++)
+		if (ms < (1 << (2 * i)))
+			break;
+	count_vm_event(ALLOCSTALL_LT_1MS + i);
+}
+
 /* The really slow allocator path where we enter direct reclaim */
 static inline struct page *
 __alloc_pages_direct_reclaim(gfp_t gfp_mask, unsigned int order,
@@ -1892,11 +2138,17 @@ __alloc_pages_direct_reclaim(gfp_t gfp_mask, unsigned int order,
 	struct page *page = NULL;
 	struct reclaim_state reclaim_state;
 	bool drained = false;
+	u64 start;
 
 	cond_resched();
 
-	/* We now go into synchronous reclaim */
+	start = local_clock();
 	cpuset_memory_pressure_bump();
+	if (offload_direct_reclaim(zonelist, order, gfp_mask, nodemask,
+				   did_some_progress))
+		goto done;
+
+	/* We now go into synchronous reclaim */
 	current->flags |= PF_MEMALLOC;
 	lockdep_set_current_reclaim_state(gfp_mask);
 	reclaim_state.reclaimed_slab = 0;
@@ -1907,6 +2159,8 @@ __alloc_pages_direct_reclaim(gfp_t gfp_mask, unsigned int order,
 	current->reclaim_state = NULL;
 	lockdep_clear_current_reclaim_state();
 	current->flags &= ~PF_MEMALLOC;
+done:
+	count_reclaim_stall(start);
 
 	cond_resched();
 
@@ -3526,7 +3780,7 @@ static int zone_batchsize(struct zone *zone)
 static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 {
 	struct per_cpu_pages *pcp;
-	int migratetype;
+	int migratetype, order;
 
 	memset(p, 0, sizeof(*p));
 
@@ -3536,6 +3790,10 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 	pcp->batch = max(1UL, 1 * batch);
 	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++)
 		INIT_LIST_HEAD(&pcp->lists[migratetype]);
+	for (order = 0; order < PCP_HIGH_ORDER; order++)
+		for (migratetype = 0; migratetype < MIGRATE_PCPTYPES;
+		     migratetype++)
+			INIT_LIST_HEAD(&pcp->orders[order].lists[migratetype]);
 }
 
 /*
@@ -3643,6 +3901,7 @@ static int __zone_pcp_update(void *data)
 
 		local_irq_save(flags);
 		free_pcppages_bulk(zone, pcp->count, pcp);
+		drain_pcp_orders(zone, pcp);
 		setup_pageset(pset, batch);
 		local_irq_restore(flags);
 	}
@@ -4248,6 +4507,14 @@ static void __paginginit free_area_init_core(struct pglist_data *pgdat,
 	pgdat->nr_zones = 0;
 	init_waitqueue_head(&pgdat->kswapd_wait);
 	pgdat->kswapd_max_order = 0;
+#ifdef CONFIG_RECLAIM_OFFLOAD
+	spin_lock_init(&pgdat->reclaim_lock);
+	init_waitqueue_head(&pgdat->reclaim_wait);
+	init_waitqueue_head(&pgdat->reclaim_done);
+#endif
+#ifdef CONFIG_COMPACTION
+	init_waitqueue_head(&pgdat->kcompactd_wait);
+#endif
 	pgdat_page_cgroup_init(pgdat);
 	
 	for (j = 0; j < MAX_NR_ZONES; j++) {
@@ -139,6 +139,21 @@ out:
 	return ret;
 }
 
+/* number of pages cached in [@offset, @offset + @nr) */
+static unsigned long count_cached_pages(struct address_space *mapping,
+					pgoff_t offset, unsigned long nr)
+{
+	unsigned long i, cached = 0;
+
+	rcu_read_lock();
+	for (i = 0; i < nr; i++)
+		if (radix_tree_lookup(&mapping->page_tree, offset + i))
+			cached++;
+	rcu_read_unlock();
+
+	return cached;
+}
+
 /*
  * __do_page_cache_readahead() actually reads a chunk of disk.  It allocates all
  * the pages first, then submits them all for I/O. This avoids the very bad
@@ -195,8 +210,18 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 	 * uptodate then the caller will launch readpage again, and
 	 * will then handle the error.
 	 */
-	if (ret)
+	if (ret) {
+		long added;
+
 		read_pages(mapping, filp, &page_pool, ret);
+
+		/* pages that lost a race to be added were freed again */
+		added = count_cached_pages(mapping, offset, page_idx) -
+			(page_idx - ret);
+		if (added > 0)
+			__add_bdi_stat(mapping->backing_dev_info,
+				       BDI_READAHEAD, added);
+	}
 	BUG_ON(!list_empty(&page_pool));
 out:
 	return ret;
@@ -334,8 +359,99 @@ static unsigned long get_next_ra_size(struct file_ra_state *ra,
  *
  * The code ramps up the readahead size aggressively at first, but slow down as
  * it approaches max_readhead.
+ *
+ * Each synchronous miss is also remembered in prev_miss, with its distance
+ * from the previous one in stride. A run of misses at the same distance is
+ * a strided (records of a fixed size apart) or backward (stride < 0) scan,
+ * which the window logic above cannot follow; those get the next records
+ * along the stride read ahead instead, see stride_readahead().
+ *
+ * A synchronous miss inside the window that was read ahead last means its
+ * pages were reclaimed before the reader got to them. The window is then
+ * capped in ra->limit at half its size, and the cap is relaxed by a quarter
+ * for every window that is consumed in sequence afterwards.
+ *
+ * The same two events account readahead use per backing device, without
+ * any per-page state: a sequential stream moving on to its next window has
+ * used the pages it read ahead up to there, from ra->used on, and a miss
+ * inside the window counts the rest of it as wasted. Pages of a stream that
+ * stops, or that are truncated, count as neither.
  */
 
+#define MIN_RA_LIMIT	4
+
+static unsigned long ra_max_pages(struct file_ra_state *ra)
+{
+	unsigned long max = max_sane_readahead(ra->ra_pages);
+
+	if (ra->limit && ra->limit < max)
+		max = ra->limit;
+	return max;
+}
+
+/* the reader has got to @offset in the stream, using what was read ahead */
+static void ra_account_used(struct address_space *mapping,
+			    struct file_ra_state *ra, pgoff_t offset)
+{
+	if (offset > ra->used && offset - ra->used <= 2 * ra->ra_pages)
+		__add_bdi_stat(mapping->backing_dev_info, BDI_READAHEAD_HIT,
+			       offset - ra->used);
+	ra->used = offset;
+}
+
+static void ra_note_miss(struct file_ra_state *ra, pgoff_t offset)
+{
+	long stride = (long)(offset - ra->prev_miss);
+
+	if (stride && stride == ra->stride)
+		ra->stride_hits++;
+	else
+		ra->stride_hits = 0;
+	ra->stride = stride;
+	ra->prev_miss = offset;
+}
+
+/*
+ * Read the record at @offset, and up to 2^stride_hits records further
+ * along the stride. prev_miss is moved to the last of them, so that the
+ * miss on the record after it continues the run.
+ */
+static unsigned long stride_readahead(struct address_space *mapping,
+				      struct file_ra_state *ra,
+				      struct file *filp, pgoff_t offset,
+				      unsigned long req_size, unsigned long max)
+{
+	long stride = ra->stride;
+	unsigned long nr, i, ret;
+
+	if (stride > 0 && stride < req_size)
+		return 0;
+
+	nr = min(1UL << min(ra->stride_hits, 5U), max / req_size);
+	if (!nr)
+		return 0;
+
+	if (stride < 0 && -stride <= req_size) {
+		/* backward and contiguous: one block below the record */
+		unsigned long span = nr * -stride;
+		pgoff_t start = offset > span ? offset - span : 0;
+
+		ra->prev_miss = start;
+		return __do_page_cache_readahead(mapping, filp, start,
+						 offset - start + req_size, 0);
+	}
+
+	ret = __do_page_cache_readahead(mapping, filp, offset, req_size, 0);
+	for (i = 1; i <= nr; i++) {
+		if (stride < 0 && i * -stride > offset)
+			break;
+		ra->prev_miss = offset + i * stride;
+		ret += __do_page_cache_readahead(mapping, filp, ra->prev_miss,
+						 req_size, 0);
+	}
+	return ret;
+}
+
 /*
  * Count contiguously cached pages from @offset-1 to @offset-@max,
  * this count is a conservative estimation of
@@ -398,7 +514,25 @@ ondemand_readahead(struct address_space *mapping,
 		   bool hit_readahead_marker, pgoff_t offset,
 		   unsigned long req_size)
 {
-	unsigned long max = max_sane_readahead(ra->ra_pages);
+	unsigned long max = ra_max_pages(ra);
+
+	if (!hit_readahead_marker) {
+		ra_note_miss(ra, offset);
+
+		/*
+		 * What we read ahead last time is gone already: read less.
+		 */
+		if (offset >= ra->start && offset < ra->start + ra->size) {
+			ra_account_used(mapping, ra, offset);
+			__add_bdi_stat(mapping->backing_dev_info,
+				       BDI_READAHEAD_WASTED,
+				       ra->start + ra->size - offset);
+			ra->limit = max_t(unsigned int, ra->size / 2,
+					  MIN_RA_LIMIT);
+			max = ra_max_pages(ra);
+			goto initial_readahead;
+		}
+	}
 
 	/*
 	 * start of file
@@ -412,6 +546,13 @@ ondemand_readahead(struct address_space *mapping,
 	 */
 	if ((offset == (ra->start + ra->size - ra->async_size) ||
 	     offset == (ra->start + ra->size))) {
+		if (ra->limit && hit_readahead_marker) {
+			ra->limit += ra->limit / 4;
+			if (ra->limit >= ra->ra_pages)
+				ra->limit = 0;
+			max = ra_max_pages(ra);
+		}
+		ra_account_used(mapping, ra, offset);
 		ra->start += ra->size;
 		ra->size = get_next_ra_size(ra, max);
 		ra->async_size = ra->size;
@@ -435,6 +576,7 @@ ondemand_readahead(struct address_space *mapping,
 			return 0;
 
 		ra->start = start;
+		ra->used = start;
 		ra->size = start - offset;	/* old async_size */
 		ra->size += req_size;
 		ra->size = get_next_ra_size(ra, max);
@@ -458,8 +600,21 @@ ondemand_readahead(struct address_space *mapping,
 	 * Query the page cache and look for the traces(cached history pages)
 	 * that a sequential stream would leave behind.
 	 */
-	if (try_context_readahead(mapping, ra, offset, req_size, max))
+	if (try_context_readahead(mapping, ra, offset, req_size, max)) {
+		ra->used = offset + req_size;
 		goto readit;
+	}
+
+	/*
+	 * strided or backward scan
+	 */
+	if (ra->stride_hits) {
+		unsigned long ret;
+
+		ret = stride_readahead(mapping, ra, filp, offset, req_size, max);
+		if (ret)
+			return ret;
+	}
 
 	/*
 	 * standalone, small random read
@@ -468,6 +623,7 @@ ondemand_readahead(struct address_space *mapping,
 	return __do_page_cache_readahead(mapping, filp, offset, req_size, 0);
 
 initial_readahead:
+	ra->used = offset + req_size;
 	ra->start = offset;
 	ra->size = get_init_ra_size(req_size, max);
 	ra->async_size = ra->size > req_size ? ra->size - req_size : ra->size;
@@ -0,0 +1,223 @@
+/*
+ * mm/slab-bench.c
+ *
+ * Slab allocator microbenchmark. Loading the module times alloc/free pairs
+ * on a private cache and prints the results to the kernel log:
+ *
+ *  local:     alloc and free back to back on one cpu
+ *  cross-cpu: one cpu allocates, another frees, as in network buffers
+ *             allocated on the rx cpu and freed by the consuming task
+ *  single:    batches of objects allocated, then freed, one at a time
+ *  bulk:      the same batches through kmem_cache_alloc/free_bulk()
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/cpu.h>
+#include <linux/sched.h>
+
+static unsigned int iterations = 1000000;
+module_param(iterations, uint, 0444);
+MODULE_PARM_DESC(iterations, "objects allocated and freed per test");
+
+static unsigned int size = 256;
+module_param(size, uint, 0444);
+MODULE_PARM_DESC(size, "object size in bytes");
+
+static unsigned int batch = 16;
+module_param(batch, uint, 0444);
+MODULE_PARM_DESC(batch, "objects per batch in the single and bulk tests");
+
+static struct kmem_cache *bench_cache;
+
+#define RING_SIZE	1024
+
+/* single producer, single consumer ring of objects */
+static struct {
+	void *slot[RING_SIZE];
+	unsigned int head ____cacheline_aligned_in_smp;
+	unsigned int tail ____cacheline_aligned_in_smp;
+	struct completion done[2];
+} ring;
+
+static int bench_producer(void *unused)
+{
+	unsigned int i, head = 0;
+
+	for (i = 0; i < iterations; i++) {
+		void *obj = kmem_cache_alloc(bench_cache, GFP_KERNEL);
+
+		while (head - ACCESS_ONCE(ring.tail) >= RING_SIZE)
+			cpu_relax();
+		ring.slot[head % RING_SIZE] = obj;
+		smp_wmb();
+		ACCESS_ONCE(ring.head) = ++head;
+
+		if (!(i % RING_SIZE))
+			cond_resched();
+	}
+	complete(&ring.done[0]);
+	return 0;
+}
+
+static int bench_consumer(void *unused)
+{
+	unsigned int i, tail = 0;
+
+	for (i = 0; i < iterations; i++) {
+		void *obj;
+
+		while (ACCESS_ONCE(ring.head) == tail)
+			cpu_relax();
+		smp_rmb();
+		obj = ring.slot[tail % RING_SIZE];
+		if (obj)
+			kmem_cache_free(bench_cache, obj);
+		smp_mb();
+		ACCESS_ONCE(ring.tail) = ++tail;
+
+		if (!(i % RING_SIZE))
+			cond_resched();
+	}
+	complete(&ring.done[1]);
+	return 0;
+}
+
+static u64 bench_local(void)
+{
+	ktime_t start = ktime_get();
+	unsigned int i;
+
+	for (i = 0; i < iterations; i++) {
+		void *obj = kmem_cache_alloc(bench_cache, GFP_KERNEL);
+
+		if (obj)
+			kmem_cache_free(bench_cache, obj);
+		if (!(i % RING_SIZE))
+			cond_resched();
+	}
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+static u64 bench_batch(void **objs, bool bulk)
+{
+	ktime_t start = ktime_get();
+	unsigned int i, j;
+
+	for (i = 0; i < iterations; i += batch) {
+		if (bulk) {
+			if (kmem_cache_alloc_bulk(bench_cache, GFP_KERNEL,
+						  batch, objs))
+				kmem_cache_free_bulk(bench_cache, batch, objs);
+		} else {
+			for (j = 0; j < batch; j++)
+				objs[j] = kmem_cache_alloc(bench_cache,
+							   GFP_KERNEL);
+			for (j = 0; j < batch; j++)
+				if (objs[j])
+					kmem_cache_free(bench_cache, objs[j]);
+		}
+		cond_resched();
+	}
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+static s64 bench_cross_cpu(int from, int to)
+{
+	struct task_struct *producer, *consumer;
+	ktime_t start;
+
+	ring.head = ring.tail = 0;
+	init_completion(&ring.done[0]);
+	init_completion(&ring.done[1]);
+
+	producer = kthread_create(bench_producer, NULL, "slab_bench/%d", from);
+	if (IS_ERR(producer))
+		return PTR_ERR(producer);
+	consumer = kthread_create(bench_consumer, NULL, "slab_bench/%d", to);
+	if (IS_ERR(consumer)) {
+		kthread_stop(producer);
+		return PTR_ERR(consumer);
+	}
+	kthread_bind(producer, from);
+	kthread_bind(consumer, to);
+
+	start = ktime_get();
+	wake_up_process(consumer);
+	wake_up_process(producer);
+	wait_for_completion(&ring.done[0]);
+	wait_for_completion(&ring.done[1]);
+
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+static int __init slab_bench_init(void)
+{
+	void **objs;
+	int from, to;
+	s64 ns;
+
+	if (!iterations || !batch)
+		return -EINVAL;
+
+	bench_cache = kmem_cache_create("slab_bench", size, 0, 0, NULL);
+	if (!bench_cache)
+		return -ENOMEM;
+
+	pr_info("slab_bench: %u byte objects, %u iterations\n",
+		size, iterations);
+
+	ns = bench_local();
+	pr_info("slab_bench: local:     %llu ns/object\n",
+		div_u64(ns, iterations));
+
+	get_online_cpus();
+	from = cpumask_first(cpu_online_mask);
+	to = cpumask_next(from, cpu_online_mask);
+	if (to < nr_cpu_ids) {
+		ns = bench_cross_cpu(from, to);
+		if (ns < 0)
+			pr_err("slab_bench: cross-cpu test failed: %lld\n", ns);
+		else
+			pr_info("slab_bench: cross-cpu: %llu ns/object "
+				"(cpu%d -> cpu%d)\n",
+				div_u64(ns, iterations), from, to);
+	} else
+		pr_info("slab_bench: cross-cpu: skipped, one cpu online\n");
+	put_online_cpus();
+
+	objs = kmalloc(batch * sizeof(*objs), GFP_KERNEL);
+	if (!objs) {
+		kmem_cache_destroy(bench_cache);
+		return -ENOMEM;
+	}
+	ns = bench_batch(objs, false);
+	pr_info("slab_bench: single:    %llu ns/object (batches of %u)\n",
+		div_u64(ns, iterations), batch);
+	ns = bench_batch(objs, true);
+	pr_info("slab_bench: bulk:      %llu ns/object (batches of %u)\n",
+		div_u64(ns, iterations), batch);
+	kfree(objs);
+
+	return 0;
+}
+
+static void __exit slab_bench_exit(void)
+{
+	kmem_cache_destroy(bench_cache);
+}
+
+module_init(slab_bench_init);
+module_exit(slab_bench_exit);
+
+MODULE_LICENSE("GPL");
@@ -67,6 +67,13 @@
  *   a partial slab. A new slab has no one operating on it and thus there is
  *   no danger of cacheline contention.
  *
+ *   Frees to a slab other than the cpu slab do not take the slab_lock for
+ *   each object. They are chained up on the freeing processor as long as
+ *   they belong to the same slab and handed back to it in one go, under a
+ *   single slab_lock, when an object from another slab is freed, when
+ *   SLUB_REMOTE_BATCH objects have accumulated or when the cpu slab is
+ *   flushed. Until then the slab keeps counting them as in use.
+ *
  *   Interrupts are disabled during allocation and deallocation in order to
  *   make the slab allocator safe to use in the context of an irq. In addition
  *   interrupts are disabled to ensure that the processor does not change
@@ -120,6 +127,12 @@ static inline int kmem_cache_debug(struct kmem_cache *s)
 #endif
 }
 
+/*
+ * Maximum number of objects freed to a remote slab that are held back on
+ * the freeing processor before the slab is locked to take them back.
+ */
+#define SLUB_REMOTE_BATCH	32
+
 /*
  * Issues still to be resolved:
  *
@@ -1669,7 +1682,80 @@ static inline void flush_slab(struct kmem_cache *s, struct kmem_cache_cpu *c)
 }
 
 /*
- * Flush cpu slab.
+ * Return a chain of nr objects, linked through their free pointers from
+ * head to tail, to a slab that is not the cpu slab of this processor.
+ *
+ * Must be called with the slab lock held.
+ *
+ * On exit the slab lock will have been dropped.
+ */
+static void free_slab_objects(struct kmem_cache *s, struct page *page,
+			void **head, void **tail, int nr)
+	__releases(bitlock)
+{
+	void *prior = page->freelist;
+
+	set_freepointer(s, tail, prior);
+	page->freelist = head;
+	page->inuse -= nr;
+
+	if (unlikely(PageSlubFrozen(page))) {
+		stat(s, FREE_FROZEN);
+		goto out_unlock;
+	}
+
+	if (unlikely(!page->inuse))
+		goto slab_empty;
+
+	/*
+	 * Objects left in the slab. If it was not on the partial list before
+	 * then add it.
+	 */
+	if (unlikely(!prior)) {
+		add_partial(get_node(s, page_to_nid(page)), page, 1);
+		stat(s, FREE_ADD_PARTIAL);
+	}
+
+out_unlock:
+	slab_unlock(page);
+	return;
+
+slab_empty:
+	if (prior) {
+		/*
+		 * Slab still on the partial list.
+		 */
+		remove_partial(s, page);
+		stat(s, FREE_REMOVE_PARTIAL);
+	}
+	slab_unlock(page);
+	stat(s, FREE_SLAB);
+	discard_slab(s, page);
+}
+
+/*
+ * Hand the objects queued by __slab_free back to their slab.
+ *
+ * Interrupts must be disabled, and c must belong to this processor or to
+ * one that is offline.
+ */
+static void flush_remote_frees(struct kmem_cache *s, struct kmem_cache_cpu *c)
+{
+	struct page *page = c->remote_page;
+
+	slab_lock(page);
+	stat(s, FREE_REMOTE_FLUSH);
+	free_slab_objects(s, page, c->remote_freelist, c->remote_tail,
+			  c->remote_nr);
+
+	c->remote_freelist = NULL;
+	c->remote_tail = NULL;
+	c->remote_page = NULL;
+	c->remote_nr = 0;
+}
+
+/*
+ * Flush cpu slab and the remote frees held back by that cpu.
  *
  * Called from IPI handler with interrupts disabled.
  */
@@ -1677,8 +1763,13 @@ static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu)
 {
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
-	if (likely(c && c->page))
+	if (unlikely(!c))
+		return;
+
+	if (c->page)
 		flush_slab(s, c);
+	if (c->remote_page)
+		flush_remote_frees(s, c);
 }
 
 static void flush_cpu_slab(void *d)
@@ -2037,76 +2128,53 @@ EXPORT_SYMBOL(kmem_cache_alloc_node_trace);
  * Slow patch handling. This may still be called frequently since objects
  * have a longer lifetime than the cpu slabs in most processing loads.
  *
- * So we still attempt to reduce cache line usage. Just take the slab
- * lock and free the item. If there is no additional partial page
- * handling required then we can return immediately.
+ * So we still attempt to reduce cache line usage. Instead of taking the
+ * slab lock for each object, objects freed to the same slab are chained
+ * up per cpu and returned to the slab in one go (see flush_remote_frees).
+ * Debug caches keep freeing one object at a time under the slab lock.
  */
 static void __slab_free(struct kmem_cache *s, struct page *page,
 			void *x, unsigned long addr)
 {
-	void *prior;
 	void **object = (void *)x;
+	struct kmem_cache_cpu *c;
 #ifdef CONFIG_CMPXCHG_LOCAL
 	unsigned long flags;
 
 	local_irq_save(flags);
 #endif
-	slab_lock(page);
 	stat(s, FREE_SLOWPATH);
 
 	if (kmem_cache_debug(s))
 		goto debug;
 
-checks_ok:
-	prior = page->freelist;
-	set_freepointer(s, object, prior);
-	page->freelist = object;
-	page->inuse--;
-
-	if (unlikely(PageSlubFrozen(page))) {
-		stat(s, FREE_FROZEN);
-		goto out_unlock;
-	}
-
-	if (unlikely(!page->inuse))
-		goto slab_empty;
-
-	/*
-	 * Objects left in the slab. If it was not on the partial list before
-	 * then add it.
-	 */
-	if (unlikely(!prior)) {
-		add_partial(get_node(s, page_to_nid(page)), page, 1);
-		stat(s, FREE_ADD_PARTIAL);
+	c = __this_cpu_ptr(s->cpu_slab);
+	if (c->remote_page != page) {
+		if (c->remote_page)
+			flush_remote_frees(s, c);
+		c->remote_page = page;
+		c->remote_tail = object;
 	}
+	set_freepointer(s, object, c->remote_freelist);
+	c->remote_freelist = object;
+	stat(s, FREE_REMOTE);
 
-out_unlock:
-	slab_unlock(page);
-#ifdef CONFIG_CMPXCHG_LOCAL
-	local_irq_restore(flags);
-#endif
-	return;
+	if (unlikely(++c->remote_nr >= SLUB_REMOTE_BATCH))
+		flush_remote_frees(s, c);
 
-slab_empty:
-	if (prior) {
-		/*
-		 * Slab still on the partial list.
-		 */
-		remove_partial(s, page);
-		stat(s, FREE_REMOVE_PARTIAL);
-	}
-	slab_unlock(page);
+out:
 #ifdef CONFIG_CMPXCHG_LOCAL
 	local_irq_restore(flags);
 #endif
-	stat(s, FREE_SLAB);
-	discard_slab(s, page);
 	return;
 
 debug:
-	if (!free_debug_processing(s, page, x, addr))
-		goto out_unlock;
-	goto checks_ok;
+	slab_lock(page);
+	if (free_debug_processing(s, page, x, addr))
+		free_slab_objects(s, page, object, object, 1);
+	else
+		slab_unlock(page);
+	goto out;
 }
 
 /*
@@ -2189,6 +2257,101 @@ void kmem_cache_free(struct kmem_cache *s, void *x)
 }
 EXPORT_SYMBOL(kmem_cache_free);
 
+/*
+ * Bulk free. The objects are pushed onto the cpu freelist or, when they
+ * belong to another slab, onto the per cpu chain of remote frees, all in
+ * a single interrupt disabled section.
+ */
+void kmem_cache_free_bulk(struct kmem_cache *s, size_t size, void **p)
+{
+	struct kmem_cache_cpu *c;
+	unsigned long flags;
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		slab_free_hook(s, p[i]);
+
+	local_irq_save(flags);
+	c = __this_cpu_ptr(s->cpu_slab);
+	for (i = 0; i < size; i++) {
+		void **object = p[i];
+		struct page *page = virt_to_head_page(object);
+
+		if (likely(page == c->page && c->node != NUMA_NO_NODE)) {
+			set_freepointer(s, object, c->freelist);
+			c->freelist = object;
+			stat(s, FREE_FASTPATH);
+		} else
+			__slab_free(s, page, object, _RET_IP_);
+	}
+#ifdef CONFIG_CMPXCHG_LOCAL
+	/* Make lockless fastpaths interrupted on this cpu retry */
+	c->tid = next_tid(c->tid);
+#endif
+	local_irq_restore(flags);
+
+	for (i = 0; i < size; i++)
+		trace_kmem_cache_free(_RET_IP_, p[i]);
+}
+EXPORT_SYMBOL(kmem_cache_free_bulk);
+
+/*
+ * Bulk allocation. Objects are taken off the cpu freelist in a single
+ * interrupt disabled section; when it runs dry the whole freelist of the
+ * next slab becomes the cpu freelist through the usual slow path.
+ *
+ * Returns size on success, or 0 after freeing any objects already taken
+ * if not all of them could be allocated.
+ */
+int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
+			  void **p)
+{
+	struct kmem_cache_cpu *c;
+	unsigned long irqflags;
+	size_t i, j;
+
+	if (slab_pre_alloc_hook(s, flags))
+		return 0;
+
+	local_irq_save(irqflags);
+	c = __this_cpu_ptr(s->cpu_slab);
+	for (i = 0; i < size; i++) {
+		void *object = c->freelist;
+
+		if (unlikely(!object)) {
+			/* may enable interrupts to allocate a new slab */
+			object = __slab_alloc(s, flags, NUMA_NO_NODE,
+					      _RET_IP_, c);
+			c = __this_cpu_ptr(s->cpu_slab);
+			if (unlikely(!object))
+				break;
+		} else {
+			c->freelist = get_freepointer(s, object);
+			stat(s, ALLOC_FASTPATH);
+		}
+		p[i] = object;
+	}
+#ifdef CONFIG_CMPXCHG_LOCAL
+	c->tid = next_tid(c->tid);
+#endif
+	local_irq_restore(irqflags);
+
+	for (j = 0; j < i; j++) {
+		if (unlikely(flags & __GFP_ZERO))
+			memset(p[j], 0, s->objsize);
+		slab_post_alloc_hook(s, flags, p[j]);
+		trace_kmem_cache_alloc(_RET_IP_, p[j], s->objsize, s->size,
+				       flags);
+	}
+
+	if (unlikely(i < size)) {
+		kmem_cache_free_bulk(s, i, p);
+		return 0;
+	}
+	return size;
+}
+EXPORT_SYMBOL(kmem_cache_alloc_bulk);
+
 /*
  * Object placement in a slab is made very easy because we always start at
  * offset 0. If we tune the size of the object to the alignment then we can
@@ -4537,6 +4700,8 @@ STAT_ATTR(DEACTIVATE_TO_HEAD, deactivate_to_head);
 STAT_ATTR(DEACTIVATE_TO_TAIL, deactivate_to_tail);
 STAT_ATTR(DEACTIVATE_REMOTE_FREES, deactivate_remote_frees);
 STAT_ATTR(ORDER_FALLBACK, order_fallback);
+STAT_ATTR(FREE_REMOTE, free_remote);
+STAT_ATTR(FREE_REMOTE_FLUSH, free_remote_flush);
 #endif
 
 static struct attribute *slab_attrs[] = {
@@ -4594,6 +4759,8 @@ static struct attribute *slab_attrs[] = {
 	&deactivate_to_tail_attr.attr,
 	&deactivate_remote_frees_attr.attr,
 	&order_fallback_attr.attr,
+	&free_remote_attr.attr,
+	&free_remote_flush_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
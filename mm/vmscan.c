@@ -520,6 +520,7 @@ static int __remove_mapping(struct address_space *mapping, struct page *page)
 
 		freepage = mapping->a_ops->freepage;
 
+		workingset_eviction(mapping, page);
 		__delete_from_page_cache(page);
 		spin_unlock_irq(&mapping->tree_lock);
 		mem_cgroup_uncharge_cache_page(page);
@@ -2757,6 +2758,7 @@ void wakeup_kswapd(struct zone *zone, int order, enum zone_type classzone_idx)
 
 	trace_mm_vmscan_wakeup_kswapd(pgdat->node_id, zone_idx(zone), order);
 	wake_up_interruptible(&pgdat->kswapd_wait);
+	wakeup_kcompactd(zone, order);
 }
 
 /*
@@ -2859,6 +2861,156 @@ static int __devinit cpu_callback(struct notifier_block *nfb,
 	return NOTIFY_OK;
 }
 
+#ifdef CONFIG_RECLAIM_OFFLOAD
+/*
+ * Direct reclaim offload
+ *
+ * Tasks marked with PR_SET_RECLAIM_OFFLOAD post their reclaim request to
+ * the kreclaimd thread of the node they allocate from and sleep for at
+ * most sysctl_reclaim_offload_ms. Requests arriving while a pass is being
+ * set up are merged into it: the largest order wins, and so does the
+ * lowest zone asked for, since reclaiming for a low zone also covers the
+ * zones above it. A task that is not served in time does direct reclaim
+ * after all, so the worst case is the same as without offloading.
+ *
+ * Only requests that allow both I/O and filesystem recursion are offloaded:
+ * kreclaimd reclaims on behalf of the caller and knows nothing about the
+ * locks it holds.
+ */
+int sysctl_reclaim_offload_ms = 10;
+
+static int kreclaimd(void *p)
+{
+	pg_data_t *pgdat = p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+	struct reclaim_state reclaim_state = {
+		.reclaimed_slab = 0,
+	};
+
+	lockdep_set_current_reclaim_state(GFP_KERNEL);
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+	current->reclaim_state = &reclaim_state;
+	current->flags |= PF_MEMALLOC | PF_SWAPWRITE;
+	set_freezable();
+
+	for ( ; ; ) {
+		unsigned long progress;
+		gfp_t gfp_mask;
+		int order;
+
+		wait_event_freezable(pgdat->reclaim_wait,
+				     pgdat->reclaim_pending ||
+				     kthread_should_stop());
+		if (kthread_should_stop())
+			break;
+
+		spin_lock(&pgdat->reclaim_lock);
+		order = pgdat->reclaim_order;
+		gfp_mask = pgdat->reclaim_gfp;
+		pgdat->reclaim_pending = false;
+		pgdat->reclaim_running = true;
+		spin_unlock(&pgdat->reclaim_lock);
+
+		reclaim_state.reclaimed_slab = 0;
+		progress = try_to_free_pages(node_zonelist(pgdat->node_id,
+							   gfp_mask),
+					     order, gfp_mask, NULL);
+
+		spin_lock(&pgdat->reclaim_lock);
+		pgdat->reclaim_progress = progress;
+		pgdat->reclaim_running = false;
+		pgdat->reclaim_seq++;
+		spin_unlock(&pgdat->reclaim_lock);
+		wake_up_all(&pgdat->reclaim_done);
+	}
+
+	current->reclaim_state = NULL;
+	lockdep_clear_current_reclaim_state();
+	return 0;
+}
+
+/*
+ * Returns true if kreclaimd did the reclaim for this allocation, with the
+ * number of pages it freed in *progress, or false if the caller has to do
+ * direct reclaim itself.
+ */
+bool offload_direct_reclaim(struct zonelist *zonelist, int order,
+			    gfp_t gfp_mask, nodemask_t *nodemask,
+			    unsigned long *progress)
+{
+	unsigned long target;
+	struct zone *zone;
+	pg_data_t *pgdat;
+	long left;
+
+	if (!current->reclaim_offload || nodemask ||
+	    (gfp_mask & (__GFP_IO | __GFP_FS)) != (__GFP_IO | __GFP_FS))
+		return false;
+
+	first_zones_zonelist(zonelist, gfp_zone(gfp_mask), NULL, &zone);
+	if (!zone)
+		return false;
+	pgdat = zone->zone_pgdat;
+	if (!pgdat->kreclaimd)
+		return false;
+
+	spin_lock(&pgdat->reclaim_lock);
+	if (!pgdat->reclaim_pending) {
+		pgdat->reclaim_pending = true;
+		pgdat->reclaim_order = order;
+		pgdat->reclaim_gfp = gfp_mask;
+	} else {
+		pgdat->reclaim_order = max(pgdat->reclaim_order, order);
+		if (gfp_zone(gfp_mask) < gfp_zone(pgdat->reclaim_gfp))
+			pgdat->reclaim_gfp = gfp_mask;
+	}
+	/* a pass that is already running was set up without us */
+	target = pgdat->reclaim_seq + (pgdat->reclaim_running ? 2 : 1);
+	spin_unlock(&pgdat->reclaim_lock);
+
+	count_vm_event(RECLAIM_OFFLOAD);
+	wake_up(&pgdat->reclaim_wait);
+
+	left = wait_event_timeout(pgdat->reclaim_done,
+			(long)(ACCESS_ONCE(pgdat->reclaim_seq) - target) >= 0,
+			msecs_to_jiffies(sysctl_reclaim_offload_ms));
+	if (!left) {
+		count_vm_event(RECLAIM_OFFLOAD_TIMEOUT);
+		return false;
+	}
+
+	*progress = ACCESS_ONCE(pgdat->reclaim_progress);
+	return *progress != 0;
+}
+
+static void kreclaimd_run(pg_data_t *pgdat)
+{
+	struct task_struct *tsk;
+
+	if (pgdat->kreclaimd)
+		return;
+
+	tsk = kthread_run(kreclaimd, pgdat, "kreclaimd%d", pgdat->node_id);
+	if (IS_ERR(tsk))
+		printk(KERN_WARNING "Failed to start kreclaimd on node %d\n",
+		       pgdat->node_id);
+	else
+		pgdat->kreclaimd = tsk;
+}
+
+static void kreclaimd_stop(pg_data_t *pgdat)
+{
+	if (pgdat->kreclaimd) {
+		kthread_stop(pgdat->kreclaimd);
+		pgdat->kreclaimd = NULL;
+	}
+}
+#else
+static inline void kreclaimd_run(pg_data_t *pgdat) { }
+static inline void kreclaimd_stop(pg_data_t *pgdat) { }
+#endif /* CONFIG_RECLAIM_OFFLOAD */
+
 /*
  * This kswapd start function will be called by init and node-hot-add.
  * On node-hot-add, kswapd will moved to proper cpus if cpus are hot-added.
@@ -2868,6 +3020,8 @@ int kswapd_run(int nid)
 	pg_data_t *pgdat = NODE_DATA(nid);
 	int ret = 0;
 
+	kreclaimd_run(pgdat);
+	kcompactd_run(pgdat);
 	if (pgdat->kswapd)
 		return 0;
 
@@ -2890,6 +3044,8 @@ void kswapd_stop(int nid)
 
 	if (kswapd)
 		kthread_stop(kswapd);
+	kreclaimd_stop(NODE_DATA(nid));
+	kcompactd_stop(NODE_DATA(nid));
 }
 
 static int __init kswapd_init(void)
@@ -879,6 +879,8 @@ static const char * const vmstat_text[] = {
 	"nr_shmem",
 	"nr_dirtied",
 	"nr_written",
+	"workingset_refault",
+	"workingset_activate",
 
 #ifdef CONFIG_NUMA
 	"numa_hit",
@@ -927,6 +929,16 @@ static const char * const vmstat_text[] = {
 
 	"pgrotated",
 
+	"allocstall_lt_1ms",
+	"allocstall_lt_4ms",
+	"allocstall_lt_16ms",
+	"allocstall_lt_64ms",
+	"allocstall_ge_64ms",
+#ifdef CONFIG_RECLAIM_OFFLOAD
+	"reclaim_offload",
+	"reclaim_offload_timeout",
+#endif
+
 #ifdef CONFIG_COMPACTION
 	"compact_blocks_moved",
 	"compact_pages_moved",
@@ -934,6 +946,11 @@ static const char * const vmstat_text[] = {
 	"compact_stall",
 	"compact_fail",
 	"compact_success",
+	"kcompactd_wake",
+	"kcompactd_pages_moved",
+	"kcompactd_budget_exhausted",
+	"kcompactd_fail",
+	"kcompactd_success",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
@@ -963,7 +980,7 @@ static const char * const vmstat_text[] = {
 static void zoneinfo_show_print(struct seq_file *m, pg_data_t *pgdat,
 							struct zone *zone)
 {
-	int i;
+	int i, j;
 	seq_printf(m, "Node %d, zone %8s", pgdat->node_id, zone->name);
 	seq_printf(m,
 		   "\n  pages free     %lu"
@@ -992,6 +1009,18 @@ static void zoneinfo_show_print(struct seq_file *m, pg_data_t *pgdat,
 		seq_printf(m, ", %lu", zone->lowmem_reserve[i]);
 	seq_printf(m,
 		   ")"
+		   "\n  lock acquired   %lu"
+		   "\n       contended  %lu"
+		   "\n       hold_ns    %llu"
+		   "\n       pages/acq  %lu"
+		   "\n       batch x%d",
+		   zone->lock_acquired,
+		   zone->lock_contended,
+		   (unsigned long long)zone->lock_hold_ns,
+		   zone->lock_acquired ?
+				zone->lock_pages / zone->lock_acquired : 0,
+		   1 << zone->lock_batch_shift);
+	seq_printf(m,
 		   "\n  pagesets");
 	for_each_online_cpu(i) {
 		struct per_cpu_pageset *pageset;
@@ -1006,6 +1035,13 @@ static void zoneinfo_show_print(struct seq_file *m, pg_data_t *pgdat,
 			   pageset->pcp.count,
 			   pageset->pcp.high,
 			   pageset->pcp.batch);
+		for (j = 0; j < PCP_HIGH_ORDER; j++) {
+			struct per_cpu_order_pages *pco = &pageset->pcp.orders[j];
+
+			seq_printf(m,
+				   "\n            order %d: count %i hit %lu miss %lu",
+				   j + 1, pco->count, pco->hit, pco->miss);
+		}
 #ifdef CONFIG_SMP
 		seq_printf(m, "\n  vm stats threshold: %d",
 				pageset->stat_threshold);
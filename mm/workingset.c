@@ -0,0 +1,188 @@
+/*
+ * linux/mm/workingset.c
+ *
+ * Working set detection for the page cache
+ *
+ * A file page evicted from the inactive list that is read again soon after
+ * belonged to the working set: had the inactive list been larger by the
+ * number of pages evicted or activated in between (its refault distance),
+ * it would have stayed resident. If that distance is no larger than the
+ * active list, the page would have won against the active pages, so it is
+ * put back on the active list straight away instead of working its way up
+ * from the inactive list again while the working set keeps being thrashed
+ * by streaming reads.
+ *
+ * To measure the distance, every zone counts evictions and activations in
+ * zone->inactive_age. On eviction the current count is stored in a shadow
+ * entry, keyed by mapping and index; a refault looks the entry up, removes
+ * it and compares it with the count of the zone it was evicted from.
+ *
+ * The page cache radix tree cannot hold anything but pages, so shadow
+ * entries live in a hash table of small buckets sized at boot, about one
+ * entry for every two pages of memory. Each bucket is replaced round
+ * robin, so old shadows fade out on their own and truncated files need no
+ * cleanup; a stale shadow can at worst activate one page early.
+ */
+
+#include <linux/mm.h>
+#include <linux/fs.h>
+#include <linux/swap.h>
+#include <linux/jhash.h>
+#include <linux/bootmem.h>
+#include <linux/vmstat.h>
+#include <linux/init.h>
+
+#define SHADOW_WAYS		7
+#define SHADOW_COOKIE_SEED	0x9e3779b9
+
+/* a shadow is the eviction time, then the node and zone evicted from */
+#define EVICTION_SHIFT		(NODES_SHIFT + ZONES_SHIFT)
+#define EVICTION_MASK		(~0U >> EVICTION_SHIFT)
+
+/* one cacheline per bucket with a 4-byte lock */
+struct shadow_bucket {
+	spinlock_t	lock;
+	unsigned int	hand;
+	u32		cookie[SHADOW_WAYS];	/* 0: slot is free */
+	u32		shadow[SHADOW_WAYS];
+};
+
+static struct shadow_bucket *shadow_table;
+static unsigned int shadow_shift;
+
+static struct shadow_bucket *shadow_lookup(struct address_space *mapping,
+					   pgoff_t index, u32 *cookie)
+{
+	u32 m = (u32)(unsigned long)mapping;
+	u32 ino = mapping->host ? (u32)mapping->host->i_ino : 0;
+	u32 hash = jhash_3words(m, (u32)index, ino, 0);
+
+	*cookie = jhash_3words(m, (u32)index, ino, SHADOW_COOKIE_SEED) | 1;
+	return &shadow_table[hash & ((1U << shadow_shift) - 1)];
+}
+
+static u32 pack_shadow(struct zone *zone, unsigned long eviction)
+{
+	eviction = (eviction << NODES_SHIFT) | zone_to_nid(zone);
+	eviction = (eviction << ZONES_SHIFT) | zone_idx(zone);
+	return eviction;
+}
+
+static struct zone *unpack_shadow(u32 shadow, unsigned long *eviction)
+{
+	int zid, nid;
+
+	zid = shadow & ((1U << ZONES_SHIFT) - 1);
+	shadow >>= ZONES_SHIFT;
+	nid = shadow & ((1U << NODES_SHIFT) - 1);
+	shadow >>= NODES_SHIFT;
+	*eviction = shadow;
+	return NODE_DATA(nid)->node_zones + zid;
+}
+
+/**
+ * workingset_eviction - note the eviction of a page cache page
+ * @mapping: address space the page is being removed from
+ * @page: the page, still locked and in the page cache
+ *
+ * Called by reclaim, not by truncation, before @page is removed.
+ */
+void workingset_eviction(struct address_space *mapping, struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	struct shadow_bucket *b;
+	unsigned long eviction, flags;
+	u32 cookie;
+
+	eviction = atomic_long_inc_return(&zone->inactive_age);
+	if (!shadow_table)
+		return;
+
+	/*
+	 * The bucket lock nests inside mapping->tree_lock here, which is
+	 * taken from interrupts, so it must never be held with them enabled.
+	 */
+	b = shadow_lookup(mapping, page->index, &cookie);
+	spin_lock_irqsave(&b->lock, flags);
+	b->cookie[b->hand] = cookie;
+	b->shadow[b->hand] = pack_shadow(zone, eviction & EVICTION_MASK);
+	if (++b->hand == SHADOW_WAYS)
+		b->hand = 0;
+	spin_unlock_irqrestore(&b->lock, flags);
+}
+
+/**
+ * workingset_refault - check whether a page being read belongs in memory
+ * @mapping: address space the page is added to
+ * @index: page index within @mapping
+ *
+ * Returns true if the page was evicted recently enough that it should go
+ * directly onto the active list.
+ */
+bool workingset_refault(struct address_space *mapping, pgoff_t index)
+{
+	unsigned long refault, eviction, distance;
+	struct shadow_bucket *b;
+	struct zone *zone;
+	u32 cookie, shadow = 0;
+	int i;
+
+	if (!shadow_table)
+		return false;
+
+	b = shadow_lookup(mapping, index, &cookie);
+	spin_lock_irq(&b->lock);
+	for (i = 0; i < SHADOW_WAYS; i++) {
+		if (b->cookie[i] == cookie) {
+			b->cookie[i] = 0;
+			shadow = b->shadow[i];
+			break;
+		}
+	}
+	spin_unlock_irq(&b->lock);
+	if (i == SHADOW_WAYS)
+		return false;
+
+	zone = unpack_shadow(shadow, &eviction);
+	refault = atomic_long_read(&zone->inactive_age);
+	distance = (refault - eviction) & EVICTION_MASK;
+
+	inc_zone_state(zone, WORKINGSET_REFAULT);
+	if (distance <= zone_page_state(zone, NR_ACTIVE_FILE)) {
+		inc_zone_state(zone, WORKINGSET_ACTIVATE);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * workingset_activation - note a page moving to the active list
+ * @page: the page
+ *
+ * An activation pushes inactive pages towards eviction as much as an
+ * eviction does, so it advances the clock as well.
+ */
+void workingset_activation(struct page *page)
+{
+	atomic_long_inc(&page_zone(page)->inactive_age);
+}
+
+static int __init workingset_init(void)
+{
+	unsigned long i, nr;
+
+	shadow_table = alloc_large_system_hash("workingset shadows",
+					       sizeof(struct shadow_bucket),
+					       0, PAGE_SHIFT + 4, 0,
+					       &shadow_shift, NULL, 0);
+	nr = 1UL << shadow_shift;
+	for (i = 0; i < nr; i++) {
+		struct shadow_bucket *b = &shadow_table[i];
+
+		spin_lock_init(&b->lock);
+		b->hand = 0;
+		memset(b->cookie, 0, sizeof(b->cookie));
+	}
+	return 0;
+}
+__initcall(workingset_init);
@@ -420,6 +420,46 @@ void __kfree_skb(struct sk_buff *skb)
 }
 EXPORT_SYMBOL(__kfree_skb);
 
+#define SKB_FREE_BATCH	16
+
+/**
+ *	__kfree_skb_list - free a list of unused sk_buffs
+ *	@skb: first buffer of a list linked through skb->next
+ *	@location: caller, for the kfree_skb tracepoint
+ *
+ *	Like __kfree_skb() on every buffer of the list, which must have no
+ *	users left, but the plain heads go back to skbuff_head_cache a
+ *	batch at a time. Used for the transmit completion queue, where a
+ *	driver's TX interrupt hands over a whole ring's worth at once.
+ */
+void __kfree_skb_list(struct sk_buff *skb, void *location)
+{
+	void *heads[SKB_FREE_BATCH];
+	size_t n = 0;
+
+	while (skb) {
+		struct sk_buff *next = skb->next;
+
+		WARN_ON(atomic_read(&skb->users));
+		trace_kfree_skb(skb, location);
+		skb_release_all(skb);
+		if (skb->fclone != SKB_FCLONE_UNAVAILABLE) {
+			kfree_skbmem(skb);
+		} else {
+			heads[n++] = skb;
+			if (n == SKB_FREE_BATCH) {
+				kmem_cache_free_bulk(skbuff_head_cache, n,
+						     heads);
+				n = 0;
+			}
+		}
+		skb = next;
+	}
+	if (n)
+		kmem_cache_free_bulk(skbuff_head_cache, n, heads);
+}
+EXPORT_SYMBOL(__kfree_skb_list);
+
 /**
  *	kfree_skb - free an sk_buff
  *	@skb: buffer to free
@@ -347,34 +347,24 @@ int tfrc_rx_handle_loss(struct tfrc_rx_hist *h,
 
 int tfrc_rx_hist_alloc(struct tfrc_rx_hist *h)
 {
-	int i;
-
-	for (i = 0; i <= TFRC_NDUPACK; i++) {
-		h->ring[i] = kmem_cache_alloc(tfrc_rx_hist_slab, GFP_ATOMIC);
-		if (h->ring[i] == NULL)
-			goto out_free;
+	if (!kmem_cache_alloc_bulk(tfrc_rx_hist_slab, GFP_ATOMIC,
+				   TFRC_NDUPACK + 1, (void **)h->ring)) {
+		memset(h->ring, 0, sizeof(h->ring));
+		return -ENOBUFS;
 	}
 
 	h->loss_count = h->loss_start = 0;
 	return 0;
-
-out_free:
-	while (i-- != 0) {
-		kmem_cache_free(tfrc_rx_hist_slab, h->ring[i]);
-		h->ring[i] = NULL;
-	}
-	return -ENOBUFS;
 }
 
 void tfrc_rx_hist_purge(struct tfrc_rx_hist *h)
 {
-	int i;
-
-	for (i = 0; i <= TFRC_NDUPACK; ++i)
-		if (h->ring[i] != NULL) {
-			kmem_cache_free(tfrc_rx_hist_slab, h->ring[i]);
-			h->ring[i] = NULL;
-		}
+	/* the ring is allocated and freed as a whole */
+	if (h->ring[0] != NULL) {
+		kmem_cache_free_bulk(tfrc_rx_hist_slab, TFRC_NDUPACK + 1,
+				     (void **)h->ring);
+		memset(h->ring, 0, sizeof(h->ring));
+	}
 }
 
 /**
@@ -3,7 +3,20 @@
 
 extern int bench_sched_messaging(int argc, const char **argv, const char *prefix);
 extern int bench_sched_pipe(int argc, const char **argv, const char *prefix);
+extern int bench_sched_fork(int argc, const char **argv, const char *prefix);
+extern int bench_sched_mixed(int argc, const char **argv, const char *prefix);
+extern int bench_sched_noise(int argc, const char **argv, const char *prefix);
+extern int bench_sched_cgroup(int argc, const char **argv, const char *prefix);
 extern int bench_mem_memcpy(int argc, const char **argv, const char *prefix __used);
+extern int bench_mem_page_fault(int argc, const char **argv, const char *prefix);
+extern int bench_mem_mmap(int argc, const char **argv, const char *prefix);
+extern int bench_futex_wake(int argc, const char **argv, const char *prefix);
+extern int bench_epoll_wait(int argc, const char **argv, const char *prefix);
+extern int bench_fs_splice(int argc, const char **argv, const char *prefix);
+extern int bench_fs_create(int argc, const char **argv, const char *prefix);
+extern int bench_fs_workingset(int argc, const char **argv,
+			       const char *prefix);
+extern int bench_net_rx(int argc, const char **argv, const char *prefix);
 
 #define BENCH_FORMAT_DEFAULT_STR	"default"
 #define BENCH_FORMAT_DEFAULT		0
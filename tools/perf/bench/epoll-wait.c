@@ -0,0 +1,165 @@
+/*
+ * epoll-wait.c
+ *
+ * wait: epoll_wait() event delivery with many fds and producers
+ *
+ * A set of producer threads signal eventfds in round robin while one
+ * consumer collects the readiness events with epoll_wait() and drains
+ * the eventfds, until every produced event has been consumed.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <assert.h>
+#include <sys/time.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#define MAX_EVENTS	64
+
+static int		nr_fds		= 1024;
+static int		nr_producers;
+static int		loops		= 100000;
+
+static const struct option options[] = {
+	OPT_INTEGER('f', "fds", &nr_fds,
+		    "Specify number of eventfds watched"),
+	OPT_INTEGER('p', "producers", &nr_producers,
+		    "Specify number of producer threads (default: online CPUs)"),
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of events signalled per producer"),
+	OPT_END()
+};
+
+static const char * const bench_epoll_wait_usage[] = {
+	"perf bench epoll wait <options>",
+	NULL
+};
+
+static int *fds;
+
+static void *producer_thread(void *arg)
+{
+	uint64_t one = 1;
+	int __used ret;
+	int i, fd = (long)arg;
+
+	for (i = 0; i < loops; i++) {
+		ret = write(fds[fd], &one, sizeof(one));
+		if (++fd == nr_fds)
+			fd = 0;
+	}
+
+	return NULL;
+}
+
+int bench_epoll_wait(int argc, const char **argv, const char *prefix __used)
+{
+	struct timeval start, stop, diff;
+	unsigned long long result_usec, nr_events, consumed = 0;
+	struct epoll_event ev, events[MAX_EVENTS];
+	pthread_t *threads;
+	uint64_t cnt;
+	int i, n, epfd, __used ret;
+
+	argc = parse_options(argc, argv, options,
+			     bench_epoll_wait_usage, 0);
+
+	if (nr_producers <= 0)
+		nr_producers = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_fds <= 0)
+		nr_fds = 1;
+
+	epfd = epoll_create(nr_fds);
+	assert(epfd >= 0);
+
+	fds = calloc(nr_fds, sizeof(*fds));
+	threads = calloc(nr_producers, sizeof(*threads));
+	assert(fds && threads);
+
+	for (i = 0; i < nr_fds; i++) {
+		fds[i] = eventfd(0, EFD_NONBLOCK);
+		if (fds[i] < 0) {
+			perror("eventfd");
+			return 1;
+		}
+		ev.events = EPOLLIN;
+		ev.data.fd = fds[i];
+		ret = epoll_ctl(epfd, EPOLL_CTL_ADD, fds[i], &ev);
+		assert(!ret);
+	}
+
+	nr_events = (unsigned long long)nr_producers * loops;
+
+	gettimeofday(&start, NULL);
+
+	for (i = 0; i < nr_producers; i++) {
+		ret = pthread_create(&threads[i], NULL, producer_thread,
+				     (void *)(long)((i * nr_fds) / nr_producers));
+		assert(!ret);
+	}
+
+	while (consumed < nr_events) {
+		n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+		for (i = 0; i < n; i++) {
+			if (read(events[i].data.fd, &cnt, sizeof(cnt)) ==
+			    sizeof(cnt))
+				consumed += cnt;
+		}
+	}
+
+	for (i = 0; i < nr_producers; i++) {
+		ret = pthread_join(threads[i], NULL);
+		assert(!ret);
+	}
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	for (i = 0; i < nr_fds; i++)
+		close(fds[i]);
+	close(epfd);
+	free(threads);
+	free(fds);
+
+	result_usec = diff.tv_sec * 1000000ULL + diff.tv_usec;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d producers, %d eventfds, %llu events\n\n",
+		       nr_producers, nr_fds, nr_events);
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec/1000));
+
+		printf(" %14lf usecs/event\n",
+		       (double)result_usec / (double)nr_events);
+		printf(" %14llu events/sec\n",
+		       nr_events * 1000000ULL / (result_usec ? : 1));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu.%03lu\n",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec / 1000));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
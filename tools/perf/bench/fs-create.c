@@ -0,0 +1,182 @@
+/*
+ * fs-create.c
+ *
+ * create: Concurrent small file creation
+ *
+ * Each thread creates, writes, closes and finally unlinks its own set
+ * of small files. By default all threads share one directory, so the
+ * directory inode lock and the dcache are contended as in a real
+ * application writing many small files.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <assert.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+static const char	*base_dir	= "/tmp";
+static int		nr_threads;
+static int		nr_files	= 10000;
+static int		file_size	= 4096;
+static bool		private_dirs;
+
+static const struct option options[] = {
+	OPT_STRING('d', "directory", &base_dir, "/tmp",
+		    "Specify directory in which the test directory is created"),
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of threads (default: online CPUs)"),
+	OPT_INTEGER('n', "files", &nr_files,
+		    "Specify number of files created per thread"),
+	OPT_INTEGER('s', "size", &file_size,
+		    "Specify number of bytes written to each file"),
+	OPT_BOOLEAN('p', "private", &private_dirs,
+		    "Give every thread its own directory"),
+	OPT_END()
+};
+
+static const char * const bench_fs_create_usage[] = {
+	"perf bench fs create <options>",
+	NULL
+};
+
+static char test_dir[PATH_MAX];
+static char *payload;
+
+static void thread_dir(char *dir, long id)
+{
+	if (private_dirs)
+		snprintf(dir, PATH_MAX, "%s/%ld", test_dir, id);
+	else
+		snprintf(dir, PATH_MAX, "%s", test_dir);
+}
+
+static void *create_thread(void *arg)
+{
+	long id = (long)arg;
+	char dir[PATH_MAX], name[PATH_MAX];
+	int __used ret;
+	int i, fd;
+
+	thread_dir(dir, id);
+
+	for (i = 0; i < nr_files; i++) {
+		snprintf(name, sizeof(name), "%s/%ld.%d", dir, id, i);
+		fd = open(name, O_CREAT | O_EXCL | O_WRONLY, 0600);
+		assert(fd >= 0);
+		ret = write(fd, payload, file_size);
+		close(fd);
+	}
+
+	for (i = 0; i < nr_files; i++) {
+		snprintf(name, sizeof(name), "%s/%ld.%d", dir, id, i);
+		unlink(name);
+	}
+
+	return NULL;
+}
+
+int bench_fs_create(int argc, const char **argv, const char *prefix __used)
+{
+	struct timeval start, stop, diff;
+	unsigned long long result_usec, total;
+	char dir[PATH_MAX];
+	pthread_t *threads;
+	int __used ret;
+	long i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_fs_create_usage, 0);
+
+	if (nr_threads <= 0)
+		nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (file_size < 0)
+		file_size = 0;
+
+	snprintf(test_dir, sizeof(test_dir), "%s/perf-bench-create.XXXXXX",
+		 base_dir);
+	if (!mkdtemp(test_dir)) {
+		perror("mkdtemp");
+		return 1;
+	}
+
+	if (private_dirs) {
+		for (i = 0; i < nr_threads; i++) {
+			thread_dir(dir, i);
+			ret = mkdir(dir, 0700);
+			assert(!ret);
+		}
+	}
+
+	payload = calloc(1, file_size + 1);
+	threads = calloc(nr_threads, sizeof(*threads));
+	assert(payload && threads);
+
+	gettimeofday(&start, NULL);
+
+	for (i = 0; i < nr_threads; i++) {
+		ret = pthread_create(&threads[i], NULL, create_thread,
+				     (void *)i);
+		assert(!ret);
+	}
+	for (i = 0; i < nr_threads; i++) {
+		ret = pthread_join(threads[i], NULL);
+		assert(!ret);
+	}
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	if (private_dirs) {
+		for (i = 0; i < nr_threads; i++) {
+			thread_dir(dir, i);
+			rmdir(dir);
+		}
+	}
+	rmdir(test_dir);
+	free(threads);
+	free(payload);
+
+	result_usec = diff.tv_sec * 1000000ULL + diff.tv_usec;
+	total = (unsigned long long)nr_threads * nr_files;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d threads creating %d files of %d bytes each in %s\n\n",
+		       nr_threads, nr_files, file_size, base_dir);
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec/1000));
+
+		printf(" %14lf usecs/file\n",
+		       (double)result_usec / (double)total);
+		printf(" %14llu files/sec\n",
+		       total * 1000000ULL / (result_usec ? : 1));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu.%03lu\n",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec / 1000));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
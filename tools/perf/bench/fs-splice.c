@@ -0,0 +1,170 @@
+/*
+ * fs-splice.c
+ *
+ * splice: Zero-copy pipe throughput with vmsplice() and splice()
+ *
+ * A writer gifts user pages into a pipe with vmsplice() and a reader
+ * moves them out with splice() to /dev/null, so no data is copied on
+ * either side. With --copy the same transfer is done with write() and
+ * read() instead, for comparison.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <assert.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+
+#undef _GNU_SOURCE
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+static const char	*length_str	= "1GB";
+static const char	*chunk_str	= "64KB";
+static bool		use_copy;
+
+static const struct option options[] = {
+	OPT_STRING('l', "length", &length_str, "1GB",
+		    "Specify total amount of data moved through the pipe. "
+		    "available unit: B, MB, GB (upper and lower)"),
+	OPT_STRING('c', "chunk", &chunk_str, "64KB",
+		    "Specify size of each transfer"),
+	OPT_BOOLEAN('C', "copy", &use_copy,
+		    "Use write()/read() instead of vmsplice()/splice()"),
+	OPT_END()
+};
+
+static const char * const bench_fs_splice_usage[] = {
+	"perf bench fs splice <options>",
+	NULL
+};
+
+static void splice_writer(int fd, char *buf, size_t length, size_t chunk)
+{
+	struct iovec iov;
+	ssize_t ret;
+
+	while (length) {
+		iov.iov_base = buf;
+		iov.iov_len = chunk < length ? chunk : length;
+
+		if (use_copy)
+			ret = write(fd, iov.iov_base, iov.iov_len);
+		else
+			ret = vmsplice(fd, &iov, 1, 0);
+		assert(ret > 0);
+		length -= ret;
+	}
+}
+
+static void splice_reader(int fd, char *buf, size_t length, size_t chunk)
+{
+	ssize_t ret;
+	int null_fd;
+
+	null_fd = open("/dev/null", O_WRONLY);
+	assert(null_fd >= 0);
+
+	while (length) {
+		if (use_copy)
+			ret = read(fd, buf, chunk);
+		else
+			ret = splice(fd, NULL, null_fd, NULL, chunk,
+				     SPLICE_F_MOVE);
+		assert(ret > 0);
+		length -= ret;
+	}
+
+	close(null_fd);
+}
+
+int bench_fs_splice(int argc, const char **argv, const char *prefix __used)
+{
+	struct timeval start, stop, diff;
+	unsigned long long result_usec;
+	size_t length, chunk;
+	int fds[2], wait_stat, __used ret;
+	pid_t pid, __used reaped;
+	char *buf;
+
+	argc = parse_options(argc, argv, options,
+			     bench_fs_splice_usage, 0);
+
+	if ((s64)(length = perf_atoll((char *)length_str)) <= 0) {
+		fprintf(stderr, "Invalid length:%s\n", length_str);
+		return 1;
+	}
+	if ((s64)(chunk = perf_atoll((char *)chunk_str)) <= 0) {
+		fprintf(stderr, "Invalid chunk:%s\n", chunk_str);
+		return 1;
+	}
+
+	ret = posix_memalign((void **)&buf, sysconf(_SC_PAGESIZE), chunk);
+	assert(!ret);
+	memset(buf, 0x5a, chunk);
+	ret = pipe(fds);
+	assert(!ret);
+
+	/* don't let the child flush our pending output a second time */
+	fflush(stdout);
+
+	gettimeofday(&start, NULL);
+
+	pid = fork();
+	assert(pid >= 0);
+
+	if (!pid) {
+		close(fds[0]);
+		splice_writer(fds[1], buf, length, chunk);
+		exit(0);
+	}
+
+	close(fds[1]);
+	splice_reader(fds[0], buf, length, chunk);
+	reaped = waitpid(pid, &wait_stat, 0);
+	assert(reaped == pid && WIFEXITED(wait_stat));
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	close(fds[0]);
+	free(buf);
+
+	result_usec = diff.tv_sec * 1000000ULL + diff.tv_usec;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# Moved %s through a pipe in %s chunks with %s\n\n",
+		       length_str, chunk_str,
+		       use_copy ? "write()/read()" : "vmsplice()/splice()");
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec/1000));
+
+		printf(" %14lf MB/sec\n",
+		       (double)length / (double)(1 << 20) /
+		       ((double)result_usec / 1000000.0));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu.%03lu\n",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec / 1000));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
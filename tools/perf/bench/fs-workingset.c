@@ -0,0 +1,207 @@
+/*
+ * fs-workingset.c
+ *
+ * workingset: Working set reads against a streaming reader
+ *
+ * A small file is read again and again while a large file is streamed
+ * through the page cache once, a slice between every pass over the small
+ * one. If the kernel recognizes the small file as its working set, it
+ * stays cached and only the streamed data is read from the disk; if not,
+ * the stream keeps pushing it out and it is read from the disk on every
+ * pass.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <assert.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#define CHUNK	(64 * 1024)
+
+static const char	*base_dir	= "/tmp";
+static const char	*ws_str		= "64MB";
+static const char	*stream_str	= "1GB";
+static int		loops		= 32;
+
+static const struct option options[] = {
+	OPT_STRING('d', "directory", &base_dir, "/tmp",
+		    "Specify directory in which the test files are created"),
+	OPT_STRING('w', "workingset", &ws_str, "64MB",
+		    "Specify size of the file read on every pass"),
+	OPT_STRING('s', "stream", &stream_str, "1GB",
+		    "Specify size of the file streamed once, "
+		    "should exceed the memory size"),
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of passes over the working set"),
+	OPT_END()
+};
+
+static const char * const bench_fs_workingset_usage[] = {
+	"perf bench fs workingset <options>",
+	NULL
+};
+
+static char *buf;
+
+static int create_file(const char *path, size_t size)
+{
+	ssize_t __used ret;
+	size_t done;
+	int fd;
+
+	fd = open(path, O_CREAT | O_TRUNC | O_RDWR, 0600);
+	if (fd < 0)
+		return -1;
+	unlink(path);
+
+	for (done = 0; done < size; done += CHUNK) {
+		ret = write(fd, buf, CHUNK);
+		assert(ret == CHUNK);
+	}
+	fsync(fd);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+
+	return fd;
+}
+
+static void read_file(int fd, off_t start, size_t len)
+{
+	ssize_t __used ret;
+	size_t done;
+
+	for (done = 0; done < len; done += CHUNK) {
+		ret = pread(fd, buf, CHUNK, start + done);
+		assert(ret >= 0);
+	}
+}
+
+/* bytes this process caused to be read from storage, or -1 */
+static long long io_read_bytes(void)
+{
+	char line[128];
+	long long val = -1;
+	FILE *f;
+
+	f = fopen("/proc/self/io", "r");
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f))
+		if (sscanf(line, "read_bytes: %lld", &val) == 1)
+			break;
+	fclose(f);
+
+	return val;
+}
+
+int bench_fs_workingset(int argc, const char **argv, const char *prefix __used)
+{
+	struct timeval start, stop, diff, ws_time = { 0, 0 };
+	size_t ws_size, stream_size, slice;
+	long long io_start, io_stop;
+	char path[PATH_MAX];
+	int ws_fd, stream_fd, i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_fs_workingset_usage, 0);
+
+	if ((s64)(ws_size = perf_atoll((char *)ws_str)) <= 0) {
+		fprintf(stderr, "Invalid working set size:%s\n", ws_str);
+		return 1;
+	}
+	if ((s64)(stream_size = perf_atoll((char *)stream_str)) <= 0) {
+		fprintf(stderr, "Invalid stream size:%s\n", stream_str);
+		return 1;
+	}
+	if (loops <= 0)
+		loops = 1;
+	ws_size = (ws_size + CHUNK - 1) / CHUNK * CHUNK;
+	slice = (stream_size / loops + CHUNK - 1) / CHUNK * CHUNK;
+
+	buf = malloc(CHUNK);
+	assert(buf);
+	memset(buf, 0x5a, CHUNK);
+
+	snprintf(path, sizeof(path), "%s/perf-bench-ws.%d", base_dir, getpid());
+	ws_fd = create_file(path, ws_size);
+	snprintf(path, sizeof(path), "%s/perf-bench-stream.%d", base_dir,
+		 getpid());
+	stream_fd = create_file(path, slice * loops);
+	if (ws_fd < 0 || stream_fd < 0) {
+		perror("open");
+		return 1;
+	}
+
+	/* fault the working set in once, then start measuring */
+	read_file(ws_fd, 0, ws_size);
+
+	io_start = io_read_bytes();
+	gettimeofday(&start, NULL);
+
+	for (i = 0; i < loops; i++) {
+		struct timeval t0, t1, d;
+
+		gettimeofday(&t0, NULL);
+		read_file(ws_fd, 0, ws_size);
+		gettimeofday(&t1, NULL);
+		timersub(&t1, &t0, &d);
+		timeradd(&ws_time, &d, &ws_time);
+
+		read_file(stream_fd, (off_t)slice * i, slice);
+	}
+
+	gettimeofday(&stop, NULL);
+	io_stop = io_read_bytes();
+	timersub(&stop, &start, &diff);
+
+	close(ws_fd);
+	close(stream_fd);
+	free(buf);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d passes over a %s working set, streaming %s\n\n",
+		       loops, ws_str, stream_str);
+
+		printf(" %14s: %lu.%03lu [sec]\n", "Total time",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec/1000));
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Working set",
+		       ws_time.tv_sec,
+		       (unsigned long) (ws_time.tv_usec/1000));
+
+		if (io_start >= 0 && io_stop >= 0) {
+			long long extra = io_stop - io_start -
+					  (long long)slice * loops;
+
+			printf(" %14lld MB read from storage\n",
+			       (io_stop - io_start) >> 20);
+			printf(" %14lld MB of it for the working set\n",
+			       (extra > 0 ? extra : 0) >> 20);
+		}
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu.%03lu\n",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec / 1000));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
@@ -0,0 +1,180 @@
+/*
+ * futex-wake.c
+ *
+ * wake: futex wait/wake ping-pong on distinct futexes
+ *
+ * Threads are paired up and every pair hands a token back and forth
+ * through its own futex word. No two pairs share a futex, so any
+ * slowdown as pairs are added comes from the kernel side: hash bucket
+ * collisions and lock contention in kernel/futex.c.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <assert.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <sys/syscall.h>
+#include <sys/prctl.h>
+
+#ifndef FUTEX_WAIT
+#define FUTEX_WAIT		0
+#endif
+#ifndef FUTEX_WAKE
+#define FUTEX_WAKE		1
+#endif
+#ifndef FUTEX_PRIVATE_FLAG
+#define FUTEX_PRIVATE_FLAG	128
+#endif
+#ifndef PR_SET_FUTEX_HASH
+#define PR_SET_FUTEX_HASH	0x59000001
+#endif
+
+static int		nr_pairs;
+static int		loops		= 100000;
+static bool		shared;
+static int		private_hash;
+
+static const struct option options[] = {
+	OPT_INTEGER('p', "pairs", &nr_pairs,
+		    "Specify number of thread pairs (default: online CPUs)"),
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of round trips per pair"),
+	OPT_BOOLEAN('s', "shared", &shared,
+		    "Use process shared futexes instead of private ones"),
+	OPT_INTEGER('H', "hash", &private_hash,
+		    "Use a private futex hash table of this many buckets"),
+	OPT_END()
+};
+
+static const char * const bench_futex_wake_usage[] = {
+	"perf bench futex wake <options>",
+	NULL
+};
+
+/* one futex word per cache line so that pairs never share a line */
+struct futex_pair {
+	volatile int turn;
+	char pad[64 - sizeof(int)];
+};
+
+struct futex_thread {
+	struct futex_pair *pair;
+	int me;
+};
+
+static int futex_op;
+
+static inline int sys_futex(volatile int *uaddr, int op, int val)
+{
+	return syscall(SYS_futex, uaddr, op | futex_op, val, NULL, NULL, 0);
+}
+
+static void *futex_thread(void *arg)
+{
+	struct futex_thread *t = arg;
+	volatile int *turn = &t->pair->turn;
+	int i;
+
+	for (i = 0; i < loops; i++) {
+		while (*turn != t->me)
+			sys_futex(turn, FUTEX_WAIT, !t->me);
+
+		__sync_synchronize();
+		*turn = !t->me;
+		sys_futex(turn, FUTEX_WAKE, 1);
+	}
+
+	return NULL;
+}
+
+int bench_futex_wake(int argc, const char **argv, const char *prefix __used)
+{
+	struct timeval start, stop, diff;
+	unsigned long long result_usec, nr_ops;
+	struct futex_pair *pairs;
+	struct futex_thread *args;
+	pthread_t *threads;
+	int i, __used ret;
+
+	argc = parse_options(argc, argv, options,
+			     bench_futex_wake_usage, 0);
+
+	if (nr_pairs <= 0)
+		nr_pairs = sysconf(_SC_NPROCESSORS_ONLN);
+
+	futex_op = shared ? 0 : FUTEX_PRIVATE_FLAG;
+
+	if (private_hash && prctl(PR_SET_FUTEX_HASH, private_hash, 0, 0, 0)) {
+		perror("prctl(PR_SET_FUTEX_HASH)");
+		return 1;
+	}
+
+	ret = posix_memalign((void **)&pairs, 64, nr_pairs * sizeof(*pairs));
+	assert(!ret);
+	memset(pairs, 0, nr_pairs * sizeof(*pairs));
+	args = calloc(nr_pairs * 2, sizeof(*args));
+	threads = calloc(nr_pairs * 2, sizeof(*threads));
+	assert(args && threads);
+
+	gettimeofday(&start, NULL);
+
+	for (i = 0; i < nr_pairs * 2; i++) {
+		args[i].pair = &pairs[i / 2];
+		args[i].me = i & 1;
+		ret = pthread_create(&threads[i], NULL, futex_thread, &args[i]);
+		assert(!ret);
+	}
+	for (i = 0; i < nr_pairs * 2; i++) {
+		ret = pthread_join(threads[i], NULL);
+		assert(!ret);
+	}
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	free(threads);
+	free(args);
+	free(pairs);
+
+	result_usec = diff.tv_sec * 1000000ULL + diff.tv_usec;
+	nr_ops = (unsigned long long)nr_pairs * loops * 2;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d pairs of threads, %d round trips each, %s futexes\n\n",
+		       nr_pairs, loops, shared ? "shared" : "private");
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec/1000));
+
+		printf(" %14lf usecs/wakeup\n",
+		       (double)result_usec / (double)nr_ops);
+		printf(" %14llu wakeups/sec\n",
+		       nr_ops * 1000000ULL / (result_usec ? : 1));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu.%03lu\n",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec / 1000));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
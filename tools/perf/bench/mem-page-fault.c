@@ -0,0 +1,140 @@
+/*
+ * mem-page-fault.c
+ *
+ * page-fault: Throughput of anonymous page faults
+ *
+ * Each thread maps an anonymous region, writes one byte into every
+ * page of it and unmaps it again, so almost all of the time is spent in
+ * the page fault and munmap paths.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <assert.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+static const char	*length_str	= "16MB";
+static int		nr_threads;
+static int		loops		= 16;
+
+static const struct option options[] = {
+	OPT_STRING('l', "length", &length_str, "16MB",
+		    "Specify length of memory faulted per loop and thread. "
+		    "available unit: B, MB, GB (upper and lower)"),
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of threads (default: online CPUs)"),
+	OPT_INTEGER('r', "repeat", &loops,
+		    "Specify number of map/fault/unmap loops per thread"),
+	OPT_END()
+};
+
+static const char * const bench_mem_page_fault_usage[] = {
+	"perf bench mem page-fault <options>",
+	NULL
+};
+
+static size_t length;
+static long page_size;
+
+static void *page_fault_thread(void *arg __used)
+{
+	int i, __used ret;
+	size_t off;
+	char *p;
+
+	for (i = 0; i < loops; i++) {
+		p = mmap(NULL, length, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		assert(p != MAP_FAILED);
+
+		for (off = 0; off < length; off += page_size)
+			p[off] = 1;
+
+		ret = munmap(p, length);
+		assert(!ret);
+	}
+
+	return NULL;
+}
+
+int bench_mem_page_fault(int argc, const char **argv,
+			 const char *prefix __used)
+{
+	struct timeval start, stop, diff;
+	unsigned long long result_usec, nr_faults;
+	pthread_t *threads;
+	int i, __used ret;
+
+	argc = parse_options(argc, argv, options,
+			     bench_mem_page_fault_usage, 0);
+
+	if ((s64)(length = perf_atoll((char *)length_str)) <= 0) {
+		fprintf(stderr, "Invalid length:%s\n", length_str);
+		return 1;
+	}
+
+	if (nr_threads <= 0)
+		nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	page_size = sysconf(_SC_PAGESIZE);
+	threads = calloc(nr_threads, sizeof(*threads));
+	assert(threads);
+
+	gettimeofday(&start, NULL);
+
+	for (i = 0; i < nr_threads; i++) {
+		ret = pthread_create(&threads[i], NULL, page_fault_thread, NULL);
+		assert(!ret);
+	}
+	for (i = 0; i < nr_threads; i++) {
+		ret = pthread_join(threads[i], NULL);
+		assert(!ret);
+	}
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+	free(threads);
+
+	result_usec = diff.tv_sec * 1000000ULL + diff.tv_usec;
+	nr_faults = (unsigned long long)nr_threads * loops *
+		((length + page_size - 1) / page_size);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d threads faulting %s, %d times each\n\n",
+		       nr_threads, length_str, loops);
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec/1000));
+
+		printf(" %14lf usecs/fault\n",
+		       (double)result_usec / (double)nr_faults);
+		printf(" %14llu faults/sec\n",
+		       nr_faults * 1000000ULL / (result_usec ? : 1));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu.%03lu\n",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec / 1000));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
@@ -0,0 +1,221 @@
+/*
+ * net-rx.c
+ *
+ * rx: Loopback receive throughput
+ *
+ * Every flow is a TCP connection over the loopback device with a sender
+ * and a receiver thread. Each sender pushes a fixed amount of data, so the
+ * time is spent allocating, queueing and freeing socket buffers on both
+ * ends of the connections.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <assert.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+static const char	*length_str	= "256MB";
+static const char	*chunk_str	= "16KB";
+static int		nr_flows;
+static bool		no_delay;
+
+static const struct option options[] = {
+	OPT_STRING('l', "length", &length_str, "256MB",
+		    "Specify amount of data received per flow. "
+		    "available unit: B, MB, GB (upper and lower)"),
+	OPT_STRING('c', "chunk", &chunk_str, "16KB",
+		    "Specify size of each send() and recv()"),
+	OPT_INTEGER('f', "flows", &nr_flows,
+		    "Specify number of connections (default: online CPUs)"),
+	OPT_BOOLEAN('n', "nodelay", &no_delay,
+		    "Set TCP_NODELAY, so every send() becomes a segment"),
+	OPT_END()
+};
+
+static const char * const bench_net_rx_usage[] = {
+	"perf bench net rx <options>",
+	NULL
+};
+
+static size_t length;
+static size_t chunk;
+
+struct flow {
+	pthread_t	sender;
+	pthread_t	receiver;
+	int		tx_fd;
+	int		rx_fd;
+};
+
+static void *sender_thread(void *arg)
+{
+	struct flow *flow = arg;
+	size_t sent = 0;
+	ssize_t ret;
+	char *buf;
+
+	buf = calloc(1, chunk);
+	assert(buf);
+
+	while (sent < length) {
+		ret = send(flow->tx_fd, buf, min(chunk, length - sent), 0);
+		assert(ret > 0);
+		sent += ret;
+	}
+	shutdown(flow->tx_fd, SHUT_WR);
+	free(buf);
+
+	return NULL;
+}
+
+static void *receiver_thread(void *arg)
+{
+	struct flow *flow = arg;
+	size_t received = 0;
+	ssize_t ret;
+	char *buf;
+
+	buf = malloc(chunk);
+	assert(buf);
+
+	while (received < length) {
+		ret = recv(flow->rx_fd, buf, chunk, 0);
+		assert(ret > 0);
+		received += ret;
+	}
+	free(buf);
+
+	return NULL;
+}
+
+static void flow_connect(struct flow *flow, int listen_fd,
+			 struct sockaddr_in *addr)
+{
+	int one = 1, __used ret;
+
+	flow->tx_fd = socket(AF_INET, SOCK_STREAM, 0);
+	assert(flow->tx_fd >= 0);
+	if (no_delay) {
+		ret = setsockopt(flow->tx_fd, IPPROTO_TCP, TCP_NODELAY,
+				 &one, sizeof(one));
+		assert(!ret);
+	}
+	ret = connect(flow->tx_fd, (struct sockaddr *)addr, sizeof(*addr));
+	assert(!ret);
+	flow->rx_fd = accept(listen_fd, NULL, NULL);
+	assert(flow->rx_fd >= 0);
+}
+
+int bench_net_rx(int argc, const char **argv, const char *prefix __used)
+{
+	struct timeval start, stop, diff;
+	unsigned long long result_usec, total;
+	struct sockaddr_in addr;
+	socklen_t addr_len = sizeof(addr);
+	struct flow *flows;
+	int listen_fd, i, __used ret;
+
+	argc = parse_options(argc, argv, options,
+			     bench_net_rx_usage, 0);
+
+	if ((s64)(length = perf_atoll((char *)length_str)) <= 0) {
+		fprintf(stderr, "Invalid length:%s\n", length_str);
+		return 1;
+	}
+	if ((s64)(chunk = perf_atoll((char *)chunk_str)) <= 0) {
+		fprintf(stderr, "Invalid chunk:%s\n", chunk_str);
+		return 1;
+	}
+	if (nr_flows <= 0)
+		nr_flows = sysconf(_SC_NPROCESSORS_ONLN);
+
+	listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	assert(listen_fd >= 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	ret = bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr));
+	assert(!ret);
+	ret = getsockname(listen_fd, (struct sockaddr *)&addr, &addr_len);
+	assert(!ret);
+	ret = listen(listen_fd, nr_flows);
+	assert(!ret);
+
+	flows = calloc(nr_flows, sizeof(*flows));
+	assert(flows);
+	for (i = 0; i < nr_flows; i++)
+		flow_connect(&flows[i], listen_fd, &addr);
+	close(listen_fd);
+
+	gettimeofday(&start, NULL);
+
+	for (i = 0; i < nr_flows; i++) {
+		ret = pthread_create(&flows[i].receiver, NULL,
+				     receiver_thread, &flows[i]);
+		assert(!ret);
+		ret = pthread_create(&flows[i].sender, NULL,
+				     sender_thread, &flows[i]);
+		assert(!ret);
+	}
+	for (i = 0; i < nr_flows; i++) {
+		ret = pthread_join(flows[i].sender, NULL);
+		assert(!ret);
+		ret = pthread_join(flows[i].receiver, NULL);
+		assert(!ret);
+	}
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	for (i = 0; i < nr_flows; i++) {
+		close(flows[i].tx_fd);
+		close(flows[i].rx_fd);
+	}
+	free(flows);
+
+	result_usec = diff.tv_sec * 1000000ULL + diff.tv_usec;
+	total = (unsigned long long)nr_flows * length;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d flows receiving %s each in %s chunks\n\n",
+		       nr_flows, length_str, chunk_str);
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec/1000));
+
+		printf(" %14lf MB/sec\n",
+		       (double)total / (double)(result_usec ? : 1));
+		printf(" %14llu chunks/sec\n",
+		       total / chunk * 1000000ULL / (result_usec ? : 1));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu.%03lu\n",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec / 1000));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
@@ -0,0 +1,204 @@
+/*
+ * sched-cgroup.c
+ *
+ * cgroup: context switches at increasing cgroup depths
+ *
+ * Two tasks bounce a token over a pair of pipes, as in "sched pipe",
+ * first in the root of a cpuacct hierarchy and then in a chain of
+ * nested groups one level deeper each time. Every context switch
+ * charges the CPU time of the outgoing task to its group, so any cost
+ * of walking the hierarchy on each charge shows up as the depth grows.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <assert.h>
+#include <sched.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/types.h>
+
+static const char	*mount_point	= "/acct";
+static int		max_depth	= 8;
+static int		loops		= 100000;
+static int		cpu		= 0;
+
+static const struct option options[] = {
+	OPT_STRING('m', "mount", &mount_point, "dir",
+		   "Specify mount point of the cpuacct hierarchy"),
+	OPT_INTEGER('d', "depth", &max_depth,
+		    "Specify deepest level of nested groups"),
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of loops per depth"),
+	OPT_INTEGER('C', "cpu", &cpu,
+		    "Specify CPU to run both tasks on, -1 for any"),
+	OPT_END()
+};
+
+static const char * const bench_sched_cgroup_usage[] = {
+	"perf bench sched cgroup <options>",
+	NULL
+};
+
+static int cgroup_attach(const char *dir)
+{
+	char path[PATH_MAX];
+	FILE *f;
+	int ret;
+
+	snprintf(path, sizeof(path), "%s/tasks", dir);
+	f = fopen(path, "w");
+	if (!f)
+		return -1;
+	ret = fprintf(f, "%d\n", getpid()) < 0;
+	if (fclose(f))
+		ret = 1;
+	return ret ? -1 : 0;
+}
+
+/* returns the time the loops took in usecs */
+static unsigned long long pingpong(void)
+{
+	int pipe_1[2], pipe_2[2];
+	struct timeval start, stop, diff;
+	int __used ret, wait_stat;
+	int m = 0, i;
+	pid_t pid, __used reaped;
+
+	ret = pipe(pipe_1);
+	assert(!ret);
+	ret = pipe(pipe_2);
+	assert(!ret);
+
+	gettimeofday(&start, NULL);
+
+	pid = fork();
+	assert(pid >= 0);
+
+	if (!pid) {
+		for (i = 0; i < loops; i++) {
+			ret = read(pipe_1[0], &m, sizeof(int));
+			ret = write(pipe_2[1], &m, sizeof(int));
+		}
+		exit(0);
+	}
+
+	for (i = 0; i < loops; i++) {
+		ret = write(pipe_1[1], &m, sizeof(int));
+		ret = read(pipe_2[0], &m, sizeof(int));
+	}
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	reaped = waitpid(pid, &wait_stat, 0);
+	assert(reaped == pid && WIFEXITED(wait_stat));
+	close(pipe_1[0]);
+	close(pipe_1[1]);
+	close(pipe_2[0]);
+	close(pipe_2[1]);
+
+	return diff.tv_sec * 1000000ULL + diff.tv_usec;
+}
+
+int bench_sched_cgroup(int argc, const char **argv, const char *prefix __used)
+{
+	char path[PATH_MAX];
+	unsigned long long *usecs;
+	cpu_set_t mask;
+	size_t len;
+	int depth, made = 0;
+
+	argc = parse_options(argc, argv, options,
+			     bench_sched_cgroup_usage, 0);
+
+	if (max_depth < 0)
+		max_depth = 0;
+	if (loops <= 0)
+		loops = 1;
+
+	if (cpu >= 0) {
+		CPU_ZERO(&mask);
+		CPU_SET(cpu, &mask);
+		if (sched_setaffinity(0, sizeof(mask), &mask) < 0) {
+			perror("sched_setaffinity");
+			exit(1);
+		}
+	}
+
+	usecs = calloc(max_depth + 1, sizeof(*usecs));
+	assert(usecs);
+
+	snprintf(path, sizeof(path), "%s", mount_point);
+	for (depth = 0; depth <= max_depth; depth++) {
+		if (depth) {
+			len = strlen(path);
+			snprintf(path + len, sizeof(path) - len, "/perf-bench");
+			if (mkdir(path, 0755) && errno != EEXIST) {
+				fprintf(stderr, "cannot create %s: %s\n",
+					path, strerror(errno));
+				path[len] = '\0';
+				break;
+			}
+			made = depth;
+		}
+		if (cgroup_attach(path)) {
+			fprintf(stderr, "cannot move to %s: %s "
+				"(is cpuacct mounted there?)\n",
+				path, strerror(errno));
+			break;
+		}
+		usecs[depth] = pingpong();
+	}
+
+	/* move back to the root and remove the groups, deepest first */
+	if (cgroup_attach(mount_point))
+		made = 0;
+	for (; made > 0; made--) {
+		if (rmdir(path))
+			fprintf(stderr, "cannot remove %s: %s\n",
+				path, strerror(errno));
+		*strrchr(path, '/') = '\0';
+	}
+
+	if (depth <= max_depth)
+		exit(1);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# Executed %d pipe operations between two tasks "
+		       "at each depth under %s\n\n", loops, mount_point);
+
+		for (depth = 0; depth <= max_depth; depth++)
+			printf(" depth %2d: %14lf usecs/op %10d ops/sec\n",
+			       depth, (double)usecs[depth] / (double)loops,
+			       (int)((double)loops * 1000000.0 /
+				     (double)(usecs[depth] ? : 1)));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		for (depth = 0; depth <= max_depth; depth++)
+			printf("%d %lf\n", depth,
+			       (double)usecs[depth] / (double)loops);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	free(usecs);
+	return 0;
+}
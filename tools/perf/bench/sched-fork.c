@@ -0,0 +1,124 @@
+/*
+ * sched-fork.c
+ *
+ * fork: Process creation rate
+ *
+ * Each worker process forks children that exit straight away and reaps
+ * them, so the time goes into copying the mm, allocating the kernel stack
+ * and task structures, and tearing them down again.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+static int		nr_workers;
+static int		nr_forks	= 10000;
+
+static const struct option options[] = {
+	OPT_INTEGER('w', "workers", &nr_workers,
+		    "Specify number of forking processes (default: online CPUs)"),
+	OPT_INTEGER('l', "loop", &nr_forks,
+		    "Specify number of children forked per worker"),
+	OPT_END()
+};
+
+static const char * const bench_sched_fork_usage[] = {
+	"perf bench sched fork <options>",
+	NULL
+};
+
+static void fork_worker(void)
+{
+	int i, status;
+	pid_t pid, __used reaped;
+
+	for (i = 0; i < nr_forks; i++) {
+		pid = fork();
+		assert(pid >= 0);
+		if (!pid)
+			_exit(0);
+		reaped = waitpid(pid, &status, 0);
+		assert(reaped == pid);
+	}
+	exit(0);
+}
+
+int bench_sched_fork(int argc, const char **argv, const char *prefix __used)
+{
+	struct timeval start, stop, diff;
+	unsigned long long result_usec, total;
+	pid_t __used reaped;
+	pid_t *workers;
+	int i, status;
+
+	argc = parse_options(argc, argv, options,
+			     bench_sched_fork_usage, 0);
+
+	if (nr_workers <= 0)
+		nr_workers = sysconf(_SC_NPROCESSORS_ONLN);
+
+	workers = calloc(nr_workers, sizeof(*workers));
+	assert(workers);
+
+	gettimeofday(&start, NULL);
+
+	for (i = 0; i < nr_workers; i++) {
+		workers[i] = fork();
+		assert(workers[i] >= 0);
+		if (!workers[i])
+			fork_worker();
+	}
+	for (i = 0; i < nr_workers; i++) {
+		reaped = waitpid(workers[i], &status, 0);
+		assert(reaped == workers[i]);
+		assert(WIFEXITED(status) && !WEXITSTATUS(status));
+	}
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+	free(workers);
+
+	result_usec = diff.tv_sec * 1000000ULL + diff.tv_usec;
+	total = (unsigned long long)nr_workers * nr_forks;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d workers forking %d children each\n\n",
+		       nr_workers, nr_forks);
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec/1000));
+
+		printf(" %14lf usecs/fork\n",
+		       (double)result_usec / (double)total);
+		printf(" %14llu forks/sec\n",
+		       total * 1000000ULL / (result_usec ? : 1));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu.%03lu\n",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec / 1000));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
@@ -0,0 +1,222 @@
+/*
+ * sched-mixed.c
+ *
+ * mixed: CPU hogs sharing the machine with periodic tasks
+ *
+ * Hog processes spin for the whole run while sleeper processes wake up
+ * on a fixed period, do a short burst of work and go back to sleep. The
+ * hogs report how much work they got done, the sleepers how late each
+ * wakeup ran after its deadline. Load balancing that weighs the
+ * sleepers by what they actually use packs them sensibly next to the
+ * hogs instead of spreading them out as if they were hogs too, and a
+ * negative latency nice lets their wakeups preempt the hogs sooner.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <assert.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/types.h>
+#include <sys/prctl.h>
+
+#ifndef PR_SET_LATENCY_NICE
+#define PR_SET_LATENCY_NICE	0x59000005
+#endif
+
+static int		nr_hogs;
+static int		nr_sleepers;
+static int		period_us	= 10000;
+static int		busy_us		= 1000;
+static int		runtime		= 5;
+static int		latency_nice;
+
+static const struct option options[] = {
+	OPT_INTEGER('c', "hogs", &nr_hogs,
+		    "Specify number of CPU hogs (default: online CPUs)"),
+	OPT_INTEGER('s', "sleepers", &nr_sleepers,
+		    "Specify number of periodic tasks (default: online CPUs)"),
+	OPT_INTEGER('p', "period", &period_us,
+		    "Specify wakeup period of the periodic tasks in usecs"),
+	OPT_INTEGER('b', "busy", &busy_us,
+		    "Specify usecs of work per period of the periodic tasks"),
+	OPT_INTEGER('r', "runtime", &runtime,
+		    "Specify run time in seconds"),
+	OPT_INTEGER('L', "latency-nice", &latency_nice,
+		    "Specify latency nice of the periodic tasks"),
+	OPT_END()
+};
+
+static const char * const bench_sched_mixed_usage[] = {
+	"perf bench sched mixed <options>",
+	NULL
+};
+
+/* one cacheline per worker, shared with the parent */
+struct worker_stat {
+	unsigned long long	loops;
+	unsigned long long	wakeups;
+	unsigned long long	lat_sum;
+	unsigned long long	lat_max;
+} __attribute__((aligned(64)));
+
+static volatile int *done;
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void hog(struct worker_stat *st)
+{
+	unsigned long long loops = 0;
+	int i;
+
+	while (!*done) {
+		for (i = 0; i < 1000; i++)
+			__asm__ __volatile__("" : : : "memory");
+		loops++;
+	}
+	st->loops = loops;
+	exit(0);
+}
+
+static void sleeper(struct worker_stat *st)
+{
+	unsigned long long next, t, lat;
+	struct timespec ts;
+
+	if (latency_nice &&
+	    prctl(PR_SET_LATENCY_NICE, latency_nice, 0, 0, 0) < 0) {
+		perror("prctl(PR_SET_LATENCY_NICE)");
+		exit(1);
+	}
+
+	next = now_ns();
+	while (!*done) {
+		next += period_us * 1000ULL;
+		ts.tv_sec = next / 1000000000ULL;
+		ts.tv_nsec = next % 1000000000ULL;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+
+		t = now_ns();
+		lat = t > next ? t - next : 0;
+		st->wakeups++;
+		st->lat_sum += lat;
+		if (lat > st->lat_max)
+			st->lat_max = lat;
+
+		/* missed periods are skipped, not made up for */
+		if (t > next + period_us * 1000ULL)
+			next = t;
+
+		while (now_ns() < t + busy_us * 1000ULL)
+			;
+	}
+	exit(0);
+}
+
+int bench_sched_mixed(int argc, const char **argv, const char *prefix __used)
+{
+	unsigned long long loops = 0, wakeups = 0, lat_sum = 0, lat_max = 0;
+	struct worker_stat *stats;
+	int i, nr, status;
+	pid_t *pids, __used pid;
+	size_t size;
+
+	argc = parse_options(argc, argv, options,
+			     bench_sched_mixed_usage, 0);
+
+	if (nr_hogs <= 0)
+		nr_hogs = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_sleepers <= 0)
+		nr_sleepers = sysconf(_SC_NPROCESSORS_ONLN);
+	if (period_us <= 0)
+		period_us = 10000;
+	if (busy_us < 0 || busy_us >= period_us)
+		busy_us = period_us / 10;
+	if (runtime <= 0)
+		runtime = 1;
+
+	nr = nr_hogs + nr_sleepers;
+	size = sizeof(*stats) * (nr + 1);
+	stats = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	assert(stats != MAP_FAILED);
+	memset(stats, 0, size);
+	done = (volatile int *)&stats[nr];
+
+	pids = calloc(nr, sizeof(*pids));
+	assert(pids);
+
+	for (i = 0; i < nr; i++) {
+		pids[i] = fork();
+		assert(pids[i] >= 0);
+		if (!pids[i]) {
+			if (i < nr_hogs)
+				hog(&stats[i]);
+			sleeper(&stats[i]);
+		}
+	}
+
+	sleep(runtime);
+	*done = 1;
+
+	for (i = 0; i < nr; i++) {
+		pid = waitpid(pids[i], &status, 0);
+		assert(pid == pids[i]);
+		assert(WIFEXITED(status) && !WEXITSTATUS(status));
+	}
+	free(pids);
+
+	for (i = 0; i < nr_hogs; i++)
+		loops += stats[i].loops;
+	for (; i < nr; i++) {
+		wakeups += stats[i].wakeups;
+		lat_sum += stats[i].lat_sum;
+		if (stats[i].lat_max > lat_max)
+			lat_max = stats[i].lat_max;
+	}
+	munmap(stats, size);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d hogs, %d tasks running %d of every %d usecs, "
+		       "for %d sec\n",
+		       nr_hogs, nr_sleepers, busy_us, period_us, runtime);
+		printf("# latency nice of the periodic tasks: %d\n\n",
+		       latency_nice);
+
+		printf(" %14llu hog loops/sec\n", loops / runtime);
+		printf(" %14llu wakeups\n", wakeups);
+		printf(" %14.3lf usecs wakeup latency (avg)\n",
+		       (double)lat_sum / 1000.0 / (double)(wakeups ? : 1));
+		printf(" %14.3lf usecs wakeup latency (max)\n",
+		       (double)lat_max / 1000.0);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%.3lf\n",
+		       (double)lat_sum / 1000.0 / (double)(wakeups ? : 1));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
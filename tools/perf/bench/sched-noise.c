@@ -0,0 +1,119 @@
+/*
+ * sched-noise.c
+ *
+ * noise: interruptions seen by a CPU-bound task
+ *
+ * A single task spins on one CPU reading the clock. Any gap between two
+ * consecutive reads longer than the threshold is time the task lost to
+ * an interruption: the tick, another interrupt, or another task. On a
+ * nohz_full CPU most of the ticks go away while the task runs alone.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+
+static int		cpu		= -1;
+static int		runtime		= 5;
+static int		threshold_ns	= 1000;
+
+static const struct option options[] = {
+	OPT_INTEGER('C', "cpu", &cpu,
+		    "Specify CPU to run on (default: last online CPU)"),
+	OPT_INTEGER('r', "runtime", &runtime,
+		    "Specify run time in seconds"),
+	OPT_INTEGER('t', "threshold", &threshold_ns,
+		    "Specify gap in nsecs counted as an interruption"),
+	OPT_END()
+};
+
+static const char * const bench_sched_noise_usage[] = {
+	"perf bench sched noise <options>",
+	NULL
+};
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int bench_sched_noise(int argc, const char **argv, const char *prefix __used)
+{
+	unsigned long long start, end, prev, t, gap;
+	unsigned long long loops = 0, hits = 0, lost = 0, max = 0;
+	cpu_set_t mask;
+
+	argc = parse_options(argc, argv, options,
+			     bench_sched_noise_usage, 0);
+
+	if (cpu < 0)
+		cpu = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+	if (runtime <= 0)
+		runtime = 1;
+	if (threshold_ns <= 0)
+		threshold_ns = 1000;
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+	if (sched_setaffinity(0, sizeof(mask), &mask) < 0) {
+		perror("sched_setaffinity");
+		exit(1);
+	}
+
+	start = prev = now_ns();
+	end = start + runtime * 1000000000ULL;
+	do {
+		t = now_ns();
+		gap = t - prev;
+		if (gap > (unsigned long long)threshold_ns) {
+			hits++;
+			lost += gap;
+			if (gap > max)
+				max = gap;
+		}
+		prev = t;
+		loops++;
+	} while (t < end);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# spinning on CPU %d for %d sec, "
+		       "gaps over %d nsecs counted\n\n",
+		       cpu, runtime, threshold_ns);
+
+		printf(" %14llu interruptions\n", hits);
+		printf(" %14.1lf interruptions/sec\n",
+		       (double)hits / (double)runtime);
+		printf(" %14.3lf usecs lost (avg)\n",
+		       (double)lost / 1000.0 / (double)(hits ? : 1));
+		printf(" %14.3lf usecs lost (max)\n", (double)max / 1000.0);
+		printf(" %14.4lf %% of the run time lost\n",
+		       (double)lost * 100.0 / (double)(t - start));
+		printf(" %14.1lf nsecs per clock read\n",
+		       (double)(t - start) / (double)loops);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%.1lf\n", (double)hits / (double)runtime);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
@@ -13,6 +13,9 @@
  * Available subsystem list:
  *  sched ... scheduler and IPC mechanism
  *  mem   ... memory access performance
+ *  futex ... futex wait/wake
+ *  epoll ... event delivery through epoll
+ *  fs    ... pipe, splice and file system paths
  *
  */
 
@@ -42,6 +45,18 @@ static struct bench_suite sched_suites[] = {
 	{ "pipe",
 	  "Flood of communication over pipe() between two processes",
 	  bench_sched_pipe      },
+	{ "fork",
+	  "Process creation and teardown rate",
+	  bench_sched_fork      },
+	{ "mixed",
+	  "Wakeup latency of periodic tasks running next to CPU hogs",
+	  bench_sched_mixed     },
+	{ "noise",
+	  "Interruptions seen by a CPU-bound task",
+	  bench_sched_noise     },
+	{ "cgroup",
+	  "Context switches at increasing cpuacct cgroup depths",
+	  bench_sched_cgroup    },
 	suite_all,
 	{ NULL,
 	  NULL,
@@ -52,12 +67,64 @@ static struct bench_suite mem_suites[] = {
 	{ "memcpy",
 	  "Simple memory copy in various ways",
 	  bench_mem_memcpy },
+	{ "page-fault",
+	  "Throughput of anonymous page faults",
+	  bench_mem_page_fault },
+	{ "mmap",
+	  "mmap()/munmap() churn from concurrent threads",
+	  bench_mem_mmap },
 	suite_all,
 	{ NULL,
 	  NULL,
 	  NULL             }
 };
 
+static struct bench_suite futex_suites[] = {
+	{ "wake",
+	  "Wait/wake ping-pong between thread pairs on distinct futexes",
+	  bench_futex_wake },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL             }
+};
+
+static struct bench_suite epoll_suites[] = {
+	{ "wait",
+	  "Many producers signalling many fds to one epoll_wait() consumer",
+	  bench_epoll_wait },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL             }
+};
+
+static struct bench_suite fs_suites[] = {
+	{ "splice",
+	  "Zero-copy pipe throughput with vmsplice() and splice()",
+	  bench_fs_splice },
+	{ "create",
+	  "Concurrent small file creation",
+	  bench_fs_create },
+	{ "workingset",
+	  "Working set reads against a streaming reader",
+	  bench_fs_workingset },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL             }
+};
+
+static struct bench_suite net_suites[] = {
+	{ "rx",
+	  "TCP receive throughput over the loopback device",
+	  bench_net_rx },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL         }
+};
+
 struct bench_subsys {
 	const char *name;
 	const char *summary;
@@ -71,6 +138,18 @@ static struct bench_subsys subsystems[] = {
 	{ "mem",
 	  "memory access performance",
 	  mem_suites },
+	{ "futex",
+	  "futex wait/wake",
+	  futex_suites },
+	{ "epoll",
+	  "event delivery through epoll",
+	  epoll_suites },
+	{ "fs",
+	  "pipe, splice and file system paths",
+	  fs_suites },
+	{ "net",
+	  "network stack paths",
+	  net_suites },
 	{ "all",		/* sentinel: easy for help */
 	  "test all subsystem (pseudo subsystem)",
 	  NULL },
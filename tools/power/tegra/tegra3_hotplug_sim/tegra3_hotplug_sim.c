@@ -0,0 +1,450 @@
+/*
+ * tegra3_hotplug_sim -- replay a load trace through the Tegra3
+ * auto-hotplug policy and report latency and energy proxies.
+ *
+ * Copyright (c) 2011, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "cpu-tegra3-policy.h"
+
+/*
+ * Machine model, all per 1ms step: a G CPU retires 1.0 unit of work, the
+ * LP CPU 0.4 units. Energy is in arbitrary units: static leakage per
+ * powered CPU plus dynamic energy per unit of work retired, plus the
+ * transition itself burning a fully loaded G CPU for its duration.
+ */
+#define LP_CAPACITY		0.4
+#define G_STATIC		0.10
+#define G_DYNAMIC		1.00
+#define LP_STATIC		0.02
+#define LP_DYNAMIC		0.35
+
+/* time constant of the kernel's avg_nr_running() filter, in ms */
+#define NR_AVG_PERIOD_MS	134.2
+
+/* legacy frequency-only policy delays, in ms */
+#define LEGACY_UP2G0_MS		200
+#define LEGACY_UP2GN_MS		1000
+#define LEGACY_DOWN_MS		2000
+
+struct trace_point {
+	unsigned long t_ms;
+	double runnable;
+};
+
+static struct trace_point *trace;
+static unsigned int trace_len;
+
+static unsigned int sample_ms = 50;	/* set with -s sample_ms */
+static int legacy;			/* set with -l */
+static int verbose;			/* set with -v */
+static long up_dwell_ms = -1;		/* set with -U up_dwell_ms */
+static long to_g_dwell_ms = -1;		/* set with -G to_g_dwell_ms */
+static long down_dwell_ms = -1;		/* set with -D down_dwell_ms */
+static unsigned long cost_ms[TEGRA_HP_NR_ACTIONS] = {
+	[TEGRA_HP_CPU_UP]	= 2,
+	[TEGRA_HP_CPU_DOWN]	= 10,
+	[TEGRA_HP_TO_LP]	= 1,
+	[TEGRA_HP_TO_G]		= 1,
+};
+
+static const char * const action_names[TEGRA_HP_NR_ACTIONS] = {
+	[TEGRA_HP_HOLD]		= "hold",
+	[TEGRA_HP_CPU_UP]	= "cpu-up",
+	[TEGRA_HP_CPU_DOWN]	= "cpu-down",
+	[TEGRA_HP_TO_LP]	= "to-lp",
+	[TEGRA_HP_TO_G]		= "to-g",
+};
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: tegra3_hotplug_sim [-v] [-l] [-s sample_ms] [-U up_dwell_ms]\n"
+		"                          [-G to_g_dwell_ms] [-D down_dwell_ms] [trace]\n"
+		"       tegra3_hotplug_sim -r interval_ms -d duration_sec\n"
+		"       tegra3_hotplug_sim -g duration_sec\n");
+	exit(1);
+}
+
+static void add_point(unsigned long t_ms, double runnable)
+{
+	static unsigned int alloc;
+
+	if (trace_len == alloc) {
+		alloc = alloc ? alloc * 2 : 1024;
+		trace = realloc(trace, alloc * sizeof(*trace));
+		if (!trace) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	trace[trace_len].t_ms = t_ms;
+	trace[trace_len].runnable = runnable;
+	trace_len++;
+}
+
+/*
+ * Trace format: one "<time_ms> <runnable>" pair per line, sorted by time,
+ * '#' starts a comment. The number of runnable threads holds until the
+ * next line.
+ */
+static void read_trace(FILE *f)
+{
+	char line[256];
+	unsigned long t;
+	double r;
+
+	while (fgets(line, sizeof(line), f)) {
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+		if (sscanf(line, "%lu %lf", &t, &r) != 2) {
+			fprintf(stderr, "bad trace line: %s", line);
+			exit(1);
+		}
+		if (trace_len && t < trace[trace_len - 1].t_ms) {
+			fprintf(stderr, "trace not sorted at %lu ms\n", t);
+			exit(1);
+		}
+		add_point(t, r < 0 ? 0 : r);
+	}
+}
+
+/*
+ * Record a trace on a live system from the procs_running line of
+ * /proc/stat, discounting the recorder itself.
+ */
+static void record_trace(unsigned int interval_ms, unsigned int duration_sec)
+{
+	struct timespec start, now, delay = {
+		.tv_sec = interval_ms / 1000,
+		.tv_nsec = (interval_ms % 1000) * 1000000,
+	};
+	unsigned long t_ms;
+	char line[256];
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	printf("# recorded by tegra3_hotplug_sim -r %u\n", interval_ms);
+	do {
+		FILE *f = fopen("/proc/stat", "r");
+		int running = -1;
+
+		if (!f) {
+			perror("/proc/stat");
+			exit(1);
+		}
+		while (fgets(line, sizeof(line), f))
+			if (sscanf(line, "procs_running %d", &running) == 1)
+				break;
+		fclose(f);
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		t_ms = (now.tv_sec - start.tv_sec) * 1000 +
+			(now.tv_nsec - start.tv_nsec) / 1000000;
+		printf("%lu %d\n", t_ms, running > 0 ? running - 1 : 0);
+		nanosleep(&delay, NULL);
+	} while (t_ms < duration_sec * 1000UL);
+}
+
+/*
+ * Synthesize bursty UI-like load: a mostly idle system with a light
+ * background thread, where every 0.5-1.5s the user touches the screen
+ * and 2-4 threads run for 20-300ms.
+ */
+static void generate_trace(unsigned int duration_sec)
+{
+	unsigned long t = 0, end = duration_sec * 1000UL;
+
+	srand(1);
+	printf("# synthetic bursty UI load\n");
+	while (t < end) {
+		unsigned long gap = 500 + rand() % 1000;
+		unsigned long burst = 20 + rand() % 280;
+
+		printf("%lu %.2f\n", t, 0.15);
+		t += gap;
+		if (t >= end)
+			break;
+		printf("%lu %d\n", t, 2 + rand() % 3);
+		t += burst;
+	}
+	printf("%lu 0\n", t > end ? t : end);
+}
+
+struct machine {
+	int lp;
+	unsigned int online;
+	unsigned long busy_until;	/* transition in progress */
+	double backlog;			/* work queued, not yet retired */
+	double threads;			/* threads the backlog belongs to */
+	double avg_nr_run;
+	double util_work;		/* work retired this sample */
+
+	/* results */
+	double energy;
+	double backlog_integral;
+	double max_backlog;
+	double work;
+	unsigned long transitions[TEGRA_HP_NR_ACTIONS];
+	unsigned long time_in[TEGRA_HP_MAX_CPUS + 1];	/* [0] is LP */
+};
+
+static double capacity(struct machine *m)
+{
+	return m->lp ? LP_CAPACITY : m->online;
+}
+
+/* what cpufreq would be asked for given the recent per-CPU load */
+static enum tegra_hp_speed speed_of(struct machine *m, double util)
+{
+	double per_cpu = m->lp ? util * LP_CAPACITY : util;
+
+	if (m->lp)
+		return per_cpu > 0.9 * LP_CAPACITY ?
+			TEGRA_HP_SPEED_HIGH : TEGRA_HP_SPEED_MID;
+	if (per_cpu > LP_CAPACITY)
+		return TEGRA_HP_SPEED_HIGH;
+	if (per_cpu < 0.2)
+		return TEGRA_HP_SPEED_LOW;
+	return TEGRA_HP_SPEED_MID;
+}
+
+static enum tegra_hp_action legacy_decide(struct machine *m,
+					  enum tegra_hp_speed speed,
+					  unsigned long now, unsigned long *next)
+{
+	if (now < *next)
+		return TEGRA_HP_HOLD;
+
+	if (speed == TEGRA_HP_SPEED_HIGH) {
+		*next = now + (m->lp ? LEGACY_UP2G0_MS : LEGACY_UP2GN_MS);
+		if (m->lp)
+			return TEGRA_HP_TO_G;
+		return m->online < TEGRA_HP_MAX_CPUS ?
+			TEGRA_HP_CPU_UP : TEGRA_HP_HOLD;
+	}
+	if (speed == TEGRA_HP_SPEED_LOW && !m->lp) {
+		*next = now + LEGACY_DOWN_MS;
+		return m->online > 1 ? TEGRA_HP_CPU_DOWN : TEGRA_HP_TO_LP;
+	}
+	*next = now;
+	return TEGRA_HP_HOLD;
+}
+
+static void apply(struct machine *m, enum tegra_hp_action action,
+		  unsigned long now)
+{
+	switch (action) {
+	case TEGRA_HP_CPU_UP:
+		m->online++;
+		break;
+	case TEGRA_HP_CPU_DOWN:
+		m->online--;
+		break;
+	case TEGRA_HP_TO_LP:
+		m->lp = 1;
+		break;
+	case TEGRA_HP_TO_G:
+		m->lp = 0;
+		break;
+	default:
+		return;
+	}
+	m->transitions[action]++;
+	m->busy_until = now + cost_ms[action];
+	m->energy += cost_ms[action] * (G_STATIC + G_DYNAMIC);
+	if (verbose)
+		fprintf(stderr, "%8lu ms  %-8s  %s%u  nr_run %.2f\n", now,
+			action_names[action], m->lp ? "LP" : "G",
+			m->lp ? 1 : m->online, m->avg_nr_run);
+}
+
+static void simulate(void)
+{
+	struct tegra_hp_policy policy;
+	struct machine m = { .online = 1 };
+	unsigned long now, end, next_legacy = 0;
+	unsigned int i = 0, j;
+	double runnable = 0;
+
+	tegra_hp_policy_init(&policy);
+	if (up_dwell_ms >= 0)
+		policy.up_dwell_us = up_dwell_ms * 1000;
+	if (to_g_dwell_ms >= 0)
+		policy.to_g_dwell_us = to_g_dwell_ms * 1000;
+	if (down_dwell_ms >= 0)
+		policy.down_dwell_us = down_dwell_ms * 1000;
+	end = trace[trace_len - 1].t_ms;
+
+	for (now = 0; now < end; now++) {
+		double cap, done;
+
+		while (i < trace_len && trace[i].t_ms <= now)
+			runnable = trace[i++].runnable;
+
+		/* each runnable thread wants one G CPU worth of work */
+		m.backlog += runnable;
+		m.work += runnable;
+		cap = now < m.busy_until ? capacity(&m) - 1 : capacity(&m);
+		if (cap < 0)
+			cap = 0;
+		done = m.backlog < cap ? m.backlog : cap;
+		m.backlog -= done;
+		m.util_work += done;
+
+		if (m.lp)
+			m.energy += LP_STATIC + LP_DYNAMIC * done;
+		else
+			m.energy += G_STATIC * m.online + G_DYNAMIC * done;
+		m.backlog_integral += m.backlog;
+		if (m.backlog > m.max_backlog)
+			m.max_backlog = m.backlog;
+		m.time_in[m.lp ? 0 : m.online]++;
+
+		/*
+		 * Threads with work left stay runnable after the trace says
+		 * they stopped, but there are never more of them than the
+		 * most the trace had runnable since the backlog last drained.
+		 */
+		if (m.backlog <= 0)
+			m.threads = runnable;
+		else if (runnable > m.threads)
+			m.threads = runnable;
+		m.avg_nr_run += (m.threads - m.avg_nr_run) / NR_AVG_PERIOD_MS;
+
+		if ((now + 1) % sample_ms == 0 && now >= m.busy_until) {
+			struct tegra_hp_sample s = {
+				.now_us = (u64)now * 1000,
+				.lp = m.lp,
+				.nr_online = m.lp ? 1 : m.online,
+				.max_cpus = TEGRA_HP_MAX_CPUS,
+				.nr_run = m.avg_nr_run * TEGRA_HP_NR_RUN_SCALE,
+				.edp_favor_up = 1,
+			};
+			double util = m.util_work / (sample_ms * capacity(&m));
+			enum tegra_hp_action action;
+
+			for (j = 0; j < s.nr_online; j++)
+				s.util[j] = util * 100;
+			s.speed = speed_of(&m, util);
+
+			if (legacy)
+				action = legacy_decide(&m, s.speed, now,
+						       &next_legacy);
+			else
+				action = tegra_hp_policy_decide(&policy, &s);
+			apply(&m, action, now);
+			if (!legacy)
+				tegra_hp_policy_account(&policy, action,
+					(u64)(now + cost_ms[action]) * 1000,
+					(u64)cost_ms[action] * 1000);
+			m.util_work = 0;
+		}
+	}
+
+	printf("policy:            %s\n", legacy ? "legacy" : "runqueue");
+	printf("duration:          %lu ms\n", end);
+	printf("work:              %.0f\n", m.work);
+	printf("avg queued work:   %.3f\n", m.backlog_integral / end);
+	printf("avg delay:         %.3f ms\n",
+	       m.work ? m.backlog_integral / m.work : 0);
+	printf("max queued work:   %.1f\n", m.max_backlog);
+	printf("energy:            %.0f\n", m.energy);
+	printf("energy/work:       %.3f\n", m.work ? m.energy / m.work : 0);
+	for (j = TEGRA_HP_CPU_UP; j < TEGRA_HP_NR_ACTIONS; j++)
+		printf("%-18s %lu\n", action_names[j], m.transitions[j]);
+	printf("residency:         LP %.1f%%", 100.0 * m.time_in[0] / end);
+	for (j = 1; j <= TEGRA_HP_MAX_CPUS; j++)
+		printf("  G%u %.1f%%", j, 100.0 * m.time_in[j] / end);
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int record_ms = 0, duration = 0, generate = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "vls:U:G:D:r:d:g:")) != -1) {
+		switch (opt) {
+		case 'v':
+			verbose++;
+			break;
+		case 'l':
+			legacy = 1;
+			break;
+		case 's':
+			sample_ms = strtoul(optarg, NULL, 0);
+			break;
+		case 'U':
+			up_dwell_ms = strtol(optarg, NULL, 0);
+			break;
+		case 'G':
+			to_g_dwell_ms = strtol(optarg, NULL, 0);
+			break;
+		case 'D':
+			down_dwell_ms = strtol(optarg, NULL, 0);
+			break;
+		case 'r':
+			record_ms = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			duration = strtoul(optarg, NULL, 0);
+			break;
+		case 'g':
+			generate = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+		}
+	}
+
+	if (generate) {
+		generate_trace(generate);
+		return 0;
+	}
+	if (record_ms) {
+		if (!duration)
+			usage();
+		record_trace(record_ms, duration);
+		return 0;
+	}
+	if (!sample_ms)
+		usage();
+
+	if (optind < argc) {
+		FILE *f = fopen(argv[optind], "r");
+
+		if (!f) {
+			perror(argv[optind]);
+			return 1;
+		}
+		read_trace(f);
+		fclose(f);
+	} else
+		read_trace(stdin);
+
+	if (trace_len < 2) {
+		fprintf(stderr, "trace too short\n");
+		return 1;
+	}
+	simulate();
+	return 0;
+}
@@ -39,6 +39,7 @@ struct slabinfo {
 	unsigned long cpuslab_flush, deactivate_full, deactivate_empty;
 	unsigned long deactivate_to_head, deactivate_to_tail;
 	unsigned long deactivate_remote_frees, order_fallback;
+	unsigned long free_remote, free_remote_flush;
 	int numa[MAX_NODES];
 	int numa_partial[MAX_NODES];
 } slabinfo[MAX_SLABS];
@@ -465,6 +466,13 @@ static void slab_stats(struct slabinfo *s)
 	if (s->alloc_refill)
 		printf("Refill %8lu\n", s->alloc_refill);
 
+	if (s->free_remote)
+		printf("Remote frees %8lu(%lu%%) Batches %8lu Objects/Batch %lu\n",
+			s->free_remote, s->free_remote * 100 / total_free,
+			s->free_remote_flush,
+			s->free_remote_flush ?
+			s->free_remote / s->free_remote_flush : 0);
+
 	total = s->deactivate_full + s->deactivate_empty +
 			s->deactivate_to_head + s->deactivate_to_tail;
 
@@ -1190,6 +1198,8 @@ static void read_slab_dir(void)
 			slab->deactivate_to_tail = get_obj("deactivate_to_tail");
 			slab->deactivate_remote_frees = get_obj("deactivate_remote_frees");
 			slab->order_fallback = get_obj("order_fallback");
+			slab->free_remote = get_obj("free_remote");
+			slab->free_remote_flush = get_obj("free_remote_flush");
 			chdir("..");
 			if (slab->name[0] == ':')
 				alias_targets++;